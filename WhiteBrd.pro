@@ -5,5 +5,11 @@ INCLUDEPATH += .
 QT += core gui widgets
 
 # Input
-HEADERS += whitebrd.h R2Graph.h
-SOURCES += main.cpp whitebrd.cpp R2Graph.cpp
+HEADERS += whitebrd.h R2Graph.h strokegrid.h lasso.h polyline.h tilecache.h \
+    board.h calibration.h renderbackend.h qtrenderer.h predictor.h \
+    latency.h tracer.h allocstats.h actionio.h jitterfilter.h \
+    inputthread.h scriptinput.h boardexport.h autosave.h
+SOURCES += main.cpp whitebrd.cpp R2Graph.cpp strokegrid.cpp lasso.cpp polyline.cpp tilecache.cpp \
+    board.cpp calibration.cpp qtrenderer.cpp predictor.cpp \
+    latency.cpp tracer.cpp allocstats.cpp actionio.cpp \
+    jitterfilter.cpp inputthread.cpp scriptinput.cpp boardexport.cpp autosave.cpp
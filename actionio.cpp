@@ -0,0 +1,422 @@
+#include <stdlib.h>
+#include <string.h>
+#include "actionio.h"
+
+// A whole pixel with its offset in sixteenths, in the shortest
+// exact decimal form
+static void writeCoordinate(FILE* f, int whole, int offset) {
+    if (offset == 0) {
+        fprintf(f, " %d", whole);
+        return;
+    }
+    long long v = (long long) whole * SUBPIXELS + offset;
+    const char* sign = "";
+    if (v < 0) {
+        sign = "-";
+        v = -v;
+    }
+    // Sixteenths have at most four decimals
+    int decimals = (int)(v % SUBPIXELS) * (10000 / SUBPIXELS);
+    int digits = 4;
+    while (decimals % 10 == 0) {
+        decimals /= 10;
+        --digits;
+    }
+    fprintf(f, " %s%lld.%0*d", sign, v / SUBPIXELS, digits, decimals);
+}
+
+void writeAction(FILE* f, const Action& a) {
+    if (a.touchId != NO_TOUCH)
+        fprintf(f, "touch %d ", a.touchId);
+    if (a.type == Action::START_CURVE)
+        fprintf(f, "start %d %d", a.color, a.width);
+    else
+        fputs((a.type == Action::DRAW_CURVE)? "draw" : "end", f);
+    writeCoordinate(f, a.point.x, fractionX(a.fraction));
+    writeCoordinate(f, a.point.y, fractionY(a.fraction));
+    if (a.pressure != NO_PRESSURE)
+        fprintf(f, " %d", a.pressure);
+    fprintf(f, "\n");
+}
+
+void writeStroke(FILE* f, const Stroke& str) {
+    for (int i = 0; i < str.size(); ++i) {
+        int type = Action::DRAW_CURVE;
+        if (i == 0)
+            type = Action::START_CURVE;
+        else if (i == str.size() - 1)
+            type = Action::END_CURVE;
+        Action a(
+            type, str.color, str.width, str.points[i],
+            str.hasPressure()? (int) str.pressures[i] : NO_PRESSURE
+        );
+        a.fraction = str.fraction(i);
+        writeAction(f, a);
+    }
+    if (str.size() == 1) {
+        // A single point
+        Action a(
+            Action::END_CURVE, str.color, str.width, str.points[0],
+            str.hasPressure()? (int) str.pressures[0] : NO_PRESSURE
+        );
+        a.fraction = str.fraction(0);
+        writeAction(f, a);
+    }
+}
+
+void writePage(FILE* f, int page) {
+    fprintf(f, "page %d\n", page);
+}
+
+void writeBoardHeader(FILE* f) {
+    fprintf(f, "board\n");
+}
+
+// A decimal integer after blanks; 0 if there is none
+static const char* parseInt(const char* s, int& v) {
+    while (*s == ' ' || *s == '\t')
+        ++s;
+    bool negative = (*s == '-');
+    if (negative)
+        ++s;
+    const char* digits = s;
+    int x = 0;
+    while (*s >= '0' && *s <= '9') {
+        x = x*10 + (*s - '0');
+        ++s;
+    }
+    if (s == digits || s - digits > 9)
+        return 0;
+    v = negative? -x : x;
+    return s;
+}
+
+static int floorDiv(long long a, int b) {
+    return (int)((a >= 0)? a / b : -((-a - 1) / b) - 1);
+}
+
+// A decimal number after blanks, with an optional fraction, as its
+// nearest whole pixel and the offset from it in sixteenths; 0 if
+// there is none
+static const char* parseCoordinate(const char* s, int& v, int& offset) {
+    while (*s == ' ' || *s == '\t')
+        ++s;
+    bool negative = (*s == '-');
+    s = parseInt(s, v);
+    offset = 0;
+    if (s == 0 || *s != '.')
+        return s;
+    ++s;
+    // Digits beyond the sixth are far below a sixteenth
+    int n = 0, scale = 1;
+    for (; *s >= '0' && *s <= '9'; ++s) {
+        if (scale < 1000000) {
+            n = n*10 + (*s - '0');
+            scale *= 10;
+        }
+    }
+    long long t = (long long) (negative? -v : v) * SUBPIXELS +
+        ((long long) n * SUBPIXELS * 2 + scale) / (2 * scale);
+    if (negative)
+        t = -t;
+    v = floorDiv(t + SUBPIXELS/2, SUBPIXELS);
+    offset = (int)(t - (long long) v * SUBPIXELS);
+    return s;
+}
+
+static bool atLineEnd(const char* s) {
+    while (*s == ' ' || *s == '\t')
+        ++s;
+    return *s == 0 || *s == '\n' || *s == '\r';
+}
+
+// Without sscanf: scripts are parsed at millions of lines a second
+bool parseAction(const char* line, Action& a) {
+    const char* s = line;
+    int touchId = NO_TOUCH;
+    if (strncmp(s, "touch ", 6) == 0) {
+        s = parseInt(s + 6, touchId);
+        if (s == 0 || touchId < 0 || *s != ' ')
+            return false;
+        ++s;
+    }
+    int type;
+    int color = 0, width = 0;
+    if (strncmp(s, "draw ", 5) == 0) {
+        type = Action::DRAW_CURVE;
+        s += 5;
+    } else if (strncmp(s, "end ", 4) == 0) {
+        type = Action::END_CURVE;
+        s += 4;
+    } else if (strncmp(s, "start ", 6) == 0) {
+        type = Action::START_CURVE;
+        s = parseInt(s + 6, color);
+        if (s != 0)
+            s = parseInt(s, width);
+        if (s == 0 || color < 0 || color >= NUM_COLORS || width <= 0)
+            return false;
+    } else {
+        return false;
+    }
+    int x, y, dx, dy;
+    s = parseCoordinate(s, x, dx);
+    if (s != 0)
+        s = parseCoordinate(s, y, dy);
+    if (s == 0)
+        return false;
+    int pressure = NO_PRESSURE;
+    if (!atLineEnd(s)) {
+        s = parseInt(s, pressure);
+        if (s == 0 || !atLineEnd(s))
+            return false;
+        if (pressure < 0 || pressure > MAX_PRESSURE)
+            return false;
+    }
+    a = Action(type, color, width, I2Point(x, y), pressure, touchId);
+    a.fraction = packFraction(dx, dy);
+    return true;
+}
+
+static void putInt(unsigned char* p, unsigned int v, int numBytes) {
+    for (int i = 0; i < numBytes; ++i)
+        p[i] = (unsigned char)(v >> (8*i));
+}
+
+static unsigned int getInt(const unsigned char* p, int numBytes) {
+    unsigned int v = 0;
+    for (int i = 0; i < numBytes; ++i)
+        v |= (unsigned int) p[i] << (8*i);
+    return v;
+}
+
+void encodeAction(const Action& a, unsigned char* record) {
+    int flags = 0;
+    if (a.pressure != NO_PRESSURE)
+        flags |= ACTION_RECORD_PRESSURE;
+    if (a.touchId != NO_TOUCH)
+        flags |= ACTION_RECORD_TOUCH;
+    record[0] = (unsigned char)(ACTION_RECORD_TAG | a.type);
+    record[1] = (unsigned char) flags;
+    record[2] = (unsigned char)((a.pressure != NO_PRESSURE)? a.pressure : 0);
+    record[3] = (unsigned char) a.color;
+    putInt(record + 4, (unsigned int) a.width, 2);
+    putInt(record + 6, (unsigned int)((a.touchId != NO_TOUCH)? a.touchId : 0), 2);
+    putInt(record + 8, (unsigned int) a.point.x, 4);
+    putInt(record + 12, (unsigned int) a.point.y, 4);
+}
+
+bool decodeAction(const unsigned char* record, Action& a) {
+    int type = record[0] & ~ACTION_RECORD_TAG;
+    int flags = record[1];
+    if (
+        (record[0] & ACTION_RECORD_TAG) == 0 ||
+        type > Action::END_CURVE ||
+        (flags & ~(ACTION_RECORD_PRESSURE | ACTION_RECORD_TOUCH)) != 0
+    )
+        return false;
+    int color = record[3];
+    int width = (int) getInt(record + 4, 2);
+    if (
+        type == Action::START_CURVE &&
+        (color >= NUM_COLORS || width <= 0)
+    )
+        return false;
+    a = Action(
+        type, color, width,
+        I2Point((int) getInt(record + 8, 4), (int) getInt(record + 12, 4)),
+        (flags & ACTION_RECORD_PRESSURE)? record[2] : NO_PRESSURE,
+        (flags & ACTION_RECORD_TOUCH)? (int) getInt(record + 6, 2) : NO_TOUCH
+    );
+    return true;
+}
+
+void writeActionBinary(FILE* f, const Action& a) {
+    unsigned char record[ACTION_RECORD_SIZE];
+    encodeAction(a, record);
+    fwrite(record, 1, ACTION_RECORD_SIZE, f);
+}
+
+//----------------------------------------------------------
+// ActionDecoder
+
+ActionDecoder::ActionDecoder():
+    numErrors(0),
+    pending()
+{}
+
+void ActionDecoder::reset() {
+    pending.clear();
+    numErrors = 0;
+}
+
+void ActionDecoder::decodeRecord(
+    const char* p, int n, std::vector<Action>& actions
+) {
+    Action a;
+    if ((unsigned char) *p & ACTION_RECORD_TAG) {
+        if (decodeAction((const unsigned char*) p, a))
+            actions.push_back(a);
+        else
+            ++numErrors;
+        return;
+    }
+    // A text line, ended by '\n'
+    while (n > 0 && (*p == ' ' || *p == '\t')) {
+        ++p;
+        --n;
+    }
+    if (*p == '#' || *p == '\n' || *p == '\r')
+        return;
+    if (parseAction(p, a))
+        actions.push_back(a);
+    else
+        ++numErrors;
+}
+
+void ActionDecoder::decode(
+    const char* data, int n, std::vector<Action>& actions
+) {
+    const char* p = data;
+    const char* end = data + n;
+    if (!pending.empty()) {
+        // Complete the record left from the last call
+        if ((unsigned char) pending[0] & ACTION_RECORD_TAG) {
+            int k = ACTION_RECORD_SIZE - (int) pending.size();
+            if (k > n)
+                k = n;
+            pending.insert(pending.end(), p, p + k);
+            p += k;
+            if ((int) pending.size() < ACTION_RECORD_SIZE)
+                return;
+        } else {
+            const char* nl = (const char*) memchr(p, '\n', end - p);
+            const char* e = (nl != 0)? nl + 1 : end;
+            pending.insert(pending.end(), p, e);
+            p = e;
+            if (nl == 0) {
+                if ((int) pending.size() > MAX_ACTION_LINE) {
+                    ++numErrors;
+                    pending.clear();
+                }
+                return;
+            }
+        }
+        decodeRecord(&(pending[0]), (int) pending.size(), actions);
+        pending.clear();
+    }
+    while (p < end) {
+        if ((unsigned char) *p & ACTION_RECORD_TAG) {
+            if (end - p < ACTION_RECORD_SIZE)
+                break;
+            decodeRecord(p, ACTION_RECORD_SIZE, actions);
+            p += ACTION_RECORD_SIZE;
+            continue;
+        }
+        const char* nl = (const char*) memchr(p, '\n', end - p);
+        if (nl == 0)
+            break;
+        decodeRecord(p, (int)(nl + 1 - p), actions);
+        p = nl + 1;
+    }
+    if (end - p > MAX_ACTION_LINE) {
+        ++numErrors;
+        p = end;
+    }
+    pending.assign(p, end);
+}
+
+void ActionDecoder::finish(std::vector<Action>& actions) {
+    if (pending.empty())
+        return;
+    if ((unsigned char) pending[0] & ACTION_RECORD_TAG) {
+        ++numErrors;        // Truncated
+    } else {
+        pending.push_back('\n');
+        decodeRecord(&(pending[0]), (int) pending.size(), actions);
+    }
+    pending.clear();
+}
+
+bool readActions(FILE* f, std::vector<Action>& actions) {
+    char line[256];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), f) != 0) {
+        ++lineNumber;
+        const char* s = line;
+        while (*s == ' ' || *s == '\t')
+            ++s;
+        if (*s == '#' || *s == '\n' || *s == '\r' || *s == 0)
+            continue;
+        Action a;
+        if (!parseAction(s, a)) {
+            fprintf(stderr, "Line %d: bad action: %s", lineNumber, line);
+            return false;
+        }
+        actions.push_back(a);
+    }
+    return true;
+}
+
+bool loadBoard(FILE* f, const char* name, Board& board) {
+    char line[MAX_ACTION_LINE];
+    int lineNumber = 0;
+    bool ok = true;
+    // After the header of a saved board, the strokes are stored as
+    // they were committed: decimating them again would move points
+    bool saved = false;
+    Stroke str;
+    while (fgets(line, sizeof(line), f) != 0) {
+        ++lineNumber;
+        const char* s = line;
+        while (*s == ' ' || *s == '\t')
+            ++s;
+        if (*s == '#' || *s == '\n' || *s == '\r' || *s == 0)
+            continue;
+        Action a;
+        if (strncmp(s, "board", 5) == 0 && atLineEnd(s + 5)) {
+            saved = true;
+            continue;
+        } else if (strncmp(s, "page ", 5) == 0) {
+            int page;
+            s = parseInt(s + 5, page);
+            if (s != 0 && atLineEnd(s) && page >= 0 && page < MAX_PAGES) {
+                board.currentPage = page;
+                continue;
+            }
+        } else if (parseAction(s, a)) {
+            if (!saved) {
+                board.processAction(a);
+                continue;
+            }
+            if (a.type == Action::START_CURVE) {
+                str.clear();
+                str.color = a.color;
+                str.width = a.width;
+                str.append(a.point, a.pressure, a.fraction);
+                continue;
+            } else if (str.size() > 0 && (
+                a.type == Action::DRAW_CURVE || a.type == Action::END_CURVE
+            )) {
+                // The end of a single point repeats it
+                if (
+                    a.point != str.points.back() ||
+                    a.fraction != str.fraction(str.size() - 1)
+                )
+                    str.append(a.point, a.pressure, a.fraction);
+                if (a.type == Action::END_CURVE) {
+                    str.finalize();
+                    board.page().addStroke(str);
+                    str.clear();
+                }
+                continue;
+            }
+        }
+        fprintf(stderr, "%s:%d: bad line: %s", name, lineNumber, line);
+        ok = false;
+        break;
+    }
+    board.currentPage = 0;
+    board.damage.clear();
+    board.pageDamage.clear();
+    return ok;
+}
@@ -0,0 +1,81 @@
+//
+// Recorded action streams in text form, one action per line:
+//     start <color> <width> <x> <y> [<pressure>]
+//     draw <x> <y> [<pressure>]
+//     end <x> <y> [<pressure>]
+// in world coordinates, with decimals for points finer than a pixel
+// (read to the nearest sixteenth); the pressure (0..255) is only
+// written for tablet input. Actions of a finger on a touch screen are prefixed
+// with "touch <id> ". Empty lines and lines starting with '#' are
+// skipped. A saved board is such a stream in which
+//     page <n>
+// lines select the page (0..MAX_PAGES-1) of the actions after them.
+// Scripts may also use binary records of ACTION_RECORD_SIZE bytes,
+// little-endian, mixed freely with the text lines:
+//     0: ACTION_RECORD_TAG | type     4-5: width (start)
+//     1: ACTION_RECORD_* flags        6-7: touch id
+//     2: pressure                     8-11: x
+//     3: color (start)               12-15: y
+// Their points are whole pixels.
+//
+#ifndef ACTIONIO_H
+#define ACTIONIO_H
+
+#include <stdio.h>
+#include <vector>
+#include "board.h"
+
+const int ACTION_RECORD_SIZE = 16;
+// The first byte of a binary record; no text line starts with it
+const int ACTION_RECORD_TAG = 0x80;
+const int ACTION_RECORD_PRESSURE = 1;
+const int ACTION_RECORD_TOUCH = 2;
+// Longer text lines are errors
+const int MAX_ACTION_LINE = 256;
+
+void writeAction(FILE* f, const Action& a);
+// The actions that draw a committed stroke
+void writeStroke(FILE* f, const Stroke& str);
+// The page of the actions after it, in a saved board
+void writePage(FILE* f, int page);
+// The first line of a saved board, whose strokes are then read
+// back point for point, without decimation
+void writeBoardHeader(FILE* f);
+void writeActionBinary(FILE* f, const Action& a);
+void encodeAction(const Action& a, unsigned char* record);
+bool decodeAction(const unsigned char* record, Action& a);
+
+// Parse one line, ended by '\n' or 0; return false if it is not
+// an action
+bool parseAction(const char* line, Action& a);
+
+// Splits a byte stream of text lines and binary records into
+// actions; the data may end in the middle of a record
+class ActionDecoder {
+public:
+    long long numErrors;        // Records that are not actions
+
+    ActionDecoder();
+
+    void reset();
+    // Append the actions of the records completed by the data
+    void decode(const char* data, int n, std::vector<Action>& actions);
+    // At the end of the stream: the last line may lack its '\n'
+    void finish(std::vector<Action>& actions);
+
+private:
+    std::vector<char> pending;  // Incomplete record
+
+    void decodeRecord(const char* p, int n, std::vector<Action>& actions);
+};
+
+// Append all actions of the file; return false on a syntax error,
+// reported to stderr with the line number
+bool readActions(FILE* f, std::vector<Action>& actions);
+
+// Apply a saved board or a recording to the board, which is left
+// on page 0; return false on a syntax error, reported to stderr
+// with the file name and line number
+bool loadBoard(FILE* f, const char* name, Board& board);
+
+#endif
@@ -0,0 +1,33 @@
+#include "allocstats.h"
+
+const char* const allocSubsystemNames[NUM_ALLOC_SUBSYSTEMS] = {
+    "points",
+    "paths",
+    "images",
+    "pages"
+};
+
+bool allocCounting = true;
+AllocCounter allocCounters[NUM_ALLOC_SUBSYSTEMS];
+
+long long totalAllocations() {
+    long long n = 0;
+    for (int i = 0; i < NUM_ALLOC_SUBSYSTEMS; ++i)
+        n += allocCounters[i].allocations;
+    return n;
+}
+
+void reportAllocations(FILE* f) {
+    fprintf(
+        f, "%-8s %12s %12s %8s %12s %12s\n",
+        "memory", "allocations", "frees", "live", "KB now", "KB peak"
+    );
+    for (int i = 0; i < NUM_ALLOC_SUBSYSTEMS; ++i) {
+        const AllocCounter& c = allocCounters[i];
+        fprintf(
+            f, "%-8s %12lld %12lld %8lld %12lld %12lld\n",
+            allocSubsystemNames[i], c.allocations, c.frees,
+            c.allocations - c.frees, c.bytes / 1024, c.peakBytes / 1024
+        );
+    }
+}
@@ -0,0 +1,78 @@
+//
+// Allocation accounting by subsystem: heap blocks and bytes of
+// stroke points, painter paths, images and page stroke arrays.
+// Counted at the places that allocate or free them, in the GUI
+// thread only: tools that build strokes or paths on several
+// threads turn the counting off.
+//
+#ifndef ALLOCSTATS_H
+#define ALLOCSTATS_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+enum AllocSubsystem {
+    ALLOC_STROKE_POINTS = 0,    // Points and LOD levels of strokes
+    ALLOC_PATHS,                // Cached painter paths of strokes
+    ALLOC_IMAGES,               // Offscreen, sprite and tile images
+    ALLOC_PAGES,                // Stroke arrays of pages
+    NUM_ALLOC_SUBSYSTEMS
+};
+
+extern const char* const allocSubsystemNames[NUM_ALLOC_SUBSYSTEMS];
+
+// True by default
+extern bool allocCounting;
+
+class AllocCounter {
+public:
+    long long allocations;
+    long long frees;
+    long long bytes;            // Allocated now
+    long long peakBytes;
+    long long totalBytes;       // Allocated during the session
+
+    AllocCounter():
+        allocations(0),
+        frees(0),
+        bytes(0),
+        peakBytes(0),
+        totalBytes(0)
+    {}
+
+    void allocated(long long size) {
+        if (!allocCounting)
+            return;
+        ++allocations;
+        bytes += size;
+        totalBytes += size;
+        if (bytes > peakBytes)
+            peakBytes = bytes;
+    }
+
+    void freed(long long size, long long blocks = 1) {
+        if (!allocCounting)
+            return;
+        frees += blocks;
+        bytes -= size;
+    }
+
+    // A vector buffer went from oldCapacity to newCapacity elements
+    void resized(size_t oldCapacity, size_t newCapacity, size_t elementSize) {
+        if (oldCapacity == newCapacity)
+            return;
+        if (oldCapacity > 0)
+            freed((long long)(oldCapacity * elementSize));
+        if (newCapacity > 0)
+            allocated((long long)(newCapacity * elementSize));
+    }
+};
+
+extern AllocCounter allocCounters[NUM_ALLOC_SUBSYSTEMS];
+
+long long totalAllocations();
+
+// Per-subsystem table for the session report
+void reportAllocations(FILE* f);
+
+#endif
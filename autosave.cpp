@@ -0,0 +1,75 @@
+#include <unistd.h>
+#include "autosave.h"
+#include "actionio.h"
+#include "latency.h"
+#include "tracer.h"
+
+// Write buffer of the save file
+static const int AUTOSAVE_BUFFER_SIZE = 1 << 20;
+
+AutoSaver::AutoSaver():
+    QThread(),
+    snapshot(),
+    path(),
+    ok(false),
+    numStrokes(0),
+    time(0)
+{}
+
+AutoSaver::~AutoSaver() {
+    wait();
+}
+
+void AutoSaver::run() {
+    TraceSpan span("autosave");
+    long long t0 = latencyClock();
+    // Handles of our own first: once the shared arrays are released,
+    // the GUI thread can change its pages without copying them
+    for (int p = 0; p < MAX_PAGES; ++p) {
+        const StrokeList& list = snapshot.pages[p];
+        strokes[p].reserve(list.size());
+        for (size_t i = 0; i < list.size(); ++i)
+            strokes[p].push_back(list[i]);
+        snapshot.pages[p] = StrokeList();
+    }
+
+    std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "w");
+    if (f == 0) {
+        perror(tmp.c_str());
+        ok = false;
+        return;
+    }
+    setvbuf(f, 0, _IOFBF, AUTOSAVE_BUFFER_SIZE);
+    ok = write(f);
+    if (ok && (fflush(f) != 0 || fsync(fileno(f)) != 0))
+        ok = false;
+    if (fclose(f) != 0)
+        ok = false;
+    if (ok && rename(tmp.c_str(), path.c_str()) != 0) {
+        perror(path.c_str());
+        ok = false;
+    }
+    if (!ok)
+        unlink(tmp.c_str());
+    time = latencyClock() - t0;
+}
+
+bool AutoSaver::write(FILE* f) {
+    writeBoardHeader(f);
+    for (int p = 0; p < MAX_PAGES; ++p) {
+        if (strokes[p].empty())
+            continue;
+        writePage(f, p);
+        for (unsigned int i = 0; i < strokes[p].size(); ++i) {
+            writeStroke(f, *strokes[p][i]);
+            ++numStrokes;
+            if (
+                numStrokes % AUTOSAVE_CHECK_INTERVAL == 0 &&
+                isInterruptionRequested()
+            )
+                return false;
+        }
+    }
+    return !ferror(f);
+}
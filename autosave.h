@@ -0,0 +1,47 @@
+//
+// Autosave of the board off the GUI thread. The GUI thread takes
+// an O(1) snapshot of the pages (BoardSnapshot) and an AutoSaver
+// writes it as a saved board (see actionio.h) to a temporary file
+// next to the target, flushes it to the disk and renames it over
+// the target: the file is always a complete save, the previous or
+// the new one.
+//
+#ifndef AUTOSAVE_H
+#define AUTOSAVE_H
+
+#include <QThread>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "board.h"
+
+// Seconds between autosaves by default
+const int DEFAULT_AUTOSAVE_INTERVAL = 60;
+// Strokes between checks for a stop request
+const int AUTOSAVE_CHECK_INTERVAL = 1024;
+
+class AutoSaver: public QThread {
+public:
+    BoardSnapshot snapshot;     // Fill before start()
+    std::string path;
+
+    // Results, read after the thread has finished
+    bool ok;
+    int numStrokes;             // Written
+    long long time;             // Microseconds
+
+    AutoSaver();
+    // Delete it on the GUI thread: it may hold the last references
+    // to strokes, which are then freed with their path caches
+    ~AutoSaver();
+
+protected:
+    void run();
+
+private:
+    std::vector<StrokeRef> strokes[MAX_PAGES];  // Of the snapshot
+
+    bool write(FILE* f);
+};
+
+#endif
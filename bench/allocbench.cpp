@@ -0,0 +1,56 @@
+//
+// Allocation regression benchmark: draws synthetic strokes through
+// the board engine and fails (exit status 1) if the allocations
+// per input point exceed the threshold. Needs no display.
+// Run as:  allocbench [numStrokes]
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "board.h"
+#include "rasterrenderer.h"
+#include "handwriting.h"
+
+
+// Heap blocks of stroke points and page arrays per input point.
+// 0.0205 with the default workload and libstdc++; the margin allows
+// for other vector growth policies.
+static const double MAX_ALLOCATIONS_PER_POINT = 0.05;
+
+int main(int argc, char *argv[]) {
+    int numStrokes = 2000;
+    if (argc > 1 && atoi(argv[1]) > 0)
+        numStrokes = atoi(argv[1]);
+
+    srand(1);
+    std::vector<Action> actions;
+    for (int i = 0; i < numStrokes; ++i)
+        makeHandwriting(actions, PAGE_WIDTH - 400, 80, 379);
+
+    Board board;
+    Raster raster(PAGE_WIDTH, PAGE_HEIGHT);
+    RasterRenderer renderer(&raster);
+
+    long long before = totalAllocations();
+    for (unsigned int i = 0; i < actions.size(); ++i) {
+        board.processAction(actions[i]);
+        board.drawLiveInk(renderer);
+        board.damage.clear();
+        board.pageDamage.clear();
+    }
+    long long allocations = totalAllocations() - before;
+
+    reportAllocations(stdout);
+    double perPoint = (double) allocations / (double) actions.size();
+    printf(
+        "%lld allocations for %d input points: %.4f per point (max %.4f)\n",
+        allocations, (int) actions.size(), perPoint,
+        MAX_ALLOCATIONS_PER_POINT
+    );
+    if (perPoint > MAX_ALLOCATIONS_PER_POINT) {
+        printf("FAIL\n");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,14 @@
+TEMPLATE = app
+TARGET = allocbench
+INCLUDEPATH += ..
+DEPENDPATH += ..
+
+CONFIG += console
+CONFIG -= app_bundle qt
+
+# Fails if the board engine allocates too often per input point
+HEADERS += handwriting.h ../board.h ../renderbackend.h ../raster.h ../rasterrenderer.h \
+    ../R2Graph.h ../strokegrid.h ../polyline.h ../allocstats.h
+SOURCES += allocbench.cpp \
+    ../board.cpp ../raster.cpp ../rasterrenderer.cpp \
+    ../R2Graph.cpp ../strokegrid.cpp ../polyline.cpp ../allocstats.cpp
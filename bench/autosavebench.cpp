@@ -0,0 +1,162 @@
+//
+// Benchmark of the autosave: a board of numStrokes handwriting
+// strokes is saved by AutoSaver while this thread keeps applying
+// pen events to it, as the GUI thread does during a lecture. It
+// reports the cost of the snapshot and of the first change of the
+// page after it, the save time, and the time of the pen events
+// with and without a save running. The save is then loaded back
+// and compared with the snapshot.
+// Run as:
+//   autosavebench [-n strokes] [-o file]
+// Without -o the save goes to autosavebench.board in the temporary
+// directory and is removed at the end.
+//
+#include <QDir>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include "board.h"
+#include "autosave.h"
+#include "actionio.h"
+#include "latency.h"
+#include "handwriting.h"
+
+static const int NUM_BASELINE_EVENTS = 400000;
+
+// Pen events of a handwriting-like stroke of about 80 points
+static void makeStroke(std::vector<Action>& events) {
+    events.clear();
+    makeHandwriting(events, PAGE_WIDTH - 200, 40, 40);
+}
+
+// Apply the events of new strokes until numEvents are applied or,
+// with numEvents < 0, until the saver has finished
+static long long drawStrokes(
+    Board& board, int numEvents, const AutoSaver* saver,
+    LatencyHistogram& times
+) {
+    std::vector<Action> events;
+    long long n = 0;
+    while (true) {
+        makeStroke(events);
+        for (unsigned int i = 0; i < events.size(); ++i) {
+            long long t0 = latencyClock();
+            board.processAction(events[i]);
+            times.record(latencyClock() - t0);
+        }
+        board.damage.clear();
+        board.pageDamage.clear();
+        n += (long long) events.size();
+        if (numEvents >= 0 && n >= numEvents)
+            return n;
+        if (numEvents < 0 && saver->isFinished())
+            return n;
+    }
+}
+
+static void printTimes(const char* name, const LatencyHistogram& h) {
+    printf(
+        "pen event %s: p50 %lld us, p99 %lld us, p99.9 %lld us,"
+        " max %lld us (%lld events)\n",
+        name, h.percentile(0.5), h.percentile(0.99), h.percentile(0.999),
+        h.maxValue, h.count
+    );
+}
+
+int main(int argc, char *argv[]) {
+    int numStrokes = 100000;
+    std::string file = QDir::tempPath().toStdString() + "/autosavebench.board";
+    bool keep = false;
+    for (int i = 1; i < argc - 1; ++i) {
+        if (strcmp(argv[i], "-n") == 0) {
+            numStrokes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0) {
+            file = argv[++i];
+            keep = true;
+        }
+    }
+    const char* path = file.c_str();
+
+    srand(1);
+    Board board;
+    std::vector<Action> events;
+    for (int i = 0; i < numStrokes; ++i) {
+        makeStroke(events);
+        for (unsigned int k = 0; k < events.size(); ++k)
+            board.processAction(events[k]);
+    }
+    board.damage.clear();
+    board.pageDamage.clear();
+
+    LatencyHistogram idle;
+    drawStrokes(board, NUM_BASELINE_EVENTS, 0, idle);
+
+    AutoSaver* saver = new AutoSaver();
+    long long t0 = latencyClock();
+    board.takeSnapshot(saver->snapshot);
+    long long snapshotTime = latencyClock() - t0;
+    BoardSnapshot check;        // Kept for the comparison
+    board.takeSnapshot(check);
+    saver->path = path;
+    saver->start();
+    LatencyHistogram busy;
+    drawStrokes(board, -1, saver, busy);
+    saver->wait();
+
+    printf(
+        "%d strokes, snapshot %lld us, saved to %s in %.2f s: %s\n",
+        check.numStrokes(), snapshotTime, path, saver->time * 1e-6,
+        saver->ok? "ok" : "FAILED"
+    );
+    printTimes("without save", idle);
+    printTimes("during save ", busy);
+    bool ok = saver->ok;
+    delete saver;
+
+    // The first change after a snapshot that is still held copies
+    // the handles of the page
+    {
+        BoardSnapshot held;
+        board.takeSnapshot(held);
+        LatencyHistogram first;
+        drawStrokes(board, 1, 0, first);
+        printf(
+            "first stroke with a snapshot held: max %lld us per event\n",
+            first.maxValue
+        );
+    }
+
+    FILE* f = fopen(path, "r");
+    Board loaded;
+    if (f == 0 || !loadBoard(f, path, loaded))
+        ok = false;
+    if (f != 0)
+        fclose(f);
+    int numDiffering = 0;
+    for (int p = 0; p < MAX_PAGES; ++p) {
+        const StrokeList& saved = check.pages[p];
+        const StrokeList& read = loaded.pages[p].strokes;
+        if (saved.size() != read.size()) {
+            numDiffering += abs((int) saved.size() - (int) read.size());
+            continue;
+        }
+        for (size_t i = 0; i < saved.size(); ++i) {
+            const Stroke& s = *saved[i];
+            const Stroke& r = *read[i];
+            if (
+                s.points != r.points || s.pressures != r.pressures ||
+                s.color != r.color || s.width != r.width
+            )
+                ++numDiffering;
+        }
+    }
+    printf(
+        "loaded back: %d strokes, %d differ\n",
+        (int) loaded.pages[0].strokes.size(), numDiffering
+    );
+    if (!keep)
+        remove(path);
+    return (ok && numDiffering == 0)? 0 : 1;
+}
@@ -0,0 +1,15 @@
+TEMPLATE = app
+TARGET = autosavebench
+INCLUDEPATH += ..
+DEPENDPATH += ..
+
+QT -= gui
+CONFIG += console
+CONFIG -= app_bundle
+
+# Background autosave from copy-on-write snapshots, and its round trip
+HEADERS += handwriting.h ../autosave.h ../actionio.h ../board.h ../R2Graph.h \
+    ../strokegrid.h ../polyline.h ../allocstats.h ../latency.h ../tracer.h
+SOURCES += autosavebench.cpp ../autosave.cpp ../actionio.cpp ../board.cpp \
+    ../R2Graph.cpp ../strokegrid.cpp ../polyline.cpp ../allocstats.cpp \
+    ../latency.cpp ../tracer.cpp
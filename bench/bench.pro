@@ -0,0 +1,5 @@
+# All benchmarks:  qmake bench.pro && make
+TEMPLATE = subdirs
+SUBDIRS = boardbench.pro enginebench.pro lodbench.pro allocbench.pro predictbench.pro \
+    renderhash.pro filterbench.pro inputbench.pro ingestbench.pro \
+    exportbench.pro autosavebench.pro boardgen.pro
@@ -0,0 +1,291 @@
+//
+// Benchmark of the Qt whiteboard widget on synthetic workloads:
+// handwriting and diagram strokes are driven through
+// WhiteBoard::processAction on an offscreen widget. For every
+// stroke count it measures the time per input event and per
+// stroke end, the full drawInOffscreen time, the resize time and
+// the memory per stroke. Results are written as JSON, with a hash
+// of the redrawn image: the workloads are fixed (srand(1)), so the
+// hashes of a reference run must reproduce with the same Qt.
+// Run as:
+//   boardbench [-n 100,200,400,800] [-l maxLength] [-w maxWidth]
+//              [-d diagramPercent] [-o results.json] -platform offscreen
+//
+#include <QApplication>
+#include <QElapsedTimer>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include "whitebrd.h"
+#include "latency.h"
+#include "allocstats.h"
+
+static const int PAGE_WIDTH = 1920;
+static const int PAGE_HEIGHT = 1080;
+static const int NUM_REPEATS = 5;
+
+class Workload {
+public:
+    std::vector<int> strokeCounts;
+    int maxLength;          // Of a handwriting stroke, in pixels
+    int maxWidth;
+    int diagramPercent;     // Lines, rectangles and circles
+
+    Workload():
+        strokeCounts(),
+        maxLength(380),
+        maxWidth(5),
+        diagramPercent(20)
+    {}
+};
+
+static void addPoint(
+    std::vector<Action>& actions, int& type,
+    int color, int width, double x, double y
+) {
+    actions.push_back(Action(
+        type, color, width, I2Point((int)(x + 0.5), (int)(y + 0.5))
+    ));
+    type = Action::DRAW_CURVE;
+}
+
+// Handwriting-like stroke: a loop train sampled at 0.5 px steps
+static void makeHandwriting(
+    const Workload& wl, std::vector<Action>& actions
+) {
+    double x0 = 40. + rand() % (PAGE_WIDTH - wl.maxLength - 40);
+    double y0 = 60. + rand() % (PAGE_HEIGHT - 120);
+    double len = 20. + rand() % (wl.maxLength - 19);
+    double amp = 6. + rand() % 20;
+    int color = rand() % 4;
+    int width = 1 + rand() % wl.maxWidth;
+    int type = Action::START_CURVE;
+    for (double t = 0.; t <= len; t += 0.5) {
+        addPoint(
+            actions, type, color, width,
+            x0 + t + amp*0.7*sin(t/amp*2.), y0 + amp*cos(t/amp*2.)
+        );
+    }
+    actions.back().type = Action::END_CURVE;
+}
+
+// Diagram stroke: a straight line, a rectangle or a circle,
+// sampled at 2 px steps like a fast hand
+static void makeDiagram(const Workload& wl, std::vector<Action>& actions) {
+    double size = 40. + rand() % 300;
+    double x0 = rand() % (int)(PAGE_WIDTH - size);
+    double y0 = 40. + rand() % (int)(PAGE_HEIGHT - size - 40);
+    int color = rand() % 4;
+    int width = 1 + rand() % wl.maxWidth;
+    int type = Action::START_CURVE;
+    int shape = rand() % 3;
+    if (shape == 0) {
+        double dx = size, dy = (rand() % 200) - 100.;
+        double len = sqrt(dx*dx + dy*dy);
+        for (double t = 0.; t <= len; t += 2.)
+            addPoint(actions, type, color, width, x0 + dx*t/len, y0 + dy*t/len);
+    } else if (shape == 1) {
+        const double cx[5] = {0., 1., 1., 0., 0.};
+        const double cy[5] = {0., 0., 1., 1., 0.};
+        for (int side = 0; side < 4; ++side) {
+            for (double t = 0.; t < size; t += 2.) {
+                double k = t / size;
+                addPoint(
+                    actions, type, color, width,
+                    x0 + size*(cx[side] + (cx[side+1] - cx[side])*k),
+                    y0 + size*(cy[side] + (cy[side+1] - cy[side])*k)
+                );
+            }
+        }
+    } else {
+        double r = size/2.;
+        for (double t = 0.; t <= 2.*M_PI*r; t += 2.) {
+            addPoint(
+                actions, type, color, width,
+                x0 + r + r*cos(t/r), y0 + r + r*sin(t/r)
+            );
+        }
+    }
+    actions.back().type = Action::END_CURVE;
+}
+
+// FNV-1a over the RGB values of the pixels
+static unsigned int imageHash(const QImage& im) {
+    unsigned int hash = 2166136261u;
+    for (int y = 0; y < im.height(); ++y) {
+        const QRgb* p = (const QRgb*) im.constScanLine(y);
+        for (int x = 0; x < im.width(); ++x)
+            hash = (hash ^ (p[x] & 0xffffff)) * 16777619u;
+    }
+    return hash;
+}
+
+static long long strokeBytes() {
+    return
+        allocCounters[ALLOC_STROKE_POINTS].bytes +
+        allocCounters[ALLOC_PATHS].bytes +
+        allocCounters[ALLOC_PAGES].bytes;
+}
+
+static void printHistogram(
+    FILE* f, const char* name, const LatencyHistogram& h, double sum
+) {
+    // Recorded in nanoseconds
+    fprintf(
+        f,
+        "      \"%s\": {\"count\": %lld, \"mean\": %.3f, "
+        "\"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f},\n",
+        name, h.count, (h.count > 0)? sum / h.count * 1e-3 : 0.,
+        h.percentile(0.5) * 1e-3, h.percentile(0.99) * 1e-3,
+        h.maxValue * 1e-3
+    );
+}
+
+static void parseCounts(const char* s, std::vector<int>& counts) {
+    counts.clear();
+    while (*s != 0) {
+        int n = atoi(s);
+        if (n > 0)
+            counts.push_back(n);
+        const char* comma = strchr(s, ',');
+        if (comma == 0)
+            break;
+        s = comma + 1;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    QApplication app(argc, argv);
+
+    Workload wl;
+    const char* output = 0;
+    for (int i = 1; i < argc - 1; ++i) {
+        if (strcmp(argv[i], "-n") == 0)
+            parseCounts(argv[++i], wl.strokeCounts);
+        else if (strcmp(argv[i], "-l") == 0)
+            wl.maxLength = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-w") == 0)
+            wl.maxWidth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-d") == 0)
+            wl.diagramPercent = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0)
+            output = argv[++i];
+    }
+    if (wl.strokeCounts.empty()) {
+        const int defaults[4] = {100, 200, 400, 800};
+        wl.strokeCounts.assign(defaults, defaults + 4);
+    }
+    if (wl.maxLength < 40)
+        wl.maxLength = 40;
+    if (wl.maxLength > PAGE_WIDTH/2)
+        wl.maxLength = PAGE_WIDTH/2;
+    if (wl.maxWidth < 1)
+        wl.maxWidth = 1;
+
+    FILE* f = stdout;
+    if (output != 0) {
+        f = fopen(output, "w");
+        if (f == 0) {
+            perror(output);
+            return 1;
+        }
+    }
+
+    WhiteBoard w;
+    w.mode = MODE_NORMAL;
+    w.resize(PAGE_WIDTH, PAGE_HEIGHT);
+    w.show();
+    app.processEvents();
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"benchmark\": \"boardbench\",\n");
+    fprintf(
+        f, "  \"window\": [%d, %d], \"max_length\": %d, "
+        "\"max_width\": %d, \"diagram_percent\": %d,\n",
+        PAGE_WIDTH, PAGE_HEIGHT, wl.maxLength, wl.maxWidth,
+        wl.diagramPercent
+    );
+    fprintf(f, "  \"runs\": [\n");
+
+    QElapsedTimer timer;
+    for (unsigned int run = 0; run < wl.strokeCounts.size(); ++run) {
+        int numStrokes = wl.strokeCounts[run];
+        srand(1);
+        std::vector<Action> actions;
+        for (int i = 0; i < numStrokes; ++i) {
+            if (rand() % 100 < wl.diagramPercent)
+                makeDiagram(wl, actions);
+            else
+                makeHandwriting(wl, actions);
+        }
+
+        w.init();
+        long long bytesBefore = strokeBytes();
+
+        // Every event is drawn at once, as if each one had a frame
+        LatencyHistogram events, strokeEnds;
+        double eventSum = 0., strokeEndSum = 0.;
+        for (unsigned int i = 0; i < actions.size(); ++i) {
+            timer.start();
+            w.processAction(actions[i]);
+            if (actions[i].type == Action::DRAW_CURVE)
+                w.onFrame();
+            long long t = timer.nsecsElapsed();
+            if (actions[i].type == Action::END_CURVE) {
+                strokeEnds.record(t);
+                strokeEndSum += t;
+            } else {
+                events.record(t);
+                eventSum += t;
+            }
+        }
+        w.frameTimer.stop();
+
+        timer.start();
+        for (int r = 0; r < NUM_REPEATS; ++r)
+            w.drawInOffscreen();
+        double redraw = (double) timer.nsecsElapsed() / 1e6 / NUM_REPEATS;
+        unsigned int hash = imageHash(*w.offscreenImage());
+        double bytesPerStroke =
+            (double)(strokeBytes() - bytesBefore) / numStrokes;
+
+        timer.start();
+        for (int r = 0; r < NUM_REPEATS; ++r) {
+            w.resize(PAGE_WIDTH - 320, PAGE_HEIGHT - 180);
+            app.processEvents();
+            w.resize(PAGE_WIDTH, PAGE_HEIGHT);
+            app.processEvents();
+        }
+        double resize = (double) timer.nsecsElapsed() / 1e6 / (2*NUM_REPEATS);
+
+        fprintf(f, "    {\n");
+        fprintf(
+            f, "      \"strokes\": %d, \"events\": %d,\n",
+            numStrokes, (int) actions.size()
+        );
+        printHistogram(f, "event_us", events, eventSum);
+        printHistogram(f, "stroke_end_us", strokeEnds, strokeEndSum);
+        fprintf(f, "      \"redraw_ms\": %.3f,\n", redraw);
+        fprintf(f, "      \"resize_ms\": %.3f,\n", resize);
+        fprintf(f, "      \"bytes_per_stroke\": %.1f,\n", bytesPerStroke);
+        fprintf(f, "      \"image_hash\": \"%08x\"\n", hash);
+        fprintf(f, "    }%s\n", (run + 1 < wl.strokeCounts.size())? "," : "");
+
+        fprintf(
+            stderr,
+            "%5d strokes: event p50 %.2f us, p99 %.2f us; stroke end "
+            "p50 %.2f ms; redraw %.2f ms; resize %.2f ms; %.0f B/stroke; "
+            "image %08x\n",
+            numStrokes, events.percentile(0.5) * 1e-3,
+            events.percentile(0.99) * 1e-3,
+            strokeEnds.percentile(0.5) * 1e-6, redraw, resize,
+            bytesPerStroke, hash
+        );
+    }
+    fprintf(f, "  ]\n}\n");
+    if (f != stdout)
+        fclose(f);
+    return 0;
+}
@@ -0,0 +1,84 @@
+//
+// Writes an archive of saved boards for boardrender: every board
+// has numPages pages of numStrokes handwriting strokes. The boards
+// depend only on their number, so an archive can be rebuilt
+// anywhere. Each file is loaded back, as boardrender does, and the
+// pages and strokes found are reported. Needs no display. Run as:
+//   boardgen [-n boards] [-p pages] [-s strokes] [-o outDir]
+// with at most MAX_PAGES pages.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "board.h"
+#include "actionio.h"
+#include "handwriting.h"
+
+static bool writeBoard(const char* path, int seed, int numPages, int numStrokes) {
+    FILE* f = fopen(path, "w");
+    if (f == 0) {
+        perror(path);
+        return false;
+    }
+    srand(seed);
+    writeBoardHeader(f);
+    std::vector<Action> actions;
+    for (int p = 0; p < numPages; ++p) {
+        writePage(f, p);
+        for (int s = 0; s < numStrokes; ++s) {
+            actions.clear();
+            makeHandwriting(actions, PAGE_WIDTH - 400, 80, 379);
+            for (unsigned int i = 0; i < actions.size(); ++i)
+                writeAction(f, actions[i]);
+        }
+    }
+    return fclose(f) == 0;
+}
+
+int main(int argc, char *argv[]) {
+    int numBoards = 50;
+    int numPages = MAX_PAGES;
+    int numStrokes = 100;
+    const char* outDir = ".";
+    for (int i = 1; i < argc - 1; ++i) {
+        if (strcmp(argv[i], "-n") == 0)
+            numBoards = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-p") == 0)
+            numPages = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0)
+            numStrokes = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0)
+            outDir = argv[++i];
+    }
+    if (numPages < 1 || numPages > MAX_PAGES)
+        numPages = MAX_PAGES;
+
+    long long totalStrokes = 0;
+    int totalPages = 0;
+    char path[1024];
+    for (int b = 0; b < numBoards; ++b) {
+        snprintf(path, sizeof(path), "%s/board%04d.txt", outDir, b);
+        if (!writeBoard(path, b + 1, numPages, numStrokes))
+            return 1;
+        FILE* f = fopen(path, "r");
+        if (f == 0) {
+            perror(path);
+            return 1;
+        }
+        Board board;
+        bool ok = loadBoard(f, path, board);
+        fclose(f);
+        if (!ok)
+            return 1;
+        for (int p = 0; p < MAX_PAGES; ++p) {
+            if (!board.pages[p].strokes.empty())
+                ++totalPages;
+            totalStrokes += (long long) board.pages[p].strokes.size();
+        }
+    }
+    printf(
+        "%d boards written to %s: %d pages, %lld strokes\n",
+        numBoards, outDir, totalPages, totalStrokes
+    );
+    return 0;
+}
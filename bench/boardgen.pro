@@ -0,0 +1,13 @@
+TEMPLATE = app
+TARGET = boardgen
+INCLUDEPATH += ..
+DEPENDPATH += ..
+
+CONFIG += console
+CONFIG -= app_bundle qt
+
+# Writes a board archive for boardrender, no display needed
+HEADERS += handwriting.h ../actionio.h ../board.h \
+    ../R2Graph.h ../strokegrid.h ../polyline.h ../allocstats.h
+SOURCES += boardgen.cpp ../actionio.cpp ../board.cpp \
+    ../R2Graph.cpp ../strokegrid.cpp ../polyline.cpp ../allocstats.cpp
@@ -0,0 +1,124 @@
+//
+// Benchmark of the board engine with the headless raster backend:
+// input processing with live ink, then full-page redraws.
+// With numFingers > 1 the strokes are drawn that many at a time,
+// as on a touch screen, and the live ink is drawn once per round
+// of events. Needs no display. Run as:
+//   enginebench [numStrokes [numFingers]]
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "board.h"
+#include "rasterrenderer.h"
+#include "handwriting.h"
+
+static const int NUM_REPEATS = 5;
+
+static double now() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double) t.tv_sec + (double) t.tv_nsec * 1e-9;
+}
+
+// Groups of numFingers strokes drawn at the same time: the events
+// of a group are taken round-robin, one per finger
+static void interleave(std::vector<Action>& actions, int numFingers) {
+    std::vector<unsigned int> starts;
+    for (unsigned int i = 0; i < actions.size(); ++i) {
+        if (actions[i].type == Action::START_CURVE)
+            starts.push_back(i);
+    }
+    starts.push_back((unsigned int) actions.size());
+    std::vector<Action> res;
+    res.reserve(actions.size());
+    for (unsigned int g = 0; g + 1 < starts.size(); g += numFingers) {
+        unsigned int e = g + numFingers;
+        if (e > starts.size() - 1)
+            e = (unsigned int) starts.size() - 1;
+        std::vector<unsigned int> next(starts.begin() + g, starts.begin() + e);
+        bool more = true;
+        while (more) {
+            more = false;
+            for (unsigned int f = 0; f < next.size(); ++f) {
+                if (next[f] >= starts[g + f + 1])
+                    continue;
+                res.push_back(actions[next[f]++]);
+                res.back().touchId = (int) f;
+                more = true;
+            }
+        }
+    }
+    actions.swap(res);
+}
+
+int main(int argc, char *argv[]) {
+    int numStrokes = 2000;
+    if (argc > 1 && atoi(argv[1]) > 0)
+        numStrokes = atoi(argv[1]);
+    int numFingers = 1;
+    if (argc > 2 && atoi(argv[2]) > 0)
+        numFingers = atoi(argv[2]);
+
+    srand(1);
+    std::vector<Action> actions;
+    for (int i = 0; i < numStrokes; ++i)
+        makeHandwriting(actions, PAGE_WIDTH - 400, 80, 379);
+    if (numFingers > 1)
+        interleave(actions, numFingers);
+
+    Board board;
+    Raster raster(PAGE_WIDTH, PAGE_HEIGHT);
+    RasterRenderer renderer(&raster);
+    raster.fill(renderer.palette[WHITE_COLOR_IDX]);
+
+    // Input: every event (every round of events with many fingers)
+    // is processed and its ink drawn at once, the worst case for a
+    // frontend
+    std::vector<I2Rectangle> drawn;
+    double t0 = now();
+    for (unsigned int i = 0; i < actions.size(); ++i) {
+        board.processAction(actions[i]);
+        if ((i + 1) % numFingers != 0 && i + 1 < actions.size())
+            continue;
+        drawn.clear();
+        board.drawLiveInk(renderer, &drawn);
+        board.damage.clear();
+        board.pageDamage.clear();
+    }
+    double input = now() - t0;
+
+    long long numPoints = 0;
+    const Page& page = board.page();
+    for (unsigned int i = 0; i < page.strokes.size(); ++i)
+        numPoints += page.strokes[i]->size();
+
+    R2Rectangle all(0., 0., PAGE_WIDTH, PAGE_HEIGHT);
+    t0 = now();
+    for (int r = 0; r < NUM_REPEATS; ++r) {
+        raster.fill(renderer.palette[WHITE_COLOR_IDX]);
+        board.drawPage(renderer, all);
+    }
+    double redraw = (now() - t0) / NUM_REPEATS;
+
+    // Checksum, to compare runs
+    unsigned int hash = 2166136261u;
+    for (int y = 0; y < raster.height; ++y) {
+        const Pixel* p = raster.scanLine(y);
+        for (int x = 0; x < raster.width; ++x)
+            hash = (hash ^ p[x]) * 16777619u;
+    }
+
+    printf(
+        "strokes %d, fingers %d, input events %d, stored points %lld\n",
+        numStrokes, numFingers, (int) actions.size(), numPoints
+    );
+    printf(
+        "input + live ink: %.3f us/event\n",
+        input * 1e6 / (double) actions.size()
+    );
+    printf("full redraw %dx%d: %.2f ms\n", PAGE_WIDTH, PAGE_HEIGHT, redraw * 1e3);
+    printf("image hash %08x\n", hash);
+    return 0;
+}
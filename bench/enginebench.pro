@@ -0,0 +1,14 @@
+TEMPLATE = app
+TARGET = enginebench
+INCLUDEPATH += ..
+DEPENDPATH += ..
+
+CONFIG += console
+CONFIG -= app_bundle qt
+
+# Board engine with the headless raster backend, no display needed
+HEADERS += handwriting.h ../board.h ../renderbackend.h ../raster.h ../rasterrenderer.h \
+    ../R2Graph.h ../strokegrid.h ../polyline.h ../allocstats.h
+SOURCES += enginebench.cpp \
+    ../board.cpp ../raster.cpp ../rasterrenderer.cpp \
+    ../R2Graph.cpp ../strokegrid.cpp ../polyline.cpp ../allocstats.cpp
@@ -0,0 +1,149 @@
+//
+// Benchmark of the background export: a board of handwriting
+// strokes is exported by BoardExporter while this thread keeps
+// applying pen events to it, as the GUI thread does during a
+// lecture. It reports the cost of the snapshot, the export time
+// and throughput, the time of the pen events with and without an
+// export running, and the peak memory before and after the export.
+// Run as:
+//   exportbench [-n strokes] [-o file.{svg,png,pdf}] -platform offscreen
+//
+#include <QGuiApplication>
+#include <QFileInfo>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/resource.h>
+#include "board.h"
+#include "boardexport.h"
+#include "latency.h"
+#include "allocstats.h"
+#include "handwriting.h"
+
+static const int NUM_BASELINE_EVENTS = 200000;
+
+static long maxRssKb() {
+    rusage u;
+    getrusage(RUSAGE_SELF, &u);
+    return u.ru_maxrss;
+}
+
+// The size of the written files
+static long long outputBytes(const BoardExporter& exporter) {
+    if (exporter.format == EXPORT_PDF)
+        return QFileInfo(exporter.path).size();
+    long long n = 0;
+    for (int p = 0; p < MAX_PAGES; ++p) {
+        if (!exporter.snapshot.pages[p].empty())
+            n += QFileInfo(exporter.pagePath(p)).size();
+    }
+    return n;
+}
+
+// Pen events of a handwriting-like stroke of about 200 points
+static void makeStroke(std::vector<Action>& events) {
+    events.clear();
+    makeHandwriting(events, PAGE_WIDTH - 200, 100, 100);
+}
+
+// Apply the events of new strokes until numEvents are applied or,
+// with numEvents < 0, until the exporter has finished
+static long long drawStrokes(
+    Board& board, int numEvents, const BoardExporter* exporter,
+    LatencyHistogram& times
+) {
+    std::vector<Action> events;
+    long long n = 0;
+    while (true) {
+        makeStroke(events);
+        for (unsigned int i = 0; i < events.size(); ++i) {
+            long long t0 = latencyClock();
+            board.processAction(events[i]);
+            times.record(latencyClock() - t0);
+        }
+        board.damage.clear();
+        board.pageDamage.clear();
+        n += (long long) events.size();
+        if (numEvents >= 0 && n >= numEvents)
+            return n;
+        if (numEvents < 0 && exporter->isFinished())
+            return n;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    QGuiApplication app(argc, argv);
+    int numStrokes = 20000;
+    const char* path = "exportbench.svg";
+    for (int i = 1; i < argc - 1; ++i) {
+        if (strcmp(argv[i], "-n") == 0)
+            numStrokes = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0)
+            path = argv[++i];
+    }
+    int format = BoardExporter::formatOf(path);
+    if (format < 0) {
+        fprintf(stderr, "%s: .svg, .png or .pdf expected\n", path);
+        return 1;
+    }
+
+    srand(1);
+    Board board;
+    std::vector<Action> events;
+    for (int i = 0; i < numStrokes; ++i) {
+        makeStroke(events);
+        for (unsigned int k = 0; k < events.size(); ++k)
+            board.processAction(events[k]);
+    }
+    board.damage.clear();
+    board.pageDamage.clear();
+
+    LatencyHistogram idle;
+    drawStrokes(board, NUM_BASELINE_EVENTS, 0, idle);
+    long rssBefore = maxRssKb();
+
+    BoardExporter exporter;
+    long long t0 = latencyClock();
+    board.takeSnapshot(exporter.snapshot);
+    long long snapshotTime = latencyClock() - t0;
+    exporter.path = path;
+    exporter.format = format;
+    exporter.world = R2Rectangle(0., 0., PAGE_WIDTH, PAGE_HEIGHT);
+    exporter.scale = 1.;
+    t0 = latencyClock();
+    exporter.start(QThread::LowPriority);
+    LatencyHistogram busy;
+    long long n = drawStrokes(board, -1, &exporter, busy);
+    exporter.wait();
+    long long exportTime = latencyClock() - t0;
+
+    double seconds = exportTime * 1e-6;
+    long long bytes = outputBytes(exporter);
+    printf(
+        "%d strokes, snapshot %.3f ms, export to %s %s in %.2f s\n",
+        exporter.snapshot.numStrokes(), snapshotTime * 1e-3, path,
+        exporter.ok? "written" : "FAILED", seconds
+    );
+    printf(
+        "export throughput: %.0f strokes/s, %.1f MB/s (%.1f MB in %d pages)\n",
+        exporter.snapshot.numStrokes() / seconds, bytes * 1e-6 / seconds,
+        bytes * 1e-6, exporter.numPages
+    );
+    printf(
+        "pen event without export: p50 %.2f us, p99 %.2f us, max %.2f us\n",
+        (double) idle.percentile(0.5), (double) idle.percentile(0.99),
+        (double) idle.maxValue
+    );
+    printf(
+        "pen event during export:  p50 %.2f us, p99 %.2f us, max %.2f us"
+        " (%lld events)\n",
+        (double) busy.percentile(0.5), (double) busy.percentile(0.99),
+        (double) busy.maxValue, n
+    );
+    printf(
+        "peak memory: %ld KB before, %ld KB after the export (+%ld KB)\n",
+        rssBefore, maxRssKb(), maxRssKb() - rssBefore
+    );
+    return exporter.ok? 0 : 1;
+}
@@ -0,0 +1,14 @@
+TEMPLATE = app
+TARGET = exportbench
+INCLUDEPATH += ..
+DEPENDPATH += ..
+
+QT += core gui
+
+# Pen event times while the board is exported in background
+HEADERS += handwriting.h ../board.h ../boardexport.h ../qtrenderer.h ../renderbackend.h \
+    ../R2Graph.h ../strokegrid.h ../polyline.h \
+    ../tracer.h ../latency.h ../allocstats.h
+SOURCES += exportbench.cpp ../boardexport.cpp \
+    ../board.cpp ../qtrenderer.cpp ../R2Graph.cpp ../strokegrid.cpp ../polyline.cpp \
+    ../tracer.cpp ../latency.cpp ../allocstats.cpp
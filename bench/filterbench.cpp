@@ -0,0 +1,213 @@
+//
+// Benchmark of the jitter filter: input traces with added sensor
+// noise are filtered and drawn into strokes. For every setting it
+// reports the stroke points kept (Stroke::push_back drops the
+// repeated and collinear ones), the distance from the clean pen
+// path (the wobble of the ink), the lag behind the pen and the
+// filter cost per input event.
+// Run as:  filterbench [-j jitterPx] [trace...]
+// A trace is a text file with one input point "t x y" per line
+// (t in milliseconds), strokes separated by empty lines, as
+// written by the whiteboard with WHITEBOARD_TRACE=file.
+// Without traces, a synthetic handwriting trace is used.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+#include "jitterfilter.h"
+#include "board.h"
+
+struct Sample {
+    double t;
+    R2Point p;
+
+    Sample(double tt = 0., const R2Point& pp = R2Point()):
+        t(tt),
+        p(pp)
+    {}
+};
+
+typedef std::vector<Sample> Trace;
+
+static bool readTraces(const char* path, std::vector<Trace>& traces) {
+    FILE* f = fopen(path, "r");
+    if (f == 0) {
+        perror(path);
+        return false;
+    }
+    traces.push_back(Trace());
+    char line[256];
+    while (fgets(line, sizeof(line), f) != 0) {
+        double t, x, y;
+        if (sscanf(line, "%lf %lf %lf", &t, &x, &y) == 3) {
+            traces.back().push_back(Sample(t, R2Point(x, y)));
+        } else if (!traces.back().empty()) {
+            traces.push_back(Trace());
+        }
+    }
+    fclose(f);
+    if (traces.back().empty())
+        traces.pop_back();
+    return true;
+}
+
+// Handwriting-like loops with a varying speed, sampled at 125 Hz
+static void makeTraces(std::vector<Trace>& traces) {
+    srand(1);
+    for (int s = 0; s < 200; ++s) {
+        Trace tr;
+        double amp = 10. + rand() % 40;
+        double speed = 0.05 + 0.05 * (rand() % 10);  // px per ms
+        double len = 80. + rand() % 300;
+        double x0 = rand() % 1000, y0 = rand() % 800;
+        double u = 0.;
+        for (double t = 0.; u <= len; t += 8.) {
+            double x = x0 + u + amp*0.7*sin(u/amp*2.);
+            double y = y0 + amp*cos(u/amp*2.);
+            tr.push_back(Sample(t, R2Point(x, y)));
+            u += 8. * speed * (1. + 0.5*sin(t / 150.));
+        }
+        traces.push_back(tr);
+    }
+}
+
+// Normal distribution, Box-Muller
+static double gaussian() {
+    double u = (rand() + 1.) / (RAND_MAX + 2.);
+    double v = (rand() + 1.) / (RAND_MAX + 2.);
+    return sqrt(-2. * log(u)) * cos(2. * M_PI * v);
+}
+
+// Distance from p to the pen path up to the sample i; the filter
+// output lags, so only the recent part of the path is searched
+static double pathDistance(const Trace& tr, unsigned int i, const R2Point& p) {
+    double d = tr[i].p.distance(p);
+    for (unsigned int k = (i > 32)? i - 32 : 0; k < i; ++k) {
+        R2Vector v = tr[k + 1].p - tr[k].p;
+        double len2 = v*v;
+        double u = (len2 > 0.)? ((p - tr[k].p)*v) / len2 : 0.;
+        if (u < 0.)
+            u = 0.;
+        else if (u > 1.)
+            u = 1.;
+        double e = (tr[k].p + v*u).distance(p);
+        if (e < d)
+            d = e;
+    }
+    return d;
+}
+
+static double elapsedNs(const timespec& a, const timespec& b) {
+    return (b.tv_sec - a.tv_sec) * 1e9 + (b.tv_nsec - a.tv_nsec);
+}
+
+class Setting {
+public:
+    const char* name;
+    bool enabled;
+    float minCutoff;
+    float beta;
+};
+
+int main(int argc, char *argv[]) {
+    double jitter = 1.;
+    std::vector<Trace> traces;
+    for (int i = 1; i < argc; ++i) {
+        if (i + 1 < argc && strcmp(argv[i], "-j") == 0) {
+            jitter = atof(argv[++i]);
+        } else if (!readTraces(argv[i], traces)) {
+            return 1;
+        }
+    }
+    if (traces.empty())
+        makeTraces(traces);
+
+    // Sensor input: the pen path plus noise, in integer pixels
+    srand(2);
+    std::vector<std::vector<I2Point> > inputs(traces.size());
+    long long numSamples = 0;
+    for (unsigned int s = 0; s < traces.size(); ++s) {
+        for (unsigned int i = 0; i < traces[s].size(); ++i) {
+            const R2Point& p = traces[s][i].p;
+            inputs[s].push_back(I2Point(
+                (int) floor(p.x + jitter*gaussian() + 0.5),
+                (int) floor(p.y + jitter*gaussian() + 0.5)
+            ));
+        }
+        numSamples += traces[s].size();
+    }
+    printf(
+        "%d strokes, %lld input points, jitter %.2f px\n",
+        (int) traces.size(), numSamples, jitter
+    );
+    printf(
+        "setting               | points  kept | path RMS   max | lag mean | "
+        "ns/event\n"
+    );
+
+    static const Setting settings[] = {
+        { "off",                false, 0.f,  0.f },
+        { "min 5 beta 0.1",     true,  5.f,  0.1f },
+        { "min 1.5 beta 0.02",  true,  1.5f, 0.02f },
+        { "min 3 beta 0.1",     true,  3.f,  0.1f },
+        { "min 5 beta 0.3",     true,  5.f,  0.3f },
+        { "min 8 beta 0.05",    true,  8.f,  0.05f }
+    };
+    long long rawPoints = 0;
+    for (unsigned int k = 0; k < sizeof(settings)/sizeof(settings[0]); ++k) {
+        const Setting& st = settings[k];
+        InkFilter filter;
+        if (st.enabled) {
+            filter.configure(0);
+            filter.minCutoff = st.minCutoff;
+            filter.beta = st.beta;
+        }
+
+        long long points = 0;
+        double sum = 0., maxError = 0., lag = 0.;
+        for (unsigned int s = 0; s < traces.size(); ++s) {
+            Stroke stroke;
+            StreamDecimator decimator;
+            filter.reset();
+            for (unsigned int i = 0; i < traces[s].size(); ++i) {
+                I2Point p = filter.filter(inputs[s][i], traces[s][i].t);
+                stroke.push_back(decimator, p);
+                R2Point q(p.x, p.y);
+                double e = pathDistance(traces[s], i, q);
+                sum += e*e;
+                lag += traces[s][i].p.distance(q);
+                if (e > maxError)
+                    maxError = e;
+            }
+            points += stroke.size();
+        }
+        if (k == 0)
+            rawPoints = points;
+
+        // The filter alone
+        const int repeats = 20;
+        int checksum = 0;
+        timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int r = 0; r < repeats; ++r) {
+            for (unsigned int s = 0; s < traces.size(); ++s) {
+                filter.reset();
+                for (unsigned int i = 0; i < traces[s].size(); ++i)
+                    checksum += filter.filter(inputs[s][i], traces[s][i].t).x;
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        double ns = elapsedNs(t0, t1) / ((double) repeats * numSamples);
+
+        printf(
+            "%-21s | %6lld %4.0f%% | %8.2f %5.1f | %8.2f | %8.1f%s\n",
+            st.name, points, 100. * points / rawPoints,
+            sqrt(sum / numSamples), maxError, lag / numSamples, ns,
+            (checksum == 42)? " " : ""
+        );
+    }
+    return 0;
+}
@@ -0,0 +1,15 @@
+TEMPLATE = app
+TARGET = filterbench
+INCLUDEPATH += ..
+DEPENDPATH += ..
+
+CONFIG += console
+CONFIG -= app_bundle qt
+
+# Point counts and cost of the jitter filter on noisy input traces
+HEADERS += ../jitterfilter.h ../board.h ../renderbackend.h ../raster.h \
+    ../rasterrenderer.h ../R2Graph.h ../strokegrid.h ../polyline.h \
+    ../allocstats.h
+SOURCES += filterbench.cpp ../jitterfilter.cpp \
+    ../board.cpp ../raster.cpp ../rasterrenderer.cpp \
+    ../R2Graph.cpp ../strokegrid.cpp ../polyline.cpp ../allocstats.cpp
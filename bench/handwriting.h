@@ -0,0 +1,48 @@
+//
+// Synthetic handwriting shared by the benchmarks: a train of loops
+// of random size, sampled every 0.5 px along x, on a page of
+// PAGE_WIDTH x PAGE_HEIGHT pixels. The strokes depend only on the
+// rand() sequence, so a benchmark that calls srand(1) first always
+// gets the same ones.
+//
+#ifndef HANDWRITING_H
+#define HANDWRITING_H
+
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include "board.h"
+
+static const int PAGE_WIDTH = 1920;
+static const int PAGE_HEIGHT = 1080;
+
+// Append the pen events of one stroke. It starts at x in
+// [40, 40 + xRange); its length along x is minLength, or a random
+// one up to maxLength when that is larger.
+inline void makeHandwriting(
+    std::vector<Action>& actions, int xRange,
+    int minLength, int maxLength, int touchId = NO_TOUCH
+) {
+    double x0 = 40. + rand() % xRange;
+    double y0 = 60. + rand() % (PAGE_HEIGHT - 120);
+    double len = minLength;
+    if (maxLength > minLength)
+        len += rand() % (maxLength - minLength + 1);
+    double amp = 6. + rand() % 20;
+    int color = rand() % 4;
+    int width = 1 + rand() % 5;
+    int type = Action::START_CURVE;
+    for (double t = 0.; t <= len; t += 0.5) {
+        double x = x0 + t + amp*0.7*sin(t/amp*2.);
+        double y = y0 + amp*cos(t/amp*2.);
+        actions.push_back(Action(
+            type, color, width,
+            I2Point((int)(x + 0.5), (int)(y + 0.5)),
+            NO_PRESSURE, touchId
+        ));
+        type = Action::DRAW_CURVE;
+    }
+    actions.back().type = Action::END_CURVE;
+}
+
+#endif
@@ -0,0 +1,158 @@
+//
+// Benchmark of the scripted action ingestion: a stream of actions
+// is read from stdin through ScriptInput and applied to a board in
+// batches. As in the widget with WHITEBOARD_SCRIPT, the new ink is
+// drawn once per frame with the headless raster backend: the
+// strokes committed since the last frame and the new points of the
+// live strokes.
+// It reports the points ingested per second and where the time
+// goes.
+// Run as:
+//   ingestbench -g [-b] [-n points] [-f fingers] > stream
+//   ingestbench < stream
+//   ingestbench -g -b | ingestbench
+// -g writes a synthetic stream (-b as binary records, -f strokes
+// drawn at the same time with touch point ids).
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <poll.h>
+#include <vector>
+#include "board.h"
+#include "rasterrenderer.h"
+#include "scriptinput.h"
+#include "handwriting.h"
+
+static const double FRAME_INTERVAL = 1. / 60.;
+
+static double now() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double) t.tv_sec + (double) t.tv_nsec * 1e-9;
+}
+
+// Handwriting-like strokes of about 400 points, numFingers at a time
+static void generate(int numPoints, int numFingers, bool binary) {
+    std::vector<std::vector<Action> > group(numFingers);
+    srand(1);
+    int written = 0;
+    while (written < numPoints) {
+        for (int f = 0; f < numFingers; ++f) {
+            group[f].clear();
+            makeHandwriting(
+                group[f], PAGE_WIDTH - 400, 200, 200,
+                (numFingers > 1)? f : NO_TOUCH
+            );
+        }
+        // Round-robin over the fingers
+        for (unsigned int i = 0; i < group[0].size(); ++i) {
+            for (int f = 0; f < numFingers; ++f) {
+                if (binary)
+                    writeActionBinary(stdout, group[f][i]);
+                else
+                    writeAction(stdout, group[f][i]);
+                ++written;
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    bool gen = false, binary = false;
+    int numPoints = 4000000;
+    int numFingers = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-g") == 0)
+            gen = true;
+        else if (strcmp(argv[i], "-b") == 0)
+            binary = true;
+        else if (i + 1 < argc && strcmp(argv[i], "-n") == 0)
+            numPoints = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-f") == 0)
+            numFingers = atoi(argv[++i]);
+    }
+    if (numFingers < 1)
+        numFingers = 1;
+    if (gen) {
+        generate(numPoints, numFingers, binary);
+        return 0;
+    }
+
+    ScriptInput* script = ScriptInput::open("-");
+    if (script == 0)
+        return 1;
+    Board board;
+    Raster raster(PAGE_WIDTH, PAGE_HEIGHT);
+    RasterRenderer renderer(&raster);
+    raster.fill(renderer.palette[WHITE_COLOR_IDX]);
+
+    std::vector<Action> actions;
+    long long numActions = 0, numBatches = 0, numFrames = 0;
+    double readTime = 0., applyTime = 0., drawTime = 0.;
+    double start = 0., lastFrame = 0.;
+    unsigned int firstNew = 0;      // Strokes not drawn yet
+    bool open = true;
+    while (open) {
+        pollfd pfd;
+        pfd.fd = 0;
+        pfd.events = POLLIN;
+        poll(&pfd, 1, -1);
+        if (start == 0.)
+            start = now();      // Not the wait for the writer
+
+        double t0 = now();
+        actions.clear();
+        open = script->read(0, actions);
+        double t1 = now();
+        for (unsigned int i = 0; i < actions.size(); ++i)
+            board.processAction(actions[i]);
+        double t2 = now();
+        if (t2 - lastFrame >= FRAME_INTERVAL || !open) {
+            const StrokeList& strokes = board.page().strokes;
+            for (; firstNew < strokes.size(); ++firstNew)
+                renderer.drawStroke(*strokes[firstNew], 0);
+            board.drawLiveInk(renderer);
+            board.damage.clear();
+            board.pageDamage.clear();
+            lastFrame = t2;
+            ++numFrames;
+        }
+        double t3 = now();
+
+        readTime += t1 - t0;
+        applyTime += t2 - t1;
+        drawTime += t3 - t2;
+        numActions += (long long) actions.size();
+        ++numBatches;
+    }
+    double total = now() - start;
+    delete script;
+
+    printf(
+        "%lld actions in %lld batches, %lld frames, %d strokes\n",
+        numActions, numBatches, numFrames, (int) board.page().strokes.size()
+    );
+    printf(
+        "read + decode %.2f s, apply %.2f s, draw %.2f s, total %.2f s\n",
+        readTime, applyTime, drawTime, total
+    );
+    printf("ingestion: %.2f M points/s\n", numActions / total * 1e-6);
+
+    // Checksum of the final board, to compare runs. The ink drawn
+    // above depends on where the batches and frames split the
+    // stream, so the board is drawn again from scratch.
+    raster.fill(renderer.palette[WHITE_COLOR_IDX]);
+    board.drawPage(renderer, R2Rectangle(0., 0., PAGE_WIDTH, PAGE_HEIGHT));
+    board.drawLiveStroke(renderer);
+    unsigned int hash = 2166136261u;
+    for (int y = 0; y < raster.height; ++y) {
+        const Pixel* p = raster.scanLine(y);
+        for (int x = 0; x < raster.width; ++x)
+            hash = (hash ^ p[x]) * 16777619u;
+    }
+    printf("image hash %08x\n", hash);
+    return 0;
+}
@@ -0,0 +1,15 @@
+TEMPLATE = app
+TARGET = ingestbench
+INCLUDEPATH += ..
+DEPENDPATH += ..
+
+CONFIG += console
+CONFIG -= app_bundle qt
+
+# Scripted input with the headless raster backend, no display needed
+HEADERS += handwriting.h ../scriptinput.h ../actionio.h \
+    ../board.h ../renderbackend.h ../raster.h ../rasterrenderer.h \
+    ../R2Graph.h ../strokegrid.h ../polyline.h ../allocstats.h
+SOURCES += ingestbench.cpp ../scriptinput.cpp ../actionio.cpp \
+    ../board.cpp ../raster.cpp ../rasterrenderer.cpp \
+    ../R2Graph.cpp ../strokegrid.cpp ../polyline.cpp ../allocstats.cpp
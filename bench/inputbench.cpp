@@ -0,0 +1,140 @@
+//
+// Benchmark of the input ring between the input thread and the
+// GUI thread: a producer thread pushes numbered samples at a pen
+// rate while the consumer drains the ring once per frame and
+// stalls now and then, like the GUI thread during a long paint.
+// It reports the samples lost (counted by the ring and found as
+// gaps in the numbers), the queueing delay of the samples and the
+// cost of a push and a pop.
+// Run as:
+//   inputbench [-r samplesPerSecond] [-n samples] [-s stallMs]
+//              [-e framesBetweenStalls]
+//
+#include <QThread>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "inputthread.h"
+#include "latency.h"
+
+static const int FRAME_INTERVAL = 16667;    // Microseconds
+
+class Producer: public QThread {
+public:
+    InputRing* ring;
+    int numSamples;
+    int rate;
+
+    Producer(InputRing* r, int n, int samplesPerSecond):
+        QThread(),
+        ring(r),
+        numSamples(n),
+        rate(samplesPerSecond)
+    {}
+
+protected:
+    void run() {
+        long long start = latencyClock();
+        for (int i = 0; i < numSamples; ++i) {
+            long long due = start + (long long) i * 1000000 / rate;
+            long long wait = due - latencyClock();
+            if (wait > 0)
+                usleep((useconds_t) wait);
+            InputSample s;
+            s.type = Action::DRAW_CURVE;
+            s.pressure = NO_PRESSURE;
+            s.touchId = NO_TOUCH;
+            s.point = I2Point(i, 0);
+            s.fraction = 0;
+            s.time = latencyClock();
+            ring->push(s);
+        }
+    }
+};
+
+int main(int argc, char *argv[]) {
+    int rate = 1000;
+    int numSamples = 20000;
+    int stall = 100;
+    int stallEvery = 60;
+    for (int i = 1; i < argc - 1; ++i) {
+        if (strcmp(argv[i], "-r") == 0)
+            rate = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0)
+            numSamples = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0)
+            stall = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-e") == 0)
+            stallEvery = atoi(argv[++i]);
+    }
+    if (rate < 1)
+        rate = 1;
+    if (numSamples < 1)
+        numSamples = 1;
+    if (stallEvery < 1)
+        stallEvery = 1;
+
+    InputRing* ring = new InputRing();
+
+    // Cost of a push and a pop, without contention
+    const int NUM_COST_SAMPLES = 10000000;
+    InputSample s;
+    s.type = Action::DRAW_CURVE;
+    s.pressure = NO_PRESSURE;
+    s.touchId = NO_TOUCH;
+    s.fraction = 0;
+    s.time = 0;
+    long long sum = 0;
+    long long t0 = latencyClock();
+    for (int i = 0; i < NUM_COST_SAMPLES; ++i) {
+        s.point = I2Point(i, 0);
+        ring->push(s);
+        ring->pop(s);
+        sum += s.point.x;
+    }
+    double cost = (double)(latencyClock() - t0) * 1e3 / NUM_COST_SAMPLES;
+
+    Producer producer(ring, numSamples, rate);
+    LatencyHistogram delays;
+    int received = 0, gaps = 0, misordered = 0;
+    int next = 0;               // Number of the next sample expected
+    int frames = 0;
+
+    producer.start();
+    bool running = true;
+    while (running) {
+        running = producer.isRunning();
+        usleep(FRAME_INTERVAL);
+        if (++frames % stallEvery == 0)
+            usleep((useconds_t) stall * 1000);
+        while (ring->pop(s)) {
+            long long t = latencyClock();
+            delays.record(t - s.time);
+            ++received;
+            if (s.point.x < next)
+                ++misordered;
+            else if (s.point.x > next)
+                ++gaps;
+            next = s.point.x + 1;
+        }
+    }
+    producer.wait();
+
+    printf(
+        "rate %d/s, %d samples, stall %d ms every %d frames, ring %d\n",
+        rate, numSamples, stall, stallEvery, INPUT_RING_SIZE
+    );
+    printf(
+        "received %d, dropped %d (%d gaps), misordered %d\n",
+        received, ring->dropped.load(), gaps, misordered
+    );
+    printf(
+        "queue delay: p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+        delays.percentile(0.5) * 1e-3, delays.percentile(0.99) * 1e-3,
+        delays.maxValue * 1e-3
+    );
+    printf("push + pop: %.1f ns (checksum %lld)\n", cost, sum);
+    delete ring;
+    return (misordered == 0)? 0 : 1;
+}
@@ -0,0 +1,12 @@
+TEMPLATE = app
+TARGET = inputbench
+INCLUDEPATH += ..
+DEPENDPATH += ..
+
+QT -= gui
+CONFIG += console
+CONFIG -= app_bundle
+
+# Losses and queueing delay of the input ring under GUI stalls
+HEADERS += ../inputthread.h ../latency.h ../board.h ../R2Graph.h
+SOURCES += inputbench.cpp ../latency.cpp
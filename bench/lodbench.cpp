@@ -0,0 +1,93 @@
+//
+// Benchmark of a full-page redraw at 100%, 25% and 5% scale,
+// with level-of-detail paths and with full-resolution paths, and
+// the number of points the LOD paths have at each scale.
+// Run as:  lodbench [numStrokes] -platform offscreen
+//
+#include <QApplication>
+#include <QElapsedTimer>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "board.h"
+#include "qtrenderer.h"
+#include "handwriting.h"
+
+static const int NUM_REPEATS = 5;
+
+// A stroke of the synthetic handwriting, decimated as when drawn
+static void makeStroke(Stroke& str) {
+    std::vector<Action> actions;
+    makeHandwriting(actions, PAGE_WIDTH - 400, 80, 379);
+    StreamDecimator decimator;
+    str.clear();
+    str.color = actions[0].color;
+    str.width = actions[0].width;
+    for (unsigned int i = 0; i < actions.size(); ++i)
+        str.push_back(decimator, actions[i].point);
+    str.finalize();
+}
+
+static double redrawTime(std::vector<Stroke>& strokes, double scale) {
+    int w = (int)(PAGE_WIDTH*scale + 0.5);
+    int h = (int)(PAGE_HEIGHT*scale + 0.5);
+    QImage image(w, h, QImage::Format_RGB32);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int r = 0; r < NUM_REPEATS; ++r) {
+        image.fill(Qt::white);
+        QPainter qp(&image);
+        qp.setRenderHint(QPainter::Antialiasing);
+        qp.scale(scale, scale);
+        QtRenderer renderer(&qp);
+        for (unsigned int i = 0; i < strokes.size(); ++i)
+            renderer.drawStroke(strokes[i], 0);
+    }
+    return (double) timer.nsecsElapsed() / 1e6 / NUM_REPEATS;
+}
+
+// Points of the levels that drawStroke picks at the scale
+static long long drawnPoints(const std::vector<Stroke>& strokes, double scale) {
+    long long n = 0;
+    for (unsigned int i = 0; i < strokes.size(); ++i) {
+        const Stroke& str = strokes[i];
+        int l = str.levelForScale(scale);
+        n += (l < 0)? str.size() : (long long) str.levels[l].points.size();
+    }
+    return n;
+}
+
+int main(int argc, char *argv[]) {
+    QApplication app(argc, argv);
+    int numStrokes = 2000;
+    if (argc > 1 && atoi(argv[1]) > 0)
+        numStrokes = atoi(argv[1]);
+
+    srand(1);
+    std::vector<Stroke> strokes(numStrokes);
+    long long numPoints = 0;
+    for (int i = 0; i < numStrokes; ++i) {
+        makeStroke(strokes[i]);
+        numPoints += strokes[i].size();
+    }
+
+    // Reference: the same strokes without levels
+    std::vector<Stroke> fullRes(strokes);
+    for (unsigned int i = 0; i < fullRes.size(); ++i)
+        fullRes[i].levels.clear();
+
+    printf("strokes %d, points %lld\n", numStrokes, numPoints);
+    printf("scale   full-res ms   lod ms   lod points\n");
+    const double scales[3] = { 1., 0.25, 0.05 };
+    for (int s = 0; s < 3; ++s) {
+        printf(
+            "%5.0f%%  %11.2f  %7.2f  %11lld\n",
+            scales[s]*100.,
+            redrawTime(fullRes, scales[s]),
+            redrawTime(strokes, scales[s]),
+            drawnPoints(strokes, scales[s])
+        );
+    }
+    return 0;
+}
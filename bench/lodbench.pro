@@ -0,0 +1,13 @@
+TEMPLATE = app
+TARGET = lodbench
+INCLUDEPATH += ..
+DEPENDPATH += ..
+
+QT += core gui widgets
+
+# Full-page redraw time with and without stroke LOD
+HEADERS += handwriting.h ../board.h ../qtrenderer.h ../renderbackend.h ../R2Graph.h ../strokegrid.h ../polyline.h \
+    ../tracer.h ../latency.h ../allocstats.h
+SOURCES += lodbench.cpp \
+    ../board.cpp ../qtrenderer.cpp ../R2Graph.cpp ../strokegrid.cpp ../polyline.cpp \
+    ../tracer.cpp ../latency.cpp ../allocstats.cpp
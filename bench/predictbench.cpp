@@ -0,0 +1,149 @@
+//
+// Evaluation of the ink predictor on recorded input traces: for
+// every input point, the position predicted some milliseconds
+// ahead is compared with the real pen position at that time.
+// Run as:  predictbench [trace...]
+// A trace is a text file with one input point "t x y" per line
+// (t in milliseconds), strokes separated by empty lines, as
+// written by the whiteboard with WHITEBOARD_TRACE=file.
+// Without arguments, a synthetic handwriting trace is used.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "predictor.h"
+
+struct Sample {
+    double t;
+    R2Point p;
+
+    Sample(double tt = 0., const R2Point& pp = R2Point()):
+        t(tt),
+        p(pp)
+    {}
+};
+
+typedef std::vector<Sample> Trace;
+
+static bool readTraces(const char* path, std::vector<Trace>& traces) {
+    FILE* f = fopen(path, "r");
+    if (f == 0) {
+        perror(path);
+        return false;
+    }
+    traces.push_back(Trace());
+    char line[256];
+    while (fgets(line, sizeof(line), f) != 0) {
+        double t, x, y;
+        if (sscanf(line, "%lf %lf %lf", &t, &x, &y) == 3) {
+            traces.back().push_back(Sample(t, R2Point(x, y)));
+        } else if (!traces.back().empty()) {
+            traces.push_back(Trace());
+        }
+    }
+    fclose(f);
+    if (traces.back().empty())
+        traces.pop_back();
+    return true;
+}
+
+// Handwriting-like loops with a varying speed, sampled at 125 Hz
+// and rounded to integer pixels like the mouse events
+static void makeTraces(std::vector<Trace>& traces) {
+    srand(1);
+    for (int s = 0; s < 200; ++s) {
+        Trace tr;
+        double amp = 10. + rand() % 40;
+        double speed = 0.1 + 0.05 * (rand() % 10);  // px per ms
+        double len = 80. + rand() % 300;
+        double x0 = rand() % 1000, y0 = rand() % 800;
+        double u = 0.;
+        for (double t = 0.; u <= len; t += 8.) {
+            double x = x0 + u + amp*0.7*sin(u/amp*2.);
+            double y = y0 + amp*cos(u/amp*2.);
+            tr.push_back(Sample(t, R2Point(floor(x + 0.5), floor(y + 0.5))));
+            u += 8. * speed * (1. + 0.5*sin(t / 150.));
+        }
+        traces.push_back(tr);
+    }
+}
+
+// Pen position at time t, interpolated between the input points
+static R2Point positionAt(const Trace& tr, unsigned int i, double t) {
+    while (i + 1 < tr.size() && tr[i + 1].t < t)
+        ++i;
+    if (i + 1 >= tr.size() || tr[i + 1].t == tr[i].t)
+        return tr[i].p;
+    double k = (t - tr[i].t) / (tr[i + 1].t - tr[i].t);
+    return tr[i].p + (tr[i + 1].p - tr[i].p) * k;
+}
+
+static double percentile(std::vector<double>& v, double q) {
+    if (v.empty())
+        return 0.;
+    std::sort(v.begin(), v.end());
+    return v[(int)(q * (v.size() - 1))];
+}
+
+static double mean(const std::vector<double>& v) {
+    double s = 0.;
+    for (unsigned int i = 0; i < v.size(); ++i)
+        s += v[i];
+    return v.empty()? 0. : s / v.size();
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<Trace> traces;
+    for (int i = 1; i < argc; ++i) {
+        if (!readTraces(argv[i], traces))
+            return 1;
+    }
+    if (argc <= 1)
+        makeTraces(traces);
+
+    long long numSamples = 0;
+    for (unsigned int i = 0; i < traces.size(); ++i)
+        numSamples += traces[i].size();
+    printf("%d strokes, %lld input points\n", (int) traces.size(), numSamples);
+
+    // The gap is the distance the ink lags behind the pen without
+    // prediction; the error is the distance from the predicted
+    // point to the real pen position
+    printf(
+        "ahead ms | gap mean  p95 | error mean  p95   max | gap removed\n"
+    );
+    static const double aheads[] = {4., 8., 12., 16., 24., 32.};
+    for (unsigned int a = 0; a < sizeof(aheads)/sizeof(aheads[0]); ++a) {
+        double ahead = aheads[a];
+        std::vector<double> gaps, errors;
+        for (unsigned int s = 0; s < traces.size(); ++s) {
+            const Trace& tr = traces[s];
+            InkPredictor predictor;
+            for (unsigned int i = 0; i < tr.size(); ++i) {
+                predictor.addSample(tr[i].p, tr[i].t);
+                double t = tr[i].t + ahead;
+                if (t > tr.back().t)
+                    break;
+                R2Point p;
+                if (!predictor.predict(ahead, p))
+                    continue;
+                R2Point real = positionAt(tr, i, t);
+                gaps.push_back(tr[i].p.distance(real));
+                errors.push_back(p.distance(real));
+            }
+        }
+        double gapMean = mean(gaps);
+        double errMean = mean(errors);
+        printf(
+            "%8.0f | %8.2f %4.1f | %10.2f %4.1f %5.1f | %10.0f%%\n",
+            ahead, gapMean, percentile(gaps, 0.95),
+            errMean, percentile(errors, 0.95),
+            errors.empty()? 0. : percentile(errors, 1.),
+            gapMean > 0.? 100. * (1. - errMean / gapMean) : 0.
+        );
+    }
+    return 0;
+}
@@ -0,0 +1,12 @@
+TEMPLATE = app
+TARGET = predictbench
+INCLUDEPATH += ..
+DEPENDPATH += ..
+
+CONFIG += console
+CONFIG -= app_bundle qt
+
+# Prediction error of the live ink on recorded input traces
+HEADERS += ../predictor.h ../R2Graph.h
+SOURCES += predictbench.cpp \
+    ../predictor.cpp ../R2Graph.cpp
@@ -0,0 +1,401 @@
+//
+// Render regression harness. The ink pass replays action streams
+// through the optimized drawing path of the widget (live ink drawn
+// once per frame into the offscreen image) and through the
+// reference path (a full drawInOffscreen of the same board); the
+// images must be equal. The view passes then pan and zoom out both
+// widgets: the optimized one scrolls its image and composes the
+// zoomed-out views from tiles with levels of detail, the reference
+// one draws every view from the full-resolution strokes. These
+// images are resampled and simplified, so their tiles only have to
+// stay above a PSNR bound (or be equal with -exact).
+// Every check reports the number of tiles whose hashes differ, the
+// first diverging tile and the lowest tile PSNR. The exit status is
+// 1 if a check fails.
+// With -r, the hashes of the reference images are also compared
+// with the ones in the given file, which catches changes of the
+// reference path itself; a missing file is written instead, as the
+// baseline for later runs.
+// Run as:
+//   renderhash [-t tileSize] [-p minPsnr] [-exact] [-e eventsPerFrame]
+//              [-c framesPerCheck] [-r hashFile] [stream...]
+//              -platform offscreen
+// Streams are in the actionio text format, e.g. recorded with
+// WHITEBOARD_RECORD=file; without them a synthetic stream is used.
+//
+#include <QApplication>
+#include <QEventLoop>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <string>
+#include "whitebrd.h"
+#include "actionio.h"
+#include "handwriting.h"
+
+
+class TileDiff {
+public:
+    int numTiles;
+    int numDiffering;
+    int firstX, firstY;     // First differing tile in row order, or -1
+    double minPsnr;         // Over all tiles; infinite if equal
+
+    TileDiff():
+        numTiles(0),
+        numDiffering(0),
+        firstX(-1),
+        firstY(-1),
+        minPsnr(HUGE_VAL)
+    {}
+};
+
+static unsigned int tileHash(
+    const QImage& im, int x0, int y0, int w, int h
+) {
+    unsigned int hash = 2166136261u;
+    for (int y = y0; y < y0 + h; ++y) {
+        const QRgb* p = (const QRgb*) im.constScanLine(y) + x0;
+        for (int x = 0; x < w; ++x)
+            hash = (hash ^ (p[x] & 0xffffff)) * 16777619u;
+    }
+    return hash;
+}
+
+static unsigned int imageHash(const WhiteBoard& w) {
+    const QImage& im = *w.offscreenImage();
+    return tileHash(im, 0, 0, im.width(), im.height());
+}
+
+static double tilePsnr(
+    const QImage& a, const QImage& b, int x0, int y0, int w, int h
+) {
+    double sum = 0.;
+    for (int y = y0; y < y0 + h; ++y) {
+        const QRgb* p = (const QRgb*) a.constScanLine(y) + x0;
+        const QRgb* q = (const QRgb*) b.constScanLine(y) + x0;
+        for (int x = 0; x < w; ++x) {
+            int dr = qRed(p[x]) - qRed(q[x]);
+            int dg = qGreen(p[x]) - qGreen(q[x]);
+            int db = qBlue(p[x]) - qBlue(q[x]);
+            sum += dr*dr + dg*dg + db*db;
+        }
+    }
+    if (sum == 0.)
+        return HUGE_VAL;
+    double mse = sum / (3. * w * h);
+    return 10. * log10(255. * 255. / mse);
+}
+
+static TileDiff compareImages(const QImage& a, const QImage& b, int tile) {
+    TileDiff d;
+    for (int ty = 0; ty*tile < a.height(); ++ty) {
+        for (int tx = 0; tx*tile < a.width(); ++tx) {
+            int x0 = tx*tile, y0 = ty*tile;
+            int w = (x0 + tile <= a.width())? tile : a.width() - x0;
+            int h = (y0 + tile <= a.height())? tile : a.height() - y0;
+            ++d.numTiles;
+            if (tileHash(a, x0, y0, w, h) == tileHash(b, x0, y0, w, h))
+                continue;
+            double psnr = tilePsnr(a, b, x0, y0, w, h);
+            if (psnr == HUGE_VAL)
+                continue;   // Hash collision of equal tiles is fine
+            ++d.numDiffering;
+            if (d.firstX < 0) {
+                d.firstX = tx;
+                d.firstY = ty;
+            }
+            if (psnr < d.minPsnr)
+                d.minPsnr = psnr;
+        }
+    }
+    return d;
+}
+
+// The hashes of the reference images, one check per line
+class HashFile {
+public:
+    std::vector<unsigned int> hashes;
+    bool recording;     // The file did not exist and is written
+    int numChecked;
+    int numDiffering;
+
+    HashFile():
+        hashes(),
+        recording(false),
+        numChecked(0),
+        numDiffering(0)
+    {}
+
+    bool load(const char* path) {
+        FILE* f = fopen(path, "r");
+        if (f == 0) {
+            recording = true;
+            return true;
+        }
+        char line[256];
+        while (fgets(line, sizeof(line), f) != 0) {
+            unsigned int h;
+            if (sscanf(line, "%x", &h) != 1) {
+                fprintf(stderr, "%s: bad line %s", path, line);
+                fclose(f);
+                return false;
+            }
+            hashes.push_back(h);
+        }
+        fclose(f);
+        return true;
+    }
+
+    // Returns false if the hash differs from the baseline
+    bool check(unsigned int h, const char* what) {
+        unsigned int i = numChecked++;
+        if (recording) {
+            hashes.push_back(h);
+            names.push_back(what);
+            return true;
+        }
+        if (i < hashes.size() && hashes[i] == h)
+            return true;
+        if (i < hashes.size())
+            printf("%s: reference hash %08x, baseline %08x\n",
+                what, h, hashes[i]);
+        else
+            printf("%s: reference hash %08x, not in baseline\n", what, h);
+        ++numDiffering;
+        return false;
+    }
+
+    bool save(const char* path) const {
+        FILE* f = fopen(path, "w");
+        if (f == 0) {
+            perror(path);
+            return false;
+        }
+        for (unsigned int i = 0; i < hashes.size(); ++i)
+            fprintf(f, "%08x %s\n", hashes[i], names[i].c_str());
+        return fclose(f) == 0;
+    }
+
+private:
+    std::vector<std::string> names;
+};
+
+// Handwriting-like strokes, drawn over each other
+static void makeStream(std::vector<Action>& actions) {
+    srand(1);
+    for (int s = 0; s < 200; ++s)
+        makeHandwriting(actions, PAGE_WIDTH - 400, 80, 379);
+}
+
+// Compare the offscreen images of the widgets and report a failure;
+// the first one is saved
+static bool checkImages(
+    const WhiteBoard& opt, const WhiteBoard& ref, int tile,
+    bool exact, double minPsnr, const char* what, int numFailed
+) {
+    TileDiff d = compareImages(
+        *opt.offscreenImage(), *ref.offscreenImage(), tile
+    );
+    bool failed =
+        (exact && d.numDiffering > 0) ||
+        (d.numDiffering > 0 && d.minPsnr < minPsnr);
+    if (!failed)
+        return true;
+    printf(
+        "%s: %d of %d tiles differ, first at tile "
+        "(%d, %d) = pixels (%d, %d), min PSNR %.1f dB\n",
+        what, d.numDiffering, d.numTiles, d.firstX, d.firstY,
+        d.firstX*tile, d.firstY*tile, d.minPsnr
+    );
+    if (numFailed == 0) {
+        opt.offscreenImage()->save("renderhash-opt.png");
+        ref.offscreenImage()->save("renderhash-ref.png");
+    }
+    return false;
+}
+
+// Let the workers finish the requested tiles and the widget
+// compose them
+static void waitForTiles(QApplication& app, WhiteBoard& w) {
+    while (w.tiles.numPending() > 0)
+        app.processEvents(QEventLoop::WaitForMoreEvents);
+}
+
+// The view passes: pans at full size, zooms out to the coarsest
+// tile level, with pans at the tile levels between
+class ViewStep {
+public:
+    double zoom;        // Factor, about the window center
+    int dx, dy;         // Pan in window pixels
+};
+
+static const ViewStep viewSteps[] = {
+    { 1., 237, 0 },
+    { 1., -150, -91 },
+    { 0.5, 0, 0 },
+    { 1., 311, 173 },
+    { 0.5, 0, 0 },
+    { 1., -700, -400 },
+    { 1., 97, -55 },
+    { 0.25, 0, 0 },
+    { 1., 45, 120 },
+    { 0.25, 0, 0 }
+};
+static const int NUM_VIEW_STEPS =
+    (int) (sizeof(viewSteps) / sizeof(viewSteps[0]));
+
+int main(int argc, char *argv[]) {
+    QApplication app(argc, argv);
+
+    int tile = 64;
+    double minPsnr = 35.;
+    bool exact = false;
+    int eventsPerFrame = 4;
+    int framesPerCheck = 8;
+    const char* hashPath = 0;
+    std::vector<Action> actions;
+    bool haveStreams = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-exact") == 0) {
+            exact = true;
+        } else if (i + 1 < argc && strcmp(argv[i], "-t") == 0) {
+            tile = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-p") == 0) {
+            minPsnr = atof(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-e") == 0) {
+            eventsPerFrame = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-c") == 0) {
+            framesPerCheck = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-r") == 0) {
+            hashPath = argv[++i];
+        } else {
+            FILE* f = fopen(argv[i], "r");
+            if (f == 0) {
+                perror(argv[i]);
+                return 1;
+            }
+            bool ok = readActions(f, actions);
+            fclose(f);
+            if (!ok)
+                return 1;
+            haveStreams = true;
+        }
+    }
+    if (tile < 8)
+        tile = 8;
+    if (eventsPerFrame < 1)
+        eventsPerFrame = 1;
+    if (framesPerCheck < 1)
+        framesPerCheck = 1;
+    if (!haveStreams)
+        makeStream(actions);
+    HashFile baseline;
+    if (hashPath != 0 && !baseline.load(hashPath))
+        return 1;
+
+    // Both widgets see the same board; only opt draws as it goes
+    WhiteBoard opt, ref;
+    WhiteBoard* boards[2] = { &opt, &ref };
+    for (int i = 0; i < 2; ++i) {
+        boards[i]->mode = MODE_NORMAL;
+        boards[i]->resize(PAGE_WIDTH, PAGE_HEIGHT);
+        boards[i]->show();
+    }
+    app.processEvents();
+
+    // Ink pass: the incremental ink must match the full redraw
+    int numChecks = 0, numFailed = 0;
+    int frames = 0, events = 0;
+    char what[64];
+    for (unsigned int i = 0; i < actions.size(); ++i) {
+        const Action& a = actions[i];
+        opt.processAction(a);
+        ref.board.processAction(a);
+        ref.board.damage.clear();
+        ref.board.pageDamage.clear();
+
+        bool check = false;
+        if (a.type == Action::DRAW_CURVE && ++events >= eventsPerFrame) {
+            opt.onFrame();
+            events = 0;
+            check = (++frames % framesPerCheck == 0);
+        } else if (a.type == Action::END_CURVE) {
+            events = 0;
+            check = true;
+        }
+        if (!check)
+            continue;
+
+        ref.drawInOffscreen();
+        sprintf(
+            what, "action %u (%s)",
+            i, (a.type == Action::END_CURVE)? "end" : "frame"
+        );
+        ++numChecks;
+        bool ok = checkImages(opt, ref, tile, true, 0., what, numFailed);
+        if (hashPath != 0 && !baseline.check(imageHash(ref), what))
+            ok = false;
+        if (!ok)
+            ++numFailed;
+    }
+    opt.frameTimer.stop();
+
+    // View passes
+    ref.referenceDrawing = true;
+    I2Point center(PAGE_WIDTH/2, PAGE_HEIGHT/2);
+    double scale = 1.;
+    for (int i = 0; i < NUM_VIEW_STEPS; ++i) {
+        const ViewStep& v = viewSteps[i];
+        for (int k = 0; k < 2; ++k) {
+            if (v.zoom != 1.)
+                boards[k]->zoom(v.zoom, center);
+            else
+                boards[k]->pan(v.dx, v.dy);
+        }
+        scale *= v.zoom;
+        waitForTiles(app, opt);
+        ref.drawInOffscreen();
+        if (v.zoom != 1.)
+            sprintf(what, "zoom 1/%g", 1./scale);
+        else
+            sprintf(what, "pan (%d, %d) at 1/%g", v.dx, v.dy, 1./scale);
+        ++numChecks;
+        bool ok = checkImages(opt, ref, tile, exact, minPsnr, what, numFailed);
+        if (hashPath != 0 && !baseline.check(imageHash(ref), what))
+            ok = false;
+        if (!ok)
+            ++numFailed;
+    }
+
+    printf(
+        "%d actions, %d checks, %d failed (tile %d, ink exact, ",
+        (int) actions.size(), numChecks, numFailed, tile
+    );
+    if (exact)
+        printf("views exact)\n");
+    else
+        printf("views min PSNR %.1f dB)\n", minPsnr);
+    if (hashPath != 0 && baseline.recording) {
+        if (!baseline.save(hashPath))
+            return 1;
+        printf("%d reference hashes written to %s\n", numChecks, hashPath);
+    } else if (hashPath != 0) {
+        if (baseline.numChecked < (int) baseline.hashes.size()) {
+            printf("%s has more checks than this run\n", hashPath);
+            ++baseline.numDiffering;
+            ++numFailed;
+        }
+        printf(
+            "%d of %d reference hashes differ from %s\n",
+            baseline.numDiffering, baseline.numChecked, hashPath
+        );
+    }
+    if (numFailed > 0) {
+        printf("First failure saved as renderhash-opt.png, renderhash-ref.png\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,16 @@
+TEMPLATE = app
+TARGET = renderhash
+INCLUDEPATH += ..
+DEPENDPATH += ..
+
+QT += core gui widgets
+
+# Optimized against reference drawing paths, tile by tile
+HEADERS += handwriting.h ../whitebrd.h ../R2Graph.h ../strokegrid.h ../lasso.h ../polyline.h ../tilecache.h \
+    ../board.h ../calibration.h ../renderbackend.h ../qtrenderer.h ../predictor.h \
+    ../latency.h ../tracer.h ../allocstats.h ../actionio.h ../jitterfilter.h \
+    ../inputthread.h ../scriptinput.h ../boardexport.h ../autosave.h
+SOURCES += renderhash.cpp \
+    ../whitebrd.cpp ../R2Graph.cpp ../strokegrid.cpp ../lasso.cpp ../polyline.cpp ../tilecache.cpp \
+    ../board.cpp ../calibration.cpp ../qtrenderer.cpp ../predictor.cpp \
+    ../latency.cpp ../tracer.cpp ../allocstats.cpp ../actionio.cpp ../jitterfilter.cpp ../inputthread.cpp ../scriptinput.cpp ../boardexport.cpp ../autosave.cpp
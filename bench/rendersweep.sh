@@ -0,0 +1,26 @@
+#!/bin/sh
+#
+# Throughput of boardrender against the number of threads: writes a
+# board archive with boardgen, then renders it with 1, 2, 4, ...
+# threads up to the number of cores and prints the pages/s of each
+# run, the thread times and the peak memory, which must not grow
+# with the archive.
+# Run as:  bench/rendersweep.sh [boardgen options]
+# from a directory where boardgen and boardrender were built.
+#
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+mkdir "$DIR/boards" "$DIR/out"
+./boardgen -o "$DIR/boards" "$@" || exit 1
+
+CORES=$(getconf _NPROCESSORS_ONLN)
+j=1
+while :; do
+    /usr/bin/time -f "peak memory %M KB" -o "$DIR/time" \
+        ./boardrender -j $j -o "$DIR/out" "$DIR/boards"/*.txt
+    cat "$DIR/time"
+    [ $j -ge "$CORES" ] && break
+    j=$((j * 2))
+    [ $j -gt "$CORES" ] && j=$CORES
+done
@@ -0,0 +1,116 @@
+#!/bin/sh
+#
+# Idle CPU and input-to-draw latency of the X11 frontend, measured
+# under Xvfb. For every binary given (e.g. one built before a change
+# and one after it) the script runs an idle session and a session
+# of strokes drawn with xdotool, and prints the CPU time and the
+# wakeups (voluntary context switches) of the process from /proc,
+# followed by the report of the frontend itself, if it has one.
+# Every session runs with the MIT-SHM backing store and again with
+# WHITEBOARD_NO_SHM; X errors, a crash or, with MIT-SHM, puts that
+# were never completed are reported as failures.
+# Run as:  bench/x11loop.sh [-s seconds] whiteboard...
+# Needs Xvfb and xdotool.
+#
+
+SECONDS_PER_RUN=10
+if [ "$1" = "-s" ]; then
+    SECONDS_PER_RUN=$2
+    shift 2
+fi
+if [ $# -eq 0 ]; then
+    echo "Usage: $0 [-s seconds] whiteboard..." >&2
+    exit 1
+fi
+
+# The Quit button (QUIT_BUTTON in board.h); the window is at 0, 0
+QUIT_X=763
+QUIT_Y=20
+HZ=$(getconf CLK_TCK)
+
+Xvfb :77 -screen 0 1280x1024x24 -nolisten tcp >/dev/null 2>&1 &
+XVFB=$!
+trap 'kill $XVFB 2>/dev/null' EXIT
+export DISPLAY=:77
+sleep 1
+
+# CPU ticks (user + system) and voluntary context switches
+procStats() {
+    cpu=$(awk '{ print $14 + $15 }' /proc/$1/stat)
+    switches=$(awk '/^voluntary_ctxt_switches/ { print $2 }' /proc/$1/status)
+    echo "$cpu $switches"
+}
+
+# Loops over the middle of the window, as a pen would
+drawStrokes() {
+    end=$(($(date +%s) + SECONDS_PER_RUN))
+    y=200
+    while [ $(date +%s) -lt $end ]; do
+        xdotool mousemove 100 $y mousedown 1
+        x=100
+        while [ $x -lt 1100 ]; do
+            xdotool mousemove $x $((y + (x / 7) % 40))
+            x=$((x + 4))
+        done
+        xdotool mouseup 1
+        y=$((y + 50))
+        [ $y -gt 900 ] && y=200
+    done
+}
+
+FAILED=0
+
+# run binary mode shm|noshm
+run() {
+    log=$(mktemp)
+    if [ "$3" = shm ]; then
+        "$1" 2>"$log" >/dev/null &
+    else
+        WHITEBOARD_NO_SHM=1 "$1" 2>"$log" >/dev/null &
+    fi
+    pid=$!
+    sleep 2     # Startup and the first full redraw
+    set -- "$1" "$2 $3" $(procStats $pid)
+    case "$2" in idle*)
+        sleep "$SECONDS_PER_RUN" ;;
+    *)
+        drawStrokes ;;
+    esac
+    set -- "$@" $(procStats $pid)
+    xdotool mousemove $QUIT_X $QUIT_Y click 1
+    # A lost ShmCompletion would hang the frontend in sync()
+    n=0
+    while kill -0 $pid 2>/dev/null && [ $n -lt 10 ]; do
+        sleep 1
+        n=$((n + 1))
+    done
+    if kill -0 $pid 2>/dev/null; then
+        echo "    hung at exit" >>"$log"
+        kill -9 $pid
+    fi
+    wait $pid
+    status=$?
+    echo "$1, $2: CPU $(echo "$3 $4 $5 $6 $HZ $SECONDS_PER_RUN" | awk '{
+        cpu = ($3 - $1) / $5; printf "%.2f s (%.2f%%), %.1f wakeups/s",
+        cpu, 100 * cpu / $6, ($4 - $2) / $6 }')"
+    sed 's/^/    /' "$log"
+    if [ $status -ne 0 ] || grep -q "X Error" "$log"; then
+        echo "    FAILED: exit status $status"
+        FAILED=1
+    fi
+    # Every shared put must have been waited for
+    if awk '/^Backing store: MIT-SHM/ && $4 != $6 { bad = 1 }
+        END { exit !bad }' "$log"; then
+        echo "    FAILED: puts without ShmCompletion"
+        FAILED=1
+    fi
+    rm -f "$log"
+}
+
+for binary in "$@"; do
+    for mode in shm noshm; do
+        run "$binary" idle $mode
+        run "$binary" draw $mode
+    done
+done
+exit $FAILED
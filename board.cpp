@@ -0,0 +1,693 @@
+#include <math.h>
+#include <assert.h>
+#include <stdlib.h>
+#include "board.h"
+
+const unsigned int paletteRgb[NUM_PALETTE_COLORS] = {
+    0x000000,   // Black
+    0x0000ff,   // Blue
+    0xff0000,   // Red
+    0x008000,   // Dark green
+    0xffffff,   // White (eraser)
+    0xc0c0c0,   // Light gray
+    0x9fb6cd    // SlateGray3
+};
+
+const double lodTolerances[NUM_LOD_LEVELS] = {
+    1., 2., 4., 8., 16.
+};
+
+// Positions of buttons
+const I2Rectangle buttonRects[NUM_BUTTONS] = {
+    I2Rectangle(I2Point(10, 10), BUTTON_WIDTH, BUTTON_HEIGHT),
+    I2Rectangle(I2Point(10 + BUTTON_DX, 10), BUTTON_WIDTH, BUTTON_HEIGHT),
+    I2Rectangle(I2Point(10 + 2*BUTTON_DX, 10), BUTTON_WIDTH, BUTTON_HEIGHT),
+    I2Rectangle(I2Point(10 + 3*BUTTON_DX, 10), BUTTON_WIDTH, BUTTON_HEIGHT),
+    I2Rectangle(I2Point(10 + 4*BUTTON_DX, 10), BUTTON_WIDTH, BUTTON_HEIGHT),
+    I2Rectangle(I2Point(10 + 5*BUTTON_DX, 10), BUTTON_WIDTH, BUTTON_HEIGHT),
+    I2Rectangle(I2Point(10 + 6*BUTTON_DX, 10), BUTTON_WIDTH, BUTTON_HEIGHT),
+    I2Rectangle(
+        I2Point(10 + 7*BUTTON_DX, 10),
+        BUTTON_WIDTH2, BUTTON_HEIGHT
+    ),
+    I2Rectangle(
+        I2Point(10 + 7*BUTTON_DX + BUTTON_DX2, 10),
+        BUTTON_WIDTH2, BUTTON_HEIGHT
+    ),
+    I2Rectangle(
+        I2Point(10 + 7*BUTTON_DX + 2*BUTTON_DX2, 10),
+        BUTTON_WIDTH2, BUTTON_HEIGHT
+    ),
+    I2Rectangle(
+        I2Point(10 + 7*BUTTON_DX + 3*BUTTON_DX2, 10),
+        BUTTON_WIDTH2, BUTTON_HEIGHT
+    ),
+    I2Rectangle(
+        I2Point(10 + 7*BUTTON_DX + 4*BUTTON_DX2, 10),
+        BUTTON_WIDTH, BUTTON_HEIGHT
+    ),
+    I2Rectangle(
+        I2Point(10 + 9*BUTTON_DX + 4*BUTTON_DX2, 10),
+        BUTTON_WIDTH, BUTTON_HEIGHT
+    )
+};
+
+const I2Rectangle lineTypeRect(
+    I2Point(10 + 8*BUTTON_DX + 4*BUTTON_DX2, 10),
+    BUTTON_WIDTH, BUTTON_HEIGHT
+);
+
+static const char* const buttonLabels[NUM_BUTTONS] = {
+    "Black", "Red", "Blue", "Green", "Clear", "Eraser", "Calibrate",
+    0, 0, 0, 0,     // Line widths
+    "Quit", "Select"
+};
+
+static int splitCoordinate(double v, int& offset) {
+    double s = floor(v * SUBPIXELS + 0.5);
+    double whole = floor((s + SUBPIXELS/2) / SUBPIXELS);
+    offset = (int)(s - whole * SUBPIXELS);
+    return (int) whole;
+}
+
+I2Point splitPoint(const R2Point& q, unsigned char& fraction) {
+    int dx, dy;
+    I2Point p(splitCoordinate(q.x, dx), splitCoordinate(q.y, dy));
+    fraction = packFraction(dx, dy);
+    return p;
+}
+
+//----------------------------------------------------------
+// Stroke
+
+// The offsets are stored from the first point that has one
+static void setFraction(Stroke& str, int i, unsigned char fraction) {
+    if (str.fractions.empty() && fraction == 0)
+        return;
+    size_t capacity = str.fractions.capacity();
+    if ((int) str.fractions.size() < str.size())
+        str.fractions.resize(str.size(), 0);
+    str.fractions[i] = fraction;
+    allocCounters[ALLOC_STROKE_POINTS].resized(
+        capacity, str.fractions.capacity(), 1
+    );
+}
+
+bool Stroke::push_back(
+    StreamDecimator& decimator, const I2Point& p,
+    int pressure /* = NO_PRESSURE */, unsigned char fraction /* = 0 */
+) {
+    size_t capacity = points.capacity();
+    size_t pressureCapacity = pressures.capacity();
+    if (size() == 0) {
+        points.push_back(p);
+        allocCounters[ALLOC_STROKE_POINTS].resized(
+            capacity, points.capacity(), sizeof(I2Point)
+        );
+        setFraction(*this, 0, fraction);
+        if (pressure != NO_PRESSURE) {
+            pressures.push_back((unsigned char) pressure);
+            allocCounters[ALLOC_STROKE_POINTS].resized(
+                pressureCapacity, pressures.capacity(), 1
+            );
+        }
+        bbox = I2Rectangle(p, 0, 0);
+        decimator.reset();
+        ++decimator.stats.inputPoints;
+        dropCache();
+        return true;
+    }
+    if (p == points.back() && fraction == this->fraction(size() - 1))
+        return false;
+
+    ++decimator.stats.inputPoints;
+    bbox.add(I2Rectangle(p, 0, 0));
+    int n = size();
+    // The tail may move, the points before it are kept
+    invalidateCache(n - 1);
+    bool merge = (n >= 2);
+    if (hasPressure()) {
+        if (pressure == NO_PRESSURE)
+            pressure = pressures.back();
+        if (abs(pressure - pressures.back()) > PRESSURE_MERGE_TOLERANCE) {
+            // The width changes here: keep the tail
+            merge = false;
+            decimator.reset();
+        }
+    }
+    if (
+        merge &&
+        decimator.replaceTail(
+            exactPoint(n-2), exactPoint(n-1), subpixelPoint(p, fraction)
+        )
+    ) {
+        // Nearly collinear: move the tail instead of adding
+        points[n-1] = p;
+        setFraction(*this, n-1, fraction);
+        if (hasPressure())
+            pressures[n-1] = (unsigned char) pressure;
+        return false;
+    }
+    points.push_back(p);
+    allocCounters[ALLOC_STROKE_POINTS].resized(
+        capacity, points.capacity(), sizeof(I2Point)
+    );
+    setFraction(*this, n, fraction);
+    if (hasPressure()) {
+        pressures.push_back((unsigned char) pressure);
+        allocCounters[ALLOC_STROKE_POINTS].resized(
+            pressureCapacity, pressures.capacity(), 1
+        );
+    }
+    return true;
+}
+
+void Stroke::append(
+    const I2Point& p, int pressure /* = NO_PRESSURE */,
+    unsigned char fraction /* = 0 */
+) {
+    size_t capacity = points.capacity();
+    size_t pressureCapacity = pressures.capacity();
+    bool first = (size() == 0);
+    points.push_back(p);
+    allocCounters[ALLOC_STROKE_POINTS].resized(
+        capacity, points.capacity(), sizeof(I2Point)
+    );
+    setFraction(*this, size() - 1, fraction);
+    if (hasPressure() || (first && pressure != NO_PRESSURE)) {
+        if (pressure == NO_PRESSURE)
+            pressure = pressures.back();
+        pressures.push_back((unsigned char) pressure);
+        allocCounters[ALLOC_STROKE_POINTS].resized(
+            pressureCapacity, pressures.capacity(), 1
+        );
+    }
+    if (first)
+        bbox = I2Rectangle(p, 0, 0);
+    else
+        bbox.add(I2Rectangle(p, 0, 0));
+    dropCache();
+}
+
+void Stroke::translate(const I2Vector& v) {
+    for (unsigned int i = 0; i < points.size(); ++i)
+        points[i] += v;
+    for (unsigned int l = 0; l < levels.size(); ++l) {
+        std::vector<I2Point>& nodes = levels[l].points;
+        for (unsigned int i = 0; i < nodes.size(); ++i)
+            nodes[i] += v;
+    }
+    bbox.shift(v);
+    dropCache();
+}
+
+void Stroke::finalize() {
+    finished = true;
+    dropCache();
+
+    // Level-of-detail pyramid. Every level is simplified from
+    // the full polyline, so its error is bounded by its tolerance.
+    countLevels(false);
+    levels.clear();
+    int lastSize = size();
+    std::vector<I2Point> simplified;
+    std::vector<int> kept;
+    for (int l = 0; l < NUM_LOD_LEVELS && lastSize > 2; ++l) {
+        simplifyDouglasPeucker(
+            &(points[0]), size(), lodTolerances[l], simplified,
+            hasPressure()? &kept : 0
+        );
+        int n = (int) simplified.size();
+        if (4*n > 3*lastSize)
+            continue;   // Not worth a level
+
+        // Copy the points once, into the level in place
+        levels.push_back(StrokeLevel());
+        StrokeLevel& level = levels.back();
+        level.tolerance = lodTolerances[l];
+        level.points = simplified;
+        if (hasPressure()) {
+            level.pressures.resize(n);
+            for (int i = 0; i < n; ++i)
+                level.pressures[i] = pressures[kept[i]];
+        }
+        lastSize = n;
+    }
+    countLevels(true);
+}
+
+void Stroke::countBuffers(bool allocated) const {
+    AllocCounter& c = allocCounters[ALLOC_STROKE_POINTS];
+    long long size =
+        (long long)(points.capacity() * sizeof(I2Point)) +
+        (long long) pressures.capacity() +
+        (long long) fractions.capacity();
+    if (size > 0) {
+        if (allocated)
+            c.allocated(size);
+        else
+            c.freed(size);
+    }
+    countLevels(allocated);
+}
+
+void Stroke::countLevels(bool allocated) const {
+    AllocCounter& c = allocCounters[ALLOC_STROKE_POINTS];
+    for (unsigned int l = 0; l < levels.size(); ++l) {
+        long long size =
+            (long long)(levels[l].points.capacity() * sizeof(I2Point)) +
+            (long long) levels[l].pressures.capacity();
+        if (size == 0)
+            continue;
+        if (allocated)
+            c.allocated(size);
+        else
+            c.freed(size);
+    }
+}
+
+//----------------------------------------------------------
+// Board
+
+Board::Board():
+    currentPage(0),
+    myDrawing(),
+    myDecimator(),
+    decimationTolerance(DECIMATION_TOLERANCE),
+    myDrawingActive(false),
+    numDrawnPoints(0),
+    myStaleInk(),
+    currentColor(BLACK_COLOR_IDX),
+    currentWidth(THICK_WIDTH),
+    lastColor(BLACK_COLOR_IDX),
+    lastWidth(THICK_WIDTH),
+    showSelectButton(false),
+    selectMode(false),
+    damage(),
+    pageDamage(),
+    touchStats()
+{}
+
+void Board::processAction(const Action& a) {
+    if (a.touchId != NO_TOUCH) {
+        processTouchAction(a);
+        return;
+    }
+    updateStroke(
+        a, myDrawing, myDecimator, myDrawingActive, numDrawnPoints,
+        myStaleInk
+    );
+}
+
+// Every finger draws its own stroke
+void Board::processTouchAction(const Action& a) {
+    std::map<int, TouchStroke>::iterator i = touchStrokes.find(a.touchId);
+    if (i == touchStrokes.end()) {
+        if (a.type != Action::START_CURVE)
+            return;
+        i = touchStrokes.insert(
+            std::make_pair(a.touchId, TouchStroke())
+        ).first;
+    }
+    TouchStroke& t = i->second;
+    bool active = true;
+    updateStroke(
+        a, t.stroke, t.decimator, active, t.numDrawnPoints, t.staleInk
+    );
+    if (!active) {
+        touchStats.add(t.decimator.stats);
+        touchStrokes.erase(i);
+    }
+}
+
+DecimationStats Board::decimationStats() const {
+    DecimationStats s = myDecimator.stats;
+    s.add(touchStats);
+    std::map<int, TouchStroke>::const_iterator i = touchStrokes.begin();
+    for (; i != touchStrokes.end(); ++i)
+        s.add(i->second.decimator.stats);
+    return s;
+}
+
+void Board::updateStroke(
+    const Action& a, Stroke& curve, StreamDecimator& decimator,
+    bool& active, int& numDrawn, Damage& stale
+) {
+    if (a.type == Action::START_CURVE) {
+        if (active && curve.size() > 0)
+            commitStroke(curve);
+        curve.clear();
+        stale.clear();
+        curve.color = a.color;
+        curve.width = a.width;
+        decimator.setTolerance(decimationTolerance);
+        curve.push_back(decimator, a.point, a.pressure, a.fraction);
+        active = true;
+        numDrawn = 0;
+        damage.add(a.point, curve.margin());
+    } else if (a.type == Action::DRAW_CURVE) {
+        if (!active || curve.size() == 0)
+            return;
+        int n = curve.size();
+        I2Point last = curve.points.back();
+        if (a.point == last && a.fraction == curve.fraction(n - 1))
+            return;
+        if (!curve.push_back(decimator, a.point, a.pressure, a.fraction)) {
+            // The tail has moved: redraw it from the previous point,
+            // and erase its old segment if it is drawn
+            if (numDrawn >= n) {
+                numDrawn = n - 1;
+                if (n >= 2)
+                    stale.add(curve.points[n-2], curve.margin());
+                stale.add(last, curve.margin());
+            }
+            if (n >= 2)
+                damage.add(curve.points[n-2], curve.margin());
+        } else if (n == 1 && numDrawn >= 1) {
+            // A lone point is drawn as a cross the line does not cover
+            stale.add(last, curve.margin() + 1);
+        }
+        damage.add(last, curve.margin());
+        damage.add(a.point, curve.margin());
+    } else if (a.type == Action::END_CURVE) {
+        if (active && curve.size() > 0) {
+            curve.push_back(decimator, a.point, a.pressure, a.fraction);
+            commitStroke(curve);
+        }
+        active = false;
+        numDrawn = 0;
+    }
+}
+
+void Board::commitStroke(Stroke& curve) {
+    curve.finalize();
+    int m = curve.margin();
+    I2Rectangle r(
+        curve.bbox.left() - m, curve.bbox.top() - m,
+        curve.bbox.width() + 2*m + 1, curve.bbox.height() + 2*m + 1
+    );
+    damage.add(r);
+    pageDamage.add(r);
+    page().addStroke(curve);
+    curve.clear();
+}
+
+void Board::clearPage() {
+    page().clear();
+    myDrawing.clear();
+    myDrawingActive = false;
+    numDrawnPoints = 0;
+    myStaleInk.clear();
+    std::map<int, TouchStroke>::const_iterator i = touchStrokes.begin();
+    for (; i != touchStrokes.end(); ++i)
+        touchStats.add(i->second.decimator.stats);
+    touchStrokes.clear();
+}
+
+int Board::buttonAt(const I2Point& p) const {
+    for (int i = 0; i < NUM_BUTTONS; ++i) {
+        if (i == SELECT_BUTTON && !showSelectButton)
+            continue;
+        if (buttonRects[i].contains(p))
+            return i;
+    }
+    return (-1);
+}
+
+bool Board::pressButton(int button) {
+    switch (button) {
+    case BLACK_BUTTON:
+    case BLUE_BUTTON:
+    case RED_BUTTON:
+    case GREEN_BUTTON:
+        if (button == BLACK_BUTTON)
+            currentColor = BLACK_COLOR_IDX;
+        else if (button == BLUE_BUTTON)
+            currentColor = BLUE_COLOR_IDX;
+        else if (button == RED_BUTTON)
+            currentColor = RED_COLOR_IDX;
+        else
+            currentColor = GREEN_COLOR_IDX;
+        lastColor = currentColor;
+        currentWidth = lastWidth;
+        break;
+    case ERASE_BUTTON:
+        currentColor = ERASER_COLOR_IDX;
+        currentWidth = ERASER_WIDTH;
+        break;
+    case THIN_BUTTON:
+    case NORMAL_BUTTON:
+    case THICK_BUTTON:
+    case VERY_THICK_BUTTON:
+        if (button == THIN_BUTTON)
+            currentWidth = THIN_WIDTH;
+        else if (button == NORMAL_BUTTON)
+            currentWidth = NORMAL_WIDTH;
+        else if (button == THICK_BUTTON)
+            currentWidth = THICK_WIDTH;
+        else
+            currentWidth = VERY_THICK_WIDTH;
+        lastWidth = currentWidth;
+        currentColor = lastColor;
+        break;
+    case CLEAR_BUTTON:
+        // The page itself is cleared by the frontend
+        currentColor = BLACK_COLOR_IDX;
+        lastColor = currentColor;
+        currentWidth = LINE_WIDTH;
+        return false;
+    default:
+        return false;
+    }
+    myDrawing.color = currentColor;
+    myDrawing.width = currentWidth;
+    return true;
+}
+
+void Board::takeSnapshot(BoardSnapshot& s) const {
+    for (int p = 0; p < MAX_PAGES; ++p)
+        s.pages[p] = pages[p].strokes;
+}
+
+void Board::drawPage(
+    RenderBackend& r, const R2Rectangle& world,
+    const std::vector<char>* hidden /* = 0 */
+) const {
+    page().draw(r, world, hidden);
+}
+
+void Page::draw(
+    RenderBackend& r, const R2Rectangle& world,
+    const std::vector<char>* hidden /* = 0 */
+) const {
+    // Note: as the world Y axis goes down, world.bottom() is the
+    // minimal y, while for I2Rectangle top() is the minimal y.
+    I2Rectangle query(
+        (int) floor(world.left()), (int) floor(world.bottom()),
+        (int) ceil(world.width()) + 1, (int) ceil(world.height()) + 1
+    );
+    std::vector<int> visible;
+    grid.query(query, visible);  // In drawing order
+
+    for (unsigned int k = 0; k < visible.size(); ++k) {
+        unsigned int i = (unsigned int) visible[k];
+        if (hidden != 0 && i < hidden->size() && (*hidden)[i])
+            continue;   // Dragged in a sprite
+        const Stroke& str = *strokes[i];
+        int w = str.margin();
+        if (
+            str.bbox.right() + w < world.left() ||
+            str.bbox.left() - w > world.right() ||
+            str.bbox.bottom() + w < world.bottom() ||
+            str.bbox.top() - w > world.top()
+        )
+            continue;   // Culled
+        r.drawStroke(str, &world);
+    }
+}
+
+bool contentRect(const StrokeList& strokes, I2Rectangle& r) {
+    Damage d;
+    for (unsigned int i = 0; i < strokes.size(); ++i) {
+        const Stroke& str = *strokes[i];
+        if (str.size() == 0)
+            continue;
+        int m = str.margin() + PAGE_MARGIN;
+        d.add(I2Rectangle(
+            str.bbox.left() - m, str.bbox.top() - m,
+            str.bbox.width() + 2*m + 1, str.bbox.height() + 2*m + 1
+        ));
+    }
+    r = d.rect;
+    return !d.empty;
+}
+
+void Board::drawLiveStroke(RenderBackend& r) const {
+    if (myDrawingActive)
+        r.drawStroke(myDrawing, 0);
+    std::map<int, TouchStroke>::const_iterator i = touchStrokes.begin();
+    for (; i != touchStrokes.end(); ++i)
+        r.drawStroke(i->second.stroke, 0);
+}
+
+void Board::drawLiveInk(
+    RenderBackend& r, std::vector<I2Rectangle>* drawn /* = 0 */
+) {
+    if (myDrawingActive)
+        drawStrokeTail(r, myDrawing, numDrawnPoints, drawn);
+    std::map<int, TouchStroke>::iterator i = touchStrokes.begin();
+    for (; i != touchStrokes.end(); ++i)
+        drawStrokeTail(r, i->second.stroke, i->second.numDrawnPoints, drawn);
+}
+
+void Board::takeStaleInk(std::vector<I2Rectangle>& rects) {
+    if (!myStaleInk.empty) {
+        rects.push_back(myStaleInk.rect);
+        myStaleInk.clear();
+    }
+    std::map<int, TouchStroke>::iterator i = touchStrokes.begin();
+    for (; i != touchStrokes.end(); ++i) {
+        if (!i->second.staleInk.empty) {
+            rects.push_back(i->second.staleInk.rect);
+            i->second.staleInk.clear();
+        }
+    }
+}
+
+// The work is proportional to the number of new points
+void Board::drawStrokeTail(
+    RenderBackend& r, const Stroke& str, int& numDrawn,
+    std::vector<I2Rectangle>* drawn
+) {
+    int n = str.size();
+    if (numDrawn >= n)
+        return;
+    r.drawStrokeTail(str, numDrawn);
+    if (drawn != 0) {
+        // The tail is drawn from the last point drawn before
+        int first = (numDrawn > 0)? numDrawn - 1 : 0;
+        int xMin = str.points[first].x, xMax = xMin;
+        int yMin = str.points[first].y, yMax = yMin;
+        for (int i = first + 1; i < n; ++i) {
+            const I2Point& p = str.points[i];
+            if (p.x < xMin) xMin = p.x;
+            if (p.x > xMax) xMax = p.x;
+            if (p.y < yMin) yMin = p.y;
+            if (p.y > yMax) yMax = p.y;
+        }
+        int m = str.margin();
+        drawn->push_back(I2Rectangle(
+            xMin - m, yMin - m, xMax - xMin + 2*m + 1, yMax - yMin + 2*m + 1
+        ));
+    }
+    numDrawn = n;
+}
+
+void Board::drawButtons(RenderBackend& r) const {
+    static const int colorButtonBg[4] = {
+        BLACK_COLOR_IDX, RED_COLOR_IDX, BLUE_COLOR_IDX, GREEN_COLOR_IDX
+    };
+    for (int i = BLACK_BUTTON; i <= GREEN_BUTTON; ++i) {
+        drawButton(
+            r, buttonRects[i], buttonLabels[i],
+            WHITE_COLOR_IDX, colorButtonBg[i - BLACK_BUTTON]
+        );
+    }
+    drawButton(
+        r, buttonRects[CLEAR_BUTTON], buttonLabels[CLEAR_BUTTON],
+        BLACK_COLOR_IDX, WHITE_COLOR_IDX
+    );
+    drawButton(
+        r, buttonRects[ERASE_BUTTON], buttonLabels[ERASE_BUTTON],
+        BLACK_COLOR_IDX, SLATE_GRAY_COLOR_IDX
+    );
+    drawButton(
+        r, buttonRects[CALIBRATE_BUTTON], buttonLabels[CALIBRATE_BUTTON],
+        BLACK_COLOR_IDX, SLATE_GRAY_COLOR_IDX
+    );
+    drawButton(
+        r, buttonRects[QUIT_BUTTON], buttonLabels[QUIT_BUTTON],
+        BLACK_COLOR_IDX, SLATE_GRAY_COLOR_IDX
+    );
+    if (showSelectButton) {
+        drawButton(
+            r, buttonRects[SELECT_BUTTON], buttonLabels[SELECT_BUTTON],
+            selectMode? WHITE_COLOR_IDX : BLACK_COLOR_IDX,
+            selectMode? BLACK_COLOR_IDX : SLATE_GRAY_COLOR_IDX
+        );
+    }
+
+    static const int lineWidths[4] = {
+        THIN_WIDTH, NORMAL_WIDTH, THICK_WIDTH, VERY_THICK_WIDTH
+    };
+    for (int i = THIN_BUTTON; i <= VERY_THICK_BUTTON; ++i) {
+        drawLineButton(
+            r, buttonRects[i], lineWidths[i - THIN_BUTTON],
+            BLACK_COLOR_IDX, WHITE_COLOR_IDX
+        );
+    }
+
+    drawCurrentLineType(r);
+}
+
+void Board::drawCurrentLineType(RenderBackend& r) const {
+    // Erase the rectangle
+    r.fillRect(
+        I2Rectangle(
+            lineTypeRect.left() - 2, lineTypeRect.top() - 1,
+            lineTypeRect.width() + 4, lineTypeRect.height() + 2
+        ),
+        WHITE_COLOR_IDX
+    );
+    int x = lineTypeRect.left();
+    int y = (lineTypeRect.top() + lineTypeRect.bottom())/2 - 2;
+    r.drawLine(
+        I2Point(x, y), I2Point(x + BUTTON_WIDTH, y),
+        currentWidth, currentColor
+    );
+}
+
+void Board::drawButtonFrame(
+    RenderBackend& r, const I2Rectangle& rect
+) const {
+    I2Point lb(rect.left(), rect.bottom());
+    I2Point lt(rect.left(), rect.top());
+    I2Point rt(rect.right(), rect.top());
+    I2Point rb(rect.right(), rect.bottom());
+    r.drawLine(lb, lt, 1, LIGHT_GRAY_COLOR_IDX);
+    r.drawLine(lt, rt, 1, LIGHT_GRAY_COLOR_IDX);
+    r.drawLine(rt, rb, 1, BLACK_COLOR_IDX);
+    r.drawLine(rb, lb, 1, BLACK_COLOR_IDX);
+}
+
+void Board::drawButton(
+    RenderBackend& r,
+    const I2Rectangle& rect,
+    const char* text,
+    int fgColor,
+    int bgColor
+) const {
+    r.fillRect(rect, bgColor);
+    drawButtonFrame(r, rect);
+    r.drawText(
+        I2Point(rect.left() + 8, rect.top() + 14),
+        text, fgColor
+    );
+}
+
+void Board::drawLineButton(
+    RenderBackend& r,
+    const I2Rectangle& rect,
+    int lineWidth,
+    int fgColor,
+    int bgColor
+) const {
+    r.fillRect(rect, bgColor);
+    drawButtonFrame(r, rect);
+    int y = (rect.top() + rect.bottom())/2;
+    r.drawLine(
+        I2Point(rect.left() + 2, y),
+        I2Point(rect.right() - 2, y),
+        lineWidth, fgColor
+    );
+}
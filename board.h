@@ -0,0 +1,754 @@
+//
+// White board engine shared by the Qt and X11 frontends:
+// strokes, pages, tools, action processing and damage tracking.
+// It does not depend on a window system; drawing goes through
+// the RenderBackend interface.
+//
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <vector>
+#include <map>
+#include "R2Graph.h"
+#include "strokegrid.h"
+#include "polyline.h"
+#include "allocstats.h"
+#include "renderbackend.h"
+
+const int DX = 80;
+const int DY = 80;
+const int THIN_WIDTH = 1;
+const int NORMAL_WIDTH = 2;
+const int THICK_WIDTH = 3;
+const int VERY_THICK_WIDTH = 5;
+const int LINE_WIDTH = THICK_WIDTH;
+
+const int ERASER_WIDTH = 32;
+
+// Pen pressure of a point, 0..MAX_PRESSURE. A pressure stroke has
+// its width at NOMINAL_PRESSURE; full pressure doubles it.
+const int MAX_PRESSURE = 255;
+const int NOMINAL_PRESSURE = 128;
+const int NO_PRESSURE = -1;             // Mouse input
+// Half-width of a pressure stroke at zero pressure, in pixels
+const double MIN_PRESSURE_RADIUS = 0.35;
+// Input points whose pressures differ more are not merged
+const int PRESSURE_MERGE_TOLERANCE = 8;
+
+// Touch point id of the actions of the pen and the mouse
+const int NO_TOUCH = -1;
+
+// Points drawn zoomed in are finer than pixels: each coordinate
+// has an offset of -8..7 sixteenths from its nearest whole pixel.
+// The two offsets are packed into a byte, x in the high nibble;
+// 0 is a whole pixel.
+const int SUBPIXELS = 16;
+
+inline unsigned char packFraction(int dx, int dy) {
+    return (unsigned char)(((dx & 15) << 4) | (dy & 15));
+}
+
+inline int fractionX(unsigned char fraction) {
+    return ((fraction >> 4) ^ 8) - 8;
+}
+
+inline int fractionY(unsigned char fraction) {
+    return ((fraction & 15) ^ 8) - 8;
+}
+
+inline R2Point subpixelPoint(const I2Point& p, unsigned char fraction) {
+    return R2Point(
+        p.x + fractionX(fraction) / (double) SUBPIXELS,
+        p.y + fractionY(fraction) / (double) SUBPIXELS
+    );
+}
+
+// The nearest whole pixel to q and the offset of q from it,
+// rounded to sixteenths
+I2Point splitPoint(const R2Point& q, unsigned char& fraction);
+
+// Palette: stroke colors first, then the colors of the buttons
+const int BLACK_COLOR_IDX = 0;
+const int BLUE_COLOR_IDX = 1;
+const int RED_COLOR_IDX = 2;
+const int GREEN_COLOR_IDX = 3;
+const int ERASER_COLOR_IDX = 4;
+const int NUM_COLORS = 5;                   // Stroke colors
+const int WHITE_COLOR_IDX = ERASER_COLOR_IDX;
+const int LIGHT_GRAY_COLOR_IDX = 5;
+const int SLATE_GRAY_COLOR_IDX = 6;
+const int NUM_PALETTE_COLORS = 7;
+extern const unsigned int paletteRgb[NUM_PALETTE_COLORS];  // 0xRRGGBB
+
+const int MODE_CALIBRATION = 0;
+const int MODE_NORMAL = 1;
+const int MAX_PAGES = 8;
+// Blank around the strokes of a page rendered on its own
+const int PAGE_MARGIN = 20;
+
+// Buttons
+const int BUTTON_WIDTH = 70;
+const int BUTTON_WIDTH2 = BUTTON_WIDTH/2;
+const int BUTTON_HEIGHT = 20;
+const int BUTTON_SKIP = 8;
+const int BUTTON_DX = BUTTON_WIDTH + BUTTON_SKIP;
+const int BUTTON_DX2 = BUTTON_WIDTH2 + BUTTON_SKIP;
+
+enum {
+    BLACK_BUTTON,
+    RED_BUTTON,
+    BLUE_BUTTON,
+    GREEN_BUTTON,
+    CLEAR_BUTTON,
+    ERASE_BUTTON,
+    CALIBRATE_BUTTON,
+    THIN_BUTTON,
+    NORMAL_BUTTON,
+    THICK_BUTTON,
+    VERY_THICK_BUTTON,
+    QUIT_BUTTON,
+    SELECT_BUTTON,      // Placed after the current line type sample
+    NUM_BUTTONS
+};
+extern const I2Rectangle buttonRects[NUM_BUTTONS];
+extern const I2Rectangle lineTypeRect;      // Current line type sample
+
+// Lower edge of the row of buttons
+const int TOOLBAR_BOTTOM = 10 + BUTTON_HEIGHT + 2;
+
+// Tolerances (in pixels) of the simplified levels of a stroke
+const int NUM_LOD_LEVELS = 5;
+extern const double lodTolerances[NUM_LOD_LEVELS];
+
+// A simplified copy of the stroke polyline
+class StrokeLevel {
+public:
+    double tolerance;
+    std::vector<I2Point> points;
+    std::vector<unsigned char> pressures;   // As in Stroke
+    // Levels are only drawn zoomed out: their points are whole pixels
+
+    StrokeLevel():
+        tolerance(0.),
+        points(),
+        pressures()
+    {}
+};
+
+// Data that a backend derives from the points of a stroke and
+// keeps with it, e.g. a QPainterPath. It is dropped whenever
+// the points change and is not copied with the stroke.
+class StrokeCache {
+public:
+    virtual ~StrokeCache() {}
+
+    // The points from first on have changed, the ones before are
+    // kept. Return true if the cache stays valid, e.g. because it
+    // only covers the kept points.
+    virtual bool pointsChanged(int /* first */) {
+        return false;
+    }
+};
+
+class Stroke {
+public:
+    int color;
+    int width;
+    std::vector<I2Point> points;
+    // Per point for a pressure stroke, empty for a constant width
+    std::vector<unsigned char> pressures;
+    // Per point sub-pixel offsets (see subpixelPoint), empty while
+    // all the points are whole pixels
+    std::vector<unsigned char> fractions;
+    I2Rectangle bbox;           // Bounding box of points
+    std::vector<StrokeLevel> levels;    // Coarser with each level
+    bool finished;
+    mutable StrokeCache* cache;
+
+    Stroke():
+        color(BLACK_COLOR_IDX),
+        width(1),
+        points(),
+        pressures(),
+        fractions(),
+        bbox(),
+        levels(),
+        finished(false),
+        cache(0)
+    {}
+
+    Stroke(const Stroke& str):
+        color(str.color),
+        width(str.width),
+        points(str.points),
+        pressures(str.pressures),
+        fractions(str.fractions),
+        bbox(str.bbox),
+        levels(str.levels),
+        finished(str.finished),
+        cache(0)
+    {
+        countBuffers(true);
+    }
+
+    ~Stroke() {
+        countBuffers(false);
+        delete cache;
+    }
+
+    Stroke& operator=(const Stroke& str) {
+        if (&str == this)
+            return *this;
+        countBuffers(false);
+        color = str.color;
+        width = str.width;
+        points = str.points;
+        pressures = str.pressures;
+        fractions = str.fractions;
+        bbox = str.bbox;
+        levels = str.levels;
+        finished = str.finished;
+        dropCache();
+        countBuffers(true);
+        return *this;
+    }
+
+    int size() const {
+        return (int) points.size();
+    }
+
+    bool hasPressure() const {
+        return !pressures.empty();
+    }
+
+    unsigned char fraction(int i) const {
+        return fractions.empty()? 0 : fractions[i];
+    }
+
+    // A point with its sub-pixel offset
+    R2Point exactPoint(int i) const {
+        return subpixelPoint(points[i], fraction(i));
+    }
+
+    // Half-width at the pressure of a point
+    double radius(int pressure) const {
+        double r = 0.5 * width * pressure / NOMINAL_PRESSURE;
+        return (r > MIN_PRESSURE_RADIUS)? r : MIN_PRESSURE_RADIUS;
+    }
+
+    void dropCache() const {
+        delete cache;
+        cache = 0;
+    }
+
+    // The points from first on have changed
+    void invalidateCache(int first) const {
+        if (cache != 0 && !cache->pointsChanged(first))
+            dropCache();
+    }
+
+    void clear() {
+        points.clear();     // Keeps its buffer
+        pressures.clear();
+        fractions.clear();
+        countLevels(false);
+        levels.clear();
+        finished = false;
+        dropCache();
+    }
+
+    // Return false if the point was merged by the decimator into
+    // the tail (the last point moved) or was equal to it. The
+    // pressure of the first point makes a pressure stroke;
+    // afterwards NO_PRESSURE repeats the last one.
+    bool push_back(
+        StreamDecimator& decimator, const I2Point& p,
+        int pressure = NO_PRESSURE, unsigned char fraction = 0
+    );
+
+    // Add the point as it is, without decimation: for the points of
+    // a stroke read back from a saved board
+    void append(
+        const I2Point& p, int pressure = NO_PRESSURE,
+        unsigned char fraction = 0
+    );
+
+    void translate(const I2Vector& v);
+
+    // Build the level-of-detail pyramid
+    void finalize();
+
+    // Allocation accounting of the point buffers
+    void countBuffers(bool allocated) const;
+    void countLevels(bool allocated) const;
+
+    // The coarsest level whose error is below half a device pixel
+    // at the given scale (device pixels per pixel); -1 means the
+    // full-resolution polyline
+    int levelForScale(double scale) const {
+        int l = -1;
+        while (
+            l + 1 < (int) levels.size() &&
+            levels[l + 1].tolerance * scale < 0.5
+        )
+            ++l;
+        return l;
+    }
+
+    // Half of the (maximal) line width plus a pixel of antialiasing
+    int margin() const {
+        if (hasPressure())
+            return width + 1;
+        return width/2 + 1;
+    }
+};
+
+// Shared ownership of a committed stroke, which does not change
+// any more: a page and its snapshots hold the same strokes. The
+// count is atomic as a snapshot may be read and released on
+// another thread; the cache of the stroke is only used by the
+// GUI thread.
+class StrokeRef {
+public:
+    StrokeRef():
+        node(0)
+    {}
+
+    // A shared copy of str
+    explicit StrokeRef(const Stroke& str):
+        node(new Node(str))
+    {}
+
+    StrokeRef(const StrokeRef& r):
+        node(r.node)
+    {
+        retain();
+    }
+
+    ~StrokeRef() {
+        release();
+    }
+
+    StrokeRef& operator=(const StrokeRef& r) {
+        if (r.node != node) {
+            r.retain();
+            release();
+            node = r.node;
+        }
+        return *this;
+    }
+
+    const Stroke& operator*() const {
+        return node->stroke;
+    }
+
+    const Stroke* operator->() const {
+        return &(node->stroke);
+    }
+
+private:
+    class Node {
+    public:
+        Stroke stroke;
+        int count;
+
+        Node(const Stroke& str):
+            stroke(str),
+            count(1)
+        {}
+    };
+
+    Node* node;
+
+    void retain() const {
+        if (node != 0)
+            __sync_add_and_fetch(&(node->count), 1);
+    }
+
+    void release() {
+        if (node != 0 && __sync_sub_and_fetch(&(node->count), 1) == 0)
+            delete node;
+        node = 0;
+    }
+};
+
+// The committed strokes of a page, shared with its snapshots: a
+// snapshot takes a reference to the array of handles, in O(1), and
+// the first change of the page after it copies the handles.
+class StrokeList {
+public:
+    StrokeList():
+        block(0)
+    {}
+
+    StrokeList(const StrokeList& l):
+        block(l.block)
+    {
+        retain();
+    }
+
+    ~StrokeList() {
+        release();
+    }
+
+    StrokeList& operator=(const StrokeList& l) {
+        if (l.block != block) {
+            l.retain();
+            release();
+            block = l.block;
+        }
+        return *this;
+    }
+
+    size_t size() const {
+        return (block != 0)? block->refs.size() : 0;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    size_t capacity() const {
+        return (block != 0)? block->refs.capacity() : 0;
+    }
+
+    const StrokeRef& operator[](size_t i) const {
+        return block->refs[i];
+    }
+
+    const StrokeRef& back() const {
+        return block->refs.back();
+    }
+
+    void push_back(const StrokeRef& r) {
+        detach();
+        block->refs.push_back(r);
+    }
+
+    void set(size_t i, const StrokeRef& r) {
+        detach();
+        block->refs[i] = r;
+    }
+
+    void clear() {
+        release();
+    }
+
+private:
+    class Block {
+    public:
+        std::vector<StrokeRef> refs;
+        int count;
+
+        Block():
+            refs(),
+            count(1)
+        {}
+    };
+
+    Block* block;
+
+    void retain() const {
+        if (block != 0)
+            __sync_add_and_fetch(&(block->count), 1);
+    }
+
+    void release() {
+        if (block != 0 && __sync_sub_and_fetch(&(block->count), 1) == 0)
+            delete block;
+        block = 0;
+    }
+
+    // Make the array of this list its own
+    void detach() {
+        if (block == 0) {
+            block = new Block();
+        } else if (__atomic_load_n(&(block->count), __ATOMIC_ACQUIRE) > 1) {
+            Block* b = new Block();
+            b->refs.reserve(block->refs.capacity());
+            b->refs = block->refs;
+            release();
+            block = b;
+        }
+    }
+};
+
+class Action {
+public:
+    enum {
+        START_CURVE,
+        DRAW_CURVE,
+        END_CURVE
+    };
+
+    int type;
+    int color;
+    int width;
+    I2Point point;
+    int pressure;               // 0..MAX_PRESSURE or NO_PRESSURE
+    int touchId;                // Finger of a touch screen or NO_TOUCH
+    unsigned char fraction;     // Sub-pixel offset of point
+
+    Action():
+        type(START_CURVE),
+        color(0),
+        width(LINE_WIDTH),
+        point(),
+        pressure(NO_PRESSURE),
+        touchId(NO_TOUCH),
+        fraction(0)
+    {}
+
+    Action(
+        int t, int c, int w, const I2Point& pnt,
+        int prs = NO_PRESSURE, int touch = NO_TOUCH
+    ):
+        type(t),
+        color(c),
+        width(w),
+        point(pnt),
+        pressure(prs),
+        touchId(touch),
+        fraction(0)
+    {}
+};
+
+// The union of the strokes with their line widths, extended by
+// PAGE_MARGIN; false if there are none
+bool contentRect(const StrokeList& strokes, I2Rectangle& r);
+
+class Page {
+public:
+    // Committed strokes are replaced, never changed in place
+    StrokeList strokes;
+    StrokeGrid grid;
+    int version;                // Changed with the strokes
+
+    Page():
+        strokes(),
+        grid(),
+        version(0)
+    {}
+
+    void addStroke(const Stroke& str) {
+        size_t capacity = strokes.capacity();
+        strokes.push_back(StrokeRef(str));
+        allocCounters[ALLOC_PAGES].resized(
+            capacity, strokes.capacity(), sizeof(StrokeRef)
+        );
+        grid.insert((int) strokes.size() - 1, str.bbox);
+        ++version;
+    }
+
+    // Call reindex() when the bounding box has changed
+    void replaceStroke(int i, const Stroke& str) {
+        strokes.set(i, StrokeRef(str));
+        ++version;
+    }
+
+    void clear() {
+        allocCounters[ALLOC_PAGES].resized(
+            strokes.capacity(), 0, sizeof(StrokeRef)
+        );
+        strokes.clear();
+        grid.clear();
+        ++version;
+    }
+
+    void reindex() {
+        grid.clear();
+        for (unsigned int i = 0; i < strokes.size(); ++i)
+            grid.insert((int) i, strokes[i]->bbox);
+    }
+
+    // Strokes that intersect the world rectangle r, except the
+    // hidden ones
+    void draw(
+        RenderBackend& r, const R2Rectangle& world,
+        const std::vector<char>* hidden = 0
+    ) const;
+
+    bool contentRect(I2Rectangle& r) const {
+        return ::contentRect(strokes, r);
+    }
+};
+
+// Union of changed rectangles
+class Damage {
+public:
+    bool empty;
+    I2Rectangle rect;
+
+    Damage():
+        empty(true),
+        rect()
+    {}
+
+    void add(const I2Rectangle& r) {
+        if (empty)
+            rect = r;
+        else
+            rect.add(r);
+        empty = false;
+    }
+
+    // A rectangle around a point, extended by margin
+    void add(const I2Point& p, int margin) {
+        add(I2Rectangle(
+            p.x - margin, p.y - margin, 2*margin + 1, 2*margin + 1
+        ));
+    }
+
+    void clear() {
+        empty = true;
+    }
+};
+
+// A stroke drawn by one finger on a touch screen
+class TouchStroke {
+public:
+    Stroke stroke;
+    StreamDecimator decimator;
+    int numDrawnPoints;         // Drawn by drawLiveInk
+    Damage staleInk;            // See Board::takeStaleInk
+
+    TouchStroke():
+        stroke(),
+        decimator(),
+        numDrawnPoints(0),
+        staleInk()
+    {}
+};
+
+// The committed strokes of all pages at some moment, for work on
+// another thread. Taking one copies neither points nor handles.
+class BoardSnapshot {
+public:
+    StrokeList pages[MAX_PAGES];
+
+    int numStrokes() const {
+        int n = 0;
+        for (int p = 0; p < MAX_PAGES; ++p)
+            n += (int) pages[p].size();
+        return n;
+    }
+};
+
+class Board {
+public:
+    Page pages[MAX_PAGES];
+    int currentPage;
+
+    Stroke myDrawing;
+    StreamDecimator myDecimator;
+    // Of the strokes started from now on; finer than a pixel for
+    // ink drawn zoomed in
+    double decimationTolerance;
+    bool myDrawingActive;
+    int numDrawnPoints;         // Points of myDrawing drawn by drawLiveInk
+    Damage myStaleInk;          // See takeStaleInk
+
+    // Strokes of the fingers on a touch screen, by touch point id;
+    // drawn at the same time as myDrawing and each other
+    std::map<int, TouchStroke> touchStrokes;
+
+    // Tools
+    int currentColor;           // current color index
+    int currentWidth;           // current line width
+    int lastColor;
+    int lastWidth;
+    bool showSelectButton;
+    bool selectMode;
+
+    // In world coordinates, accumulated until cleared by the frontend
+    Damage damage;              // To be redrawn
+    Damage pageDamage;          // Committed strokes changed
+
+    Board();
+
+    Page& page() {
+        return pages[currentPage];
+    }
+
+    const Page& page() const {
+        return pages[currentPage];
+    }
+
+    void processAction(const Action& a);
+    void clearPage();
+    void takeSnapshot(BoardSnapshot& s) const;
+
+    // Changes with the committed strokes of any page
+    int version() const {
+        int v = 0;
+        for (int p = 0; p < MAX_PAGES; ++p)
+            v += pages[p].version;
+        return v;
+    }
+
+    // Of the input points of all strokes drawn so far
+    DecimationStats decimationStats() const;
+
+    // Some stroke is being drawn
+    bool drawingActive() const {
+        return myDrawingActive || !touchStrokes.empty();
+    }
+
+    // The button at the window point or -1
+    int buttonAt(const I2Point& p) const;
+    // Apply a color or line width button; return false for the
+    // buttons that the frontend handles itself (clear, quit...)
+    bool pressButton(int button);
+
+    // Strokes of the current page that intersect the world
+    // rectangle r, except the hidden ones
+    void drawPage(
+        RenderBackend& r, const R2Rectangle& world,
+        const std::vector<char>* hidden = 0
+    ) const;
+    void drawLiveStroke(RenderBackend& r) const;
+    // Only the points added since the last call. The world
+    // rectangles of the new ink, one per stroke, are appended
+    // to drawn.
+    void drawLiveInk(
+        RenderBackend& r, std::vector<I2Rectangle>* drawn = 0
+    );
+    // A tail moved after it was drawn leaves its old segment in
+    // the picture. The world rectangles of such ink since the last
+    // call, one per stroke, are appended to rects; they are to be
+    // redrawn from the strokes.
+    void takeStaleInk(std::vector<I2Rectangle>& rects);
+    void drawButtons(RenderBackend& r) const;
+    void drawCurrentLineType(RenderBackend& r) const;
+
+private:
+    DecimationStats touchStats;     // Of the finished touch strokes
+
+    void updateStroke(
+        const Action& a, Stroke& curve, StreamDecimator& decimator,
+        bool& active, int& numDrawn, Damage& stale
+    );
+    void processTouchAction(const Action& a);
+    void commitStroke(Stroke& curve);
+    static void drawStrokeTail(
+        RenderBackend& r, const Stroke& str, int& numDrawn,
+        std::vector<I2Rectangle>* drawn
+    );
+    void drawButton(
+        RenderBackend& r,
+        const I2Rectangle& rect,
+        const char* text,
+        int fgColor,
+        int bgColor
+    ) const;
+    void drawLineButton(
+        RenderBackend& r,
+        const I2Rectangle& rect,
+        int lineWidth,
+        int fgColor,
+        int bgColor
+    ) const;
+    void drawButtonFrame(RenderBackend& r, const I2Rectangle& rect) const;
+};
+
+#endif
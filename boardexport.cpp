@@ -0,0 +1,273 @@
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QPageSize>
+#include <math.h>
+#include "boardexport.h"
+#include "qtrenderer.h"
+#include "tracer.h"
+
+BoardExporter::BoardExporter():
+    QThread(),
+    snapshot(),
+    path(),
+    format(EXPORT_PDF),
+    world(),
+    viewOnly(false),
+    scale(1.),
+    ok(false),
+    numPages(0),
+    numDone(0),
+    numTotal(0),
+    lastPercent(-1),
+    area()
+{}
+
+int BoardExporter::formatOf(const QString& path) {
+    QString suffix = QFileInfo(path).suffix().toLower();
+    if (suffix == "png")
+        return EXPORT_PNG;
+    if (suffix == "svg")
+        return EXPORT_SVG;
+    if (suffix == "pdf")
+        return EXPORT_PDF;
+    return -1;
+}
+
+QString BoardExporter::pagePath(int page) const {
+    QFileInfo info(path);
+    return info.path() + "/" + info.completeBaseName() + "-" +
+        QString::number(page) + "." + info.suffix();
+}
+
+void BoardExporter::run() {
+    TraceSpan span("export");
+    std::vector<int> pages;
+    numTotal = 0;
+    for (int p = 0; p < MAX_PAGES; ++p) {
+        if (!snapshot.pages[p].empty()) {
+            pages.push_back(p);
+            numTotal += (int) snapshot.pages[p].size();
+        }
+    }
+    if (pages.empty())
+        pages.push_back(0);     // A blank page
+
+    ok = true;
+    if (format == EXPORT_PDF) {
+        ok = writePdf(pages);
+        if (ok)
+            numPages = (int) pages.size();
+        else
+            QFile::remove(path);
+        return;
+    }
+    for (unsigned int k = 0; k < pages.size() && ok; ++k) {
+        QString name = pagePath(pages[k]);
+        if (format == EXPORT_PNG) {
+            ok = writePng(pages[k], name);
+        } else {
+            FILE* f = fopen(qPrintable(name), "w");
+            if (f == 0) {
+                ok = false;
+            } else {
+                ok = writeSvg(f, snapshot.pages[pages[k]]);
+                if (fclose(f) != 0)
+                    ok = false;
+            }
+        }
+        if (ok)
+            ++numPages;
+        else
+            QFile::remove(name);
+    }
+}
+
+R2Rectangle BoardExporter::pageArea(const StrokeList& strokes) const {
+    I2Rectangle r;
+    if (viewOnly || !contentRect(strokes, r))
+        return world;
+    return R2Rectangle(r.left(), r.top(), r.width(), r.height());
+}
+
+bool BoardExporter::visible(const Stroke& str) const {
+    // As in Page::draw, area.bottom() is the minimal y
+    int w = str.margin();
+    return !(
+        str.bbox.right() + w < area.left() ||
+        str.bbox.left() - w > area.right() ||
+        str.bbox.bottom() + w < area.bottom() ||
+        str.bbox.top() - w > area.top()
+    );
+}
+
+bool BoardExporter::advance() {
+    ++numDone;
+    int percent = (int)((long long) numDone * 100 / numTotal);
+    if (percent != lastPercent) {
+        lastPercent = percent;
+        emit progress(numDone, numTotal);
+    }
+    return numDone % EXPORT_CHECK_INTERVAL != 0 || !isInterruptionRequested();
+}
+
+bool BoardExporter::drawStrokes(
+    RenderBackend& r, const StrokeList& strokes
+) {
+    for (unsigned int i = 0; i < strokes.size(); ++i) {
+        const Stroke& str = *strokes[i];
+        if (visible(str))
+            r.drawStroke(str, &area);
+        if (!advance())
+            return false;
+    }
+    return true;
+}
+
+bool BoardExporter::writePng(int page, const QString& name) {
+    area = pageArea(snapshot.pages[page]);
+    double s = scale;
+    double largest = (area.width() > area.height())?
+        area.width() : area.height();
+    if (largest*s > EXPORT_MAX_IMAGE_SIZE)
+        s = EXPORT_MAX_IMAGE_SIZE / largest;
+    QImage image(
+        (int) ceil(area.width()*s), (int) ceil(area.height()*s),
+        QImage::Format_RGB32
+    );
+    if (image.isNull())
+        return false;
+    image.fill(paletteColor(WHITE_COLOR_IDX));
+    {
+        QPainter qp(&image);
+        qp.setRenderHint(QPainter::Antialiasing);
+        qp.setTransform(QTransform(
+            s, 0.,
+            0., s,
+            -area.left()*s, -area.bottom()*s
+        ));
+        QtRenderer r(&qp, false);
+        if (!drawStrokes(r, snapshot.pages[page]))
+            return false;
+    }
+    return image.save(name, "PNG");
+}
+
+bool BoardExporter::writePdf(const std::vector<int>& pages) {
+    QPdfWriter writer(path);
+    writer.setCreator("White Board");
+    writer.setResolution(72);   // A world pixel is a point
+    writer.setPageMargins(QMarginsF(0., 0., 0., 0.));
+    QPainter qp;
+    bool written = true;
+    for (unsigned int k = 0; k < pages.size() && written; ++k) {
+        // Every page has the size of its area, set before it starts
+        area = pageArea(snapshot.pages[pages[k]]);
+        writer.setPageSize(QPageSize(
+            QSizeF(area.width(), area.height()), QPageSize::Point,
+            QString(), QPageSize::ExactMatch
+        ));
+        if (k == 0) {
+            if (!qp.begin(&writer))
+                return false;
+            qp.setRenderHint(QPainter::Antialiasing);
+        } else {
+            writer.newPage();
+        }
+        qp.setTransform(QTransform(
+            1., 0.,
+            0., 1.,
+            -area.left(), -area.bottom()
+        ));
+        QtRenderer r(&qp, false);
+        written = drawStrokes(r, snapshot.pages[pages[k]]);
+    }
+    return qp.end() && written;
+}
+
+// Outlines of pressure strokes, with fractional coordinates
+static void writeOutline(FILE* f, const QPainterPath& path) {
+    for (int i = 0; i < path.elementCount(); ++i) {
+        const QPainterPath::Element& e = path.elementAt(i);
+        if (e.isMoveTo()) {
+            fprintf(f, "\nM%.2f %.2f", e.x, e.y);
+        } else if (e.isLineTo()) {
+            fprintf(f, "L%.2f %.2f", e.x, e.y);
+        } else if (e.isCurveTo() && i + 2 < path.elementCount()) {
+            const QPainterPath::Element& c1 = path.elementAt(i + 1);
+            const QPainterPath::Element& c2 = path.elementAt(i + 2);
+            fprintf(
+                f, "C%.2f %.2f %.2f %.2f %.2f %.2f",
+                e.x, e.y, c1.x, c1.y, c2.x, c2.y
+            );
+            i += 2;
+        }
+    }
+}
+
+bool BoardExporter::writeSvg(FILE* f, const StrokeList& strokes) {
+    area = pageArea(strokes);
+    fprintf(
+        f,
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<svg xmlns=\"http://www.w3.org/2000/svg\""
+        " width=\"%g\" height=\"%g\" viewBox=\"%g %g %g %g\">\n"
+        "<rect x=\"%g\" y=\"%g\" width=\"%g\" height=\"%g\""
+        " fill=\"#%06x\"/>\n",
+        area.width(), area.height(),
+        area.left(), area.bottom(), area.width(), area.height(),
+        area.left(), area.bottom(), area.width(), area.height(),
+        paletteRgb[WHITE_COLOR_IDX]
+    );
+    for (unsigned int i = 0; i < strokes.size(); ++i) {
+        const Stroke& str = *strokes[i];
+        if (str.size() > 0 && visible(str)) {
+            unsigned int rgb = paletteRgb[str.color % NUM_COLORS];
+            if (str.hasPressure()) {
+                // The outline that QtRenderer fills
+                QPainterPath outline;
+                appendOutline(
+                    outline, &(str.points[0]), &(str.pressures[0]),
+                    strokeFractions(str), 0, str.size(), true, str
+                );
+                fprintf(f, "<path fill=\"#%06x\" d=\"", rgb);
+                writeOutline(f, outline);
+            } else {
+                // The pen of QtRenderer: square caps, bevel joins
+                fprintf(
+                    f,
+                    "<path fill=\"none\" stroke=\"#%06x\" stroke-width=\"%d\""
+                    " stroke-linecap=\"square\" stroke-linejoin=\"bevel\""
+                    " d=\"",
+                    rgb, str.width
+                );
+                // Whole pixels print as integers, sub-pixel points
+                // exactly
+                R2Point p = str.exactPoint(0);
+                if (str.size() == 1) {
+                    // A small cross, as drawn on the screen
+                    fprintf(
+                        f, "M%.10g %.10gH%.10gM%.10g %.10gV%.10g",
+                        p.x - 1, p.y, p.x + 1, p.x, p.y - 1, p.y + 1
+                    );
+                } else {
+                    fprintf(f, "M%.10g %.10gL", p.x, p.y);
+                    for (int k = 1; k < str.size(); ++k) {
+                        p = str.exactPoint(k);
+                        fprintf(
+                            f, (k % 16 == 0)? "\n%.10g %.10g" : " %.10g %.10g",
+                            p.x, p.y
+                        );
+                    }
+                }
+            }
+            fprintf(f, "\"/>\n");
+        }
+        if (!advance())
+            return false;
+    }
+    fprintf(f, "</svg>\n");
+    return !ferror(f);
+}
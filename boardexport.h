@@ -0,0 +1,83 @@
+//
+// Export of the board to PNG images, SVG files or a multi-page
+// PDF on a thread of its own, so that the lecture goes on while a
+// large board is written. The exporter works on a BoardSnapshot,
+// which shares the committed strokes with the board, and never
+// touches the path caches of the GUI thread. SVG path data is
+// written stroke by stroke from the point arrays, without a
+// document tree: memory does not grow with the page.
+//
+#ifndef BOARDEXPORT_H
+#define BOARDEXPORT_H
+
+#include <QThread>
+#include <QString>
+#include <stdio.h>
+#include <vector>
+#include "board.h"
+
+enum ExportFormat {
+    EXPORT_PNG,
+    EXPORT_SVG,
+    EXPORT_PDF
+};
+
+// Strokes between checks for a stop request
+const int EXPORT_CHECK_INTERVAL = 256;
+// Larger PNG pages are scaled down to this width or height
+const int EXPORT_MAX_IMAGE_SIZE = 16384;
+
+class BoardExporter: public QThread {
+    Q_OBJECT
+
+public:
+    BoardSnapshot snapshot;     // Fill before start()
+    // The PDF file; the page number is inserted before the
+    // extension of the PNG and SVG files, e.g. board-0.svg
+    QString path;
+    int format;
+    // Every page covers its strokes with a margin, wherever they
+    // are on the canvas; with viewOnly, it is cropped to world
+    // instead. A blank page is world.
+    R2Rectangle world;
+    bool viewOnly;
+    double scale;               // Image pixels per world pixel (PNG)
+
+    // Results, read after the thread has finished
+    bool ok;
+    int numPages;               // Written
+
+    BoardExporter();
+
+    // From the extension of the path; -1 if it is not exported
+    static int formatOf(const QString& path);
+    QString pagePath(int page) const;
+
+    // Write the page as SVG; return false on a write error or a
+    // stop request
+    bool writeSvg(FILE* f, const StrokeList& strokes);
+
+signals:
+    // Strokes written so far, at most once per percent
+    void progress(int done, int total);
+
+protected:
+    void run();
+
+private:
+    int numDone;
+    int numTotal;
+    int lastPercent;
+    R2Rectangle area;           // Of the page being written
+
+    R2Rectangle pageArea(const StrokeList& strokes) const;
+    bool visible(const Stroke& str) const;
+    bool advance();             // Count a stroke; false to stop
+    bool drawStrokes(
+        RenderBackend& r, const StrokeList& strokes
+    );
+    bool writePng(int page, const QString& name);
+    bool writePdf(const std::vector<int>& pages);
+};
+
+#endif
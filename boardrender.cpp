@@ -0,0 +1,333 @@
+//
+// Headless batch renderer of saved boards, e.g. for nightly PNG
+// exports of the board archive. Every non-empty page of every board
+// is drawn by QtRenderer, as in the widget, into a QImage and
+// written as a PNG. A pool of threads, one per core by default,
+// loads the boards and renders their pages; pages are taken before
+// new boards, at most one board per thread is in memory and every
+// thread reuses its image, so memory stays bounded however many
+// boards are given. No display is needed.
+// Run as:
+//   boardrender [-o outDir] [-r widthxheight] [-s scale] [-j threads]
+//               [-q pngQuality] board...
+// Boards are in the actionio text format. Page n of dir/name.ext is
+// written to outDir/name-n.png; the image covers the strokes of the
+// page with a margin, wherever they are on the infinite canvas. It
+// is scaled by scale, or with -r fitted into an image of that size.
+//
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImage>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPainter>
+#include <QThread>
+#include <QWaitCondition>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <deque>
+#include <vector>
+#include "board.h"
+#include "qtrenderer.h"
+#include "actionio.h"
+#include "allocstats.h"
+
+// Larger pages are scaled down to this width or height
+static const int MAX_IMAGE_SIZE = 16384;
+
+class LoadedBoard {
+public:
+    Board board;
+    int file;                   // Index in BatchRenderer::files
+    int numPending;             // Pages not rendered yet
+
+    LoadedBoard(int f):
+        board(),
+        file(f),
+        numPending(0)
+    {}
+};
+
+class PageJob {
+public:
+    LoadedBoard* board;
+    int page;
+};
+
+class BatchRenderer {
+public:
+    std::vector<const char*> files;
+    QString outDir;
+    int outWidth, outHeight;    // Of the images, or 0 for scale
+    double scale;
+    int pngQuality;             // -1 for the default compression
+    int maxBoards;              // In memory at the same time
+
+    // Results, under mutex
+    int numPages;
+    int numErrors;
+    double loadTime, renderTime, writeTime;     // Summed over threads
+
+    BatchRenderer():
+        files(),
+        outDir("."),
+        outWidth(0),
+        outHeight(0),
+        scale(1.),
+        pngQuality(-1),
+        maxBoards(1),
+        numPages(0),
+        numErrors(0),
+        loadTime(0.),
+        renderTime(0.),
+        writeTime(0.),
+        mutex(),
+        changed(),
+        nextFile(0),
+        numBoards(0),
+        pages()
+    {}
+
+    // The loop of a thread, until all boards are done
+    void work();
+
+private:
+    QMutex mutex;
+    QWaitCondition changed;
+    int nextFile;
+    int numBoards;              // Loaded or being loaded
+    std::deque<PageJob> pages;  // To be rendered
+
+    LoadedBoard* load(int file);
+    bool renderPage(const PageJob& job, QImage& image);
+};
+
+class RenderThread: public QThread {
+public:
+    BatchRenderer* renderer;
+
+    RenderThread(BatchRenderer* r):
+        QThread(),
+        renderer(r)
+    {}
+
+protected:
+    void run() {
+        renderer->work();
+    }
+};
+
+void BatchRenderer::work() {
+    QImage image;   // Reallocated only when the size changes
+    QMutexLocker lock(&mutex);
+    while (true) {
+        if (!pages.empty()) {
+            PageJob job = pages.front();
+            pages.pop_front();
+            lock.unlock();
+            bool ok = renderPage(job, image);
+            lock.relock();
+            if (ok)
+                ++numPages;
+            else
+                ++numErrors;
+            if (--job.board->numPending == 0) {
+                // Freed outside the lock: a board may have
+                // millions of points
+                lock.unlock();
+                delete job.board;
+                lock.relock();
+                --numBoards;
+                changed.wakeAll();
+            }
+        } else if (
+            nextFile < (int) files.size() && numBoards < maxBoards
+        ) {
+            int f = nextFile++;
+            ++numBoards;
+            lock.unlock();
+            QElapsedTimer timer;
+            timer.start();
+            LoadedBoard* b = load(f);
+            double t = timer.nsecsElapsed() * 1e-9;
+            lock.relock();
+            loadTime += t;
+            if (b == 0 || b->numPending == 0) {
+                if (b == 0)
+                    ++numErrors;
+                lock.unlock();
+                delete b;
+                lock.relock();
+                --numBoards;
+            } else {
+                for (int p = 0; p < MAX_PAGES; ++p) {
+                    if (!b->board.pages[p].strokes.empty()) {
+                        PageJob job;
+                        job.board = b;
+                        job.page = p;
+                        pages.push_back(job);
+                    }
+                }
+            }
+            changed.wakeAll();
+        } else if (nextFile >= (int) files.size() && numBoards == 0) {
+            return;
+        } else {
+            changed.wait(&mutex);
+        }
+    }
+}
+
+LoadedBoard* BatchRenderer::load(int file) {
+    const char* path = files[file];
+    FILE* f = fopen(path, "r");
+    if (f == 0) {
+        perror(path);
+        return 0;
+    }
+    LoadedBoard* b = new LoadedBoard(file);
+    bool ok = loadBoard(f, path, b->board);
+    fclose(f);
+    if (!ok) {
+        delete b;
+        return 0;
+    }
+    for (int p = 0; p < MAX_PAGES; ++p) {
+        if (!b->board.pages[p].strokes.empty())
+            ++(b->numPending);
+    }
+    return b;
+}
+
+bool BatchRenderer::renderPage(const PageJob& job, QImage& image) {
+    QElapsedTimer timer;
+    timer.start();
+    const Page& page = job.board->board.pages[job.page];
+    I2Rectangle content;
+    page.contentRect(content);
+    double s = scale;
+    int width, height;
+    if (outWidth > 0) {
+        // Fitted and centered
+        width = outWidth;
+        height = outHeight;
+        s = (double) width / (double) content.width();
+        if ((double) height / (double) content.height() < s)
+            s = (double) height / (double) content.height();
+    } else {
+        double largest = content.width();
+        if (content.height() > largest)
+            largest = content.height();
+        if (largest * s > MAX_IMAGE_SIZE) {
+            s = MAX_IMAGE_SIZE / largest;
+            fprintf(
+                stderr, "%s, page %d: scaled by %g to fit %d pixels\n",
+                files[job.board->file], job.page, s, MAX_IMAGE_SIZE
+            );
+        }
+        width = (int) ceil(content.width() * s);
+        height = (int) ceil(content.height() * s);
+    }
+    if (image.width() != width || image.height() != height)
+        image = QImage(width, height, QImage::Format_RGB32);
+    image.fill(paletteColor(WHITE_COLOR_IDX));
+    {
+        QPainter qp(&image);
+        qp.setRenderHint(QPainter::Antialiasing);
+        double dx = (width - content.width() * s) / 2.;
+        double dy = (height - content.height() * s) / 2.;
+        qp.setTransform(QTransform(
+            s, 0., 0., s,
+            dx - content.left() * s, dy - content.top() * s
+        ));
+        QtRenderer r(&qp);
+        page.draw(r, R2Rectangle(
+            content.left(), content.top(), content.width(), content.height()
+        ));
+    }
+    double t = timer.nsecsElapsed() * 1e-9;
+
+    timer.restart();
+    const char* path = files[job.board->file];
+    QString name = outDir + "/" + QFileInfo(path).completeBaseName() +
+        "-" + QString::number(job.page) + ".png";
+    bool ok = image.save(name, "PNG", pngQuality);
+    if (!ok)
+        fprintf(stderr, "%s: cannot write\n", qPrintable(name));
+    double w = timer.nsecsElapsed() * 1e-9;
+
+    QMutexLocker lock(&mutex);
+    renderTime += t;
+    writeTime += w;
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    BatchRenderer renderer;
+    int numThreads = QThread::idealThreadCount();
+    for (int i = 1; i < argc; ++i) {
+        if (i + 1 < argc && strcmp(argv[i], "-o") == 0) {
+            renderer.outDir = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-r") == 0) {
+            if (sscanf(
+                argv[++i], "%dx%d",
+                &renderer.outWidth, &renderer.outHeight
+            ) != 2 || renderer.outWidth <= 0 || renderer.outHeight <= 0) {
+                fprintf(stderr, "-r: widthxheight expected\n");
+                return 1;
+            }
+        } else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+            renderer.scale = atof(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-j") == 0) {
+            numThreads = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-q") == 0) {
+            renderer.pngQuality = atoi(argv[++i]);
+        } else {
+            renderer.files.push_back(argv[i]);
+        }
+    }
+    if (
+        renderer.files.empty() || renderer.scale <= 0.
+    ) {
+        fprintf(
+            stderr,
+            "Usage: boardrender [-o outDir] [-r widthxheight] [-s scale]"
+            " [-j threads] [-q pngQuality] board...\n"
+        );
+        return 1;
+    }
+    if (numThreads < 1)
+        numThreads = 1;
+    renderer.maxBoards = numThreads;
+    // Strokes and paths are built on all threads
+    allocCounting = false;
+
+    QElapsedTimer timer;
+    timer.start();
+    std::vector<RenderThread*> threads;
+    for (int i = 0; i < numThreads; ++i) {
+        threads.push_back(new RenderThread(&renderer));
+        threads.back()->start();
+    }
+    for (unsigned int i = 0; i < threads.size(); ++i) {
+        threads[i]->wait();
+        delete threads[i];
+    }
+    double total = timer.nsecsElapsed() * 1e-9;
+
+    printf(
+        "%d boards, %d pages, %d errors in %.2f s with %d threads:"
+        " %.1f pages/s\n",
+        (int) renderer.files.size(), renderer.numPages, renderer.numErrors,
+        total, numThreads, renderer.numPages / total
+    );
+    printf(
+        "thread time: load %.2f s, render %.2f s, write %.2f s\n",
+        renderer.loadTime, renderer.renderTime, renderer.writeTime
+    );
+    return (renderer.numErrors == 0)? 0 : 1;
+}
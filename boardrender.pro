@@ -0,0 +1,13 @@
+TEMPLATE = app
+TARGET = boardrender
+INCLUDEPATH += .
+
+CONFIG += console
+CONFIG -= app_bundle
+QT += core gui
+
+# Headless: QImage and QPainter only, no widgets or display
+HEADERS += board.h R2Graph.h strokegrid.h polyline.h allocstats.h \
+    renderbackend.h qtrenderer.h actionio.h tracer.h latency.h
+SOURCES += boardrender.cpp board.cpp R2Graph.cpp strokegrid.cpp polyline.cpp \
+    allocstats.cpp qtrenderer.cpp actionio.cpp tracer.cpp latency.cpp
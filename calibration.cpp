@@ -0,0 +1,676 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "calibration.h"
+#include "board.h"
+
+// Target positions as fractions of the window: corners, center,
+// then the middles of the sides
+static const double targetU[MAX_CALIBRATION_POINTS] = {
+    0., 1., 1., 0., 0.5, 0.5, 1., 0.5, 0.
+};
+static const double targetV[MAX_CALIBRATION_POINTS] = {
+    0., 0., 1., 1., 0.5, 0., 0.5, 1., 0.5
+};
+
+Calibration::Calibration(int n /* = DEFAULT_CALIBRATION_POINTS */):
+    numPoints(DEFAULT_CALIBRATION_POINTS),
+    numClicks(0),
+    gridCols(0),
+    gridRows(0),
+    windowWidth(640),
+    windowHeight(480),
+    distortion(),
+    affine(true),
+    rmsError(0.),
+    maxError(0.)
+{
+    const double identity[9] = { 1., 0., 0., 0., 1., 0., 0., 0., 1. };
+    setTransform(identity);
+    start(640, 480, n);
+}
+
+bool Calibration::configure(const char* spec) {
+    if (spec == 0 || *spec == 0)
+        return false;
+    int cols, rows;
+    if (strcmp(spec, "grid") == 0) {
+        startGrid(
+            windowWidth, windowHeight, DEFAULT_GRID_COLS, DEFAULT_GRID_ROWS
+        );
+        return true;
+    }
+    if (sscanf(spec, "%dx%d", &cols, &rows) == 2) {
+        startGrid(windowWidth, windowHeight, cols, rows);
+        return true;
+    }
+    int n = atoi(spec);
+    if (n <= 0)
+        return false;
+    start(windowWidth, windowHeight, n);
+    return true;
+}
+
+void Calibration::start(int w, int h, int n /* = 0 */) {
+    if (n > 0) {
+        if (n < MIN_CALIBRATION_POINTS)
+            n = MIN_CALIBRATION_POINTS;
+        if (n > MAX_CALIBRATION_POINTS)
+            n = MAX_CALIBRATION_POINTS;
+        numPoints = n;
+        gridCols = 0;
+        gridRows = 0;
+    }
+    if (gridCols > 0) {
+        startGrid(w, h, gridCols, gridRows);
+        return;
+    }
+    numClicks = 0;
+    windowWidth = w;
+    windowHeight = h;
+
+    double x0 = w * CALIBRATION_MARGIN;
+    double y0 = h * CALIBRATION_MARGIN;
+    double dx = w * (1. - 2.*CALIBRATION_MARGIN);
+    double dy = h * (1. - 2.*CALIBRATION_MARGIN);
+    for (int i = 0; i < numPoints; ++i) {
+        // Two points: opposite corners
+        int k = (numPoints == 2 && i == 1)? 2 : i;
+        points[i] = I2Point(
+            (int)(x0 + dx*targetU[k] + 0.5),
+            (int)(y0 + dy*targetV[k] + 0.5)
+        );
+    }
+}
+
+void Calibration::startGrid(int w, int h, int cols, int rows) {
+    if (cols < MIN_GRID_SIZE)
+        cols = MIN_GRID_SIZE;
+    if (cols > MAX_GRID_SIZE)
+        cols = MAX_GRID_SIZE;
+    if (rows < MIN_GRID_SIZE)
+        rows = MIN_GRID_SIZE;
+    if (rows > MAX_GRID_SIZE)
+        rows = MAX_GRID_SIZE;
+    gridCols = cols;
+    gridRows = rows;
+    numPoints = cols*rows;
+    numClicks = 0;
+    windowWidth = w;
+    windowHeight = h;
+
+    double x0 = w * CALIBRATION_MARGIN;
+    double y0 = h * CALIBRATION_MARGIN;
+    double dx = w * (1. - 2.*CALIBRATION_MARGIN) / (cols - 1);
+    double dy = h * (1. - 2.*CALIBRATION_MARGIN) / (rows - 1);
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) {
+            points[r*cols + c] = I2Point(
+                (int)(x0 + dx*c + 0.5),
+                (int)(y0 + dy*r + 0.5)
+            );
+        }
+    }
+}
+
+void Calibration::setTransform(const double* h) {
+    for (int i = 0; i < 9; ++i) {
+        transform[i] = h[i] / h[8];
+        fixed[i] = (long long) floor(
+            ldexp(transform[i], CALIBRATION_FIXED_SHIFT) + 0.5
+        );
+    }
+    affine = (transform[6] == 0. && transform[7] == 0.);
+}
+
+bool Calibration::addClick(const I2Point& t) {
+    if (numClicks >= numPoints)
+        numClicks = 0;
+    clicks[numClicks] = t;
+    ++numClicks;
+    if (numClicks < numPoints)
+        return false;
+
+    bool ok;
+    if (numPoints == 2)
+        ok = fitScale();
+    else
+        ok = fitLeastSquares(numPoints >= 4);
+    if (!ok) {
+        // Degenerate: start again
+        numClicks = 0;
+        return false;
+    }
+    if (gridCols > 0)
+        fitDistortion();
+    else
+        distortion.clear();
+    computeErrors();
+    return true;
+}
+
+void Calibration::computeErrors() {
+    rmsError = 0.;
+    maxError = 0.;
+    for (int i = 0; i < numPoints; ++i) {
+        R2Point p = mapExact(R2Point(clicks[i].x, clicks[i].y));
+        double e = p.distance(R2Point(points[i].x, points[i].y));
+        rmsError += e*e;
+        if (e > maxError)
+            maxError = e;
+    }
+    rmsError = sqrt(rmsError / numPoints);
+}
+
+// The nodes are where startGrid() placed the targets, before rounding
+void Calibration::setDistortionGrid() {
+    distortion.setGrid(
+        gridCols, gridRows,
+        windowWidth * CALIBRATION_MARGIN,
+        windowHeight * CALIBRATION_MARGIN,
+        windowWidth * (1. - 2.*CALIBRATION_MARGIN) / (gridCols - 1),
+        windowHeight * (1. - 2.*CALIBRATION_MARGIN) / (gridRows - 1)
+    );
+}
+
+// The offsets must move the homography of every click onto its
+// target; the homography does not land on the nodes exactly, so
+// the interpolated offsets are refined there a few times
+void Calibration::fitDistortion() {
+    setDistortionGrid();
+    R2Point base[MAX_CALIBRATION_TARGETS];
+    for (int i = 0; i < numPoints; ++i) {
+        base[i] = mapBase(R2Point(clicks[i].x, clicks[i].y));
+        distortion.offsets[i] =
+            R2Point(points[i].x, points[i].y) - base[i];
+    }
+    for (int k = 0; k < DISTORTION_ITERATIONS; ++k) {
+        R2Vector residual[MAX_CALIBRATION_TARGETS];
+        for (int i = 0; i < numPoints; ++i) {
+            residual[i] =
+                R2Point(points[i].x, points[i].y) -
+                (base[i] + distortion.interpolate(base[i]));
+        }
+        for (int i = 0; i < numPoints; ++i)
+            distortion.offsets[i] += residual[i];
+    }
+    distortion.build(windowWidth, windowHeight);
+}
+
+// Scale and offset per axis
+bool Calibration::fitScale() {
+    if (clicks[1].x == clicks[0].x || clicks[1].y == clicks[0].y)
+        return false;
+    double sx =
+        (double)(points[1].x - points[0].x) /
+        (double)(clicks[1].x - clicks[0].x);
+    double sy =
+        (double)(points[1].y - points[0].y) /
+        (double)(clicks[1].y - clicks[0].y);
+    // wx = wx0 + (cx - cx0)*sx =
+    //      (wx0 - cx0*sx) + cx*sx;
+    double h[9] = {
+        sx, 0., points[0].x - clicks[0].x * sx,
+        0., sy, points[0].y - clicks[0].y * sy,
+        0., 0., 1.
+    };
+    setTransform(h);
+    return true;
+}
+
+// Gaussian elimination with partial pivoting; a is n x n by rows,
+// the solution replaces b
+static bool solveLinear(double* a, double* b, int n) {
+    for (int c = 0; c < n; ++c) {
+        int pivot = c;
+        for (int r = c + 1; r < n; ++r) {
+            if (fabs(a[r*n + c]) > fabs(a[pivot*n + c]))
+                pivot = r;
+        }
+        if (fabs(a[pivot*n + c]) < 1e-12)
+            return false;
+        if (pivot != c) {
+            for (int k = 0; k < n; ++k) {
+                double t = a[c*n + k];
+                a[c*n + k] = a[pivot*n + k];
+                a[pivot*n + k] = t;
+            }
+            double t = b[c]; b[c] = b[pivot]; b[pivot] = t;
+        }
+        for (int r = c + 1; r < n; ++r) {
+            double f = a[r*n + c] / a[c*n + c];
+            for (int k = c; k < n; ++k)
+                a[r*n + k] -= f * a[c*n + k];
+            b[r] -= f * b[c];
+        }
+    }
+    for (int r = n - 1; r >= 0; --r) {
+        double s = b[r];
+        for (int k = r + 1; k < n; ++k)
+            s -= a[r*n + k] * b[k];
+        b[r] = s / a[r*n + r];
+    }
+    return true;
+}
+
+static void multiply(const double* a, const double* b, double* res) {
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            res[i*3 + j] =
+                a[i*3]*b[j] + a[i*3 + 1]*b[3 + j] + a[i*3 + 2]*b[6 + j];
+        }
+    }
+}
+
+// Move the centroid to the origin and scale the mean distance to
+// sqrt(2), for a well-conditioned system
+static void normalization(
+    const I2Point* p, int n, double& cx, double& cy, double& s
+) {
+    cx = 0.; cy = 0.;
+    for (int i = 0; i < n; ++i) {
+        cx += p[i].x;
+        cy += p[i].y;
+    }
+    cx /= n; cy /= n;
+    double d = 0.;
+    for (int i = 0; i < n; ++i)
+        d += sqrt((p[i].x - cx)*(p[i].x - cx) + (p[i].y - cy)*(p[i].y - cy));
+    d /= n;
+    s = (d > 0.)? sqrt(2.) / d : 1.;
+}
+
+// Minimize the algebraic error of
+//     X = (a x + b y + c) / (g x + h y + 1)
+//     Y = (d x + e y + f) / (g x + h y + 1)
+// with g = h = 0 for an affine transform
+bool Calibration::fitLeastSquares(bool projective) {
+    int m = projective? 8 : 6;
+    double mx, my, ms, wx, wy, ws;
+    normalization(clicks, numPoints, mx, my, ms);
+    normalization(points, numPoints, wx, wy, ws);
+
+    double ata[64], atb[8];
+    for (int i = 0; i < m*m; ++i)
+        ata[i] = 0.;
+    for (int i = 0; i < m; ++i)
+        atb[i] = 0.;
+    for (int i = 0; i < numPoints; ++i) {
+        double x = (clicks[i].x - mx) * ms;
+        double y = (clicks[i].y - my) * ms;
+        double X = (points[i].x - wx) * ws;
+        double Y = (points[i].y - wy) * ws;
+        double rows[2][8] = {
+            { x, y, 1., 0., 0., 0., -x*X, -y*X },
+            { 0., 0., 0., x, y, 1., -x*Y, -y*Y }
+        };
+        double rhs[2] = { X, Y };
+        for (int r = 0; r < 2; ++r) {
+            for (int j = 0; j < m; ++j) {
+                for (int k = 0; k < m; ++k)
+                    ata[j*m + k] += rows[r][j] * rows[r][k];
+                atb[j] += rows[r][j] * rhs[r];
+            }
+        }
+    }
+    if (!solveLinear(ata, atb, m))
+        return false;
+
+    double hn[9] = {
+        atb[0], atb[1], atb[2],
+        atb[3], atb[4], atb[5],
+        projective? atb[6] : 0., projective? atb[7] : 0., 1.
+    };
+    // H = Tw^-1 * Hn * Tm
+    double tm[9] = { ms, 0., -ms*mx, 0., ms, -ms*my, 0., 0., 1. };
+    double twInv[9] = { 1./ws, 0., wx, 0., 1./ws, wy, 0., 0., 1. };
+    double t[9], h[9];
+    multiply(hn, tm, t);
+    multiply(twInv, t, h);
+    if (fabs(h[8]) < 1e-12)
+        return false;
+
+    // All the clicks must be on the same side of the horizon
+    for (int i = 0; i < numPoints; ++i) {
+        double w = h[6]*clicks[i].x + h[7]*clicks[i].y + h[8];
+        if (w * h[8] <= 0.)
+            return false;
+    }
+    setTransform(h);
+    return true;
+}
+
+R2Point Calibration::mapExact(const R2Point& p) const {
+    R2Point w = mapBase(p);
+    if (distortion.empty())
+        return w;
+    return w + distortion.correction(w);
+}
+
+R2Point Calibration::mapBase(const R2Point& p) const {
+    const double* h = transform;
+    double w = h[6]*p.x + h[7]*p.y + h[8];
+    return R2Point(
+        (h[0]*p.x + h[1]*p.y + h[2]) / w,
+        (h[3]*p.x + h[4]*p.y + h[5]) / w
+    );
+}
+
+// n / d rounded to the nearest integer, d > 0
+static inline long long roundedQuotient(long long n, long long d) {
+    if (n >= 0)
+        return (n + d/2) / d;
+    return -((-n + d/2) / d);
+}
+
+void Calibration::map(const I2Point& mousePoint, I2Point& windowPoint) const {
+    mapPoints(&mousePoint, &windowPoint, 1);
+}
+
+// Window coordinates come with DISTORTION_FRACTION_BITS fraction
+// bits, so that the distortion table sees the sub-pixel position
+void Calibration::mapPoints(const I2Point* in, I2Point* out, int n) const {
+    const long long* f = fixed;
+    const int shift = CALIBRATION_FIXED_SHIFT - DISTORTION_FRACTION_BITS;
+    const long long half = 1LL << (shift - 1);
+    const long long pixelHalf = 1LL << (DISTORTION_FRACTION_BITS - 1);
+    bool correct = !distortion.empty();
+    for (int i = 0; i < n; ++i) {
+        long long x = in[i].x, y = in[i].y;
+        long long wx, wy;
+        if (affine) {
+            // Arithmetic shift: rounds to the nearest, ties up
+            wx = (f[0]*x + f[1]*y + f[2] + half) >> shift;
+            wy = (f[3]*x + f[4]*y + f[5] + half) >> shift;
+        } else {
+            long long w = f[6]*x + f[7]*y + f[8];
+            if (w <= 0)
+                w = 1;      // Beyond the horizon: no sensible point
+            wx = roundedQuotient(
+                (f[0]*x + f[1]*y + f[2]) << DISTORTION_FRACTION_BITS, w
+            );
+            wy = roundedQuotient(
+                (f[3]*x + f[4]*y + f[5]) << DISTORTION_FRACTION_BITS, w
+            );
+        }
+        if (correct)
+            distortion.correct(wx, wy);
+        out[i].x = (int)((wx + pixelHalf) >> DISTORTION_FRACTION_BITS);
+        out[i].y = (int)((wy + pixelHalf) >> DISTORTION_FRACTION_BITS);
+    }
+}
+
+void Calibration::draw(RenderBackend& r) const {
+    if (numClicks >= numPoints)
+        return;
+    I2Vector dx(16, 0);
+    I2Vector dy(0, 16);
+    I2Point t = points[numClicks];
+    char text[64];
+    snprintf(
+        text, sizeof(text), "Click in cross (%d of %d):",
+        numClicks + 1, numPoints
+    );
+    r.drawText(t - dy*2 - dx*2, text, RED_COLOR_IDX);
+    r.drawLine(t - dx, t + dx, 3, BLUE_COLOR_IDX);
+    r.drawLine(t - dy, t + dy, 3, BLUE_COLOR_IDX);
+}
+
+void Calibration::report(FILE* f) const {
+    const char* model = "scale";
+    if (numPoints >= 4)
+        model = "projective";
+    else if (numPoints == 3)
+        model = "affine";
+    char grid[32] = "";
+    if (!distortion.empty()) {
+        snprintf(
+            grid, sizeof(grid), " + %dx%d distortion grid",
+            distortion.cols, distortion.rows
+        );
+    }
+    fprintf(
+        f, "Calibration: %d points, %s%s, error RMS %.2f px, max %.2f px\n",
+        numPoints, model, grid, rmsError, maxError
+    );
+}
+
+// Text: a header line, the window, the targets and clicks, the
+// transform and the solved distortion offsets
+bool Calibration::save(const char* path) const {
+    if (path == 0 || *path == 0 || numClicks < numPoints)
+        return false;
+    // Written next to the old file and renamed over it
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* f = fopen(tmp, "w");
+    if (f == 0)
+        return false;
+    fprintf(f, "whiteboard-calibration 1\n");
+    fprintf(f, "window %d %d\n", windowWidth, windowHeight);
+    fprintf(f, "points %d grid %d %d\n", numPoints, gridCols, gridRows);
+    for (int i = 0; i < numPoints; ++i) {
+        fprintf(
+            f, "%d %d %d %d\n",
+            points[i].x, points[i].y, clicks[i].x, clicks[i].y
+        );
+    }
+    fprintf(f, "transform");
+    for (int i = 0; i < 9; ++i)
+        fprintf(f, " %.17g", transform[i]);
+    fprintf(f, "\n");
+    for (unsigned int i = 0; i < distortion.offsets.size(); ++i) {
+        fprintf(
+            f, "%.17g %.17g\n",
+            distortion.offsets[i].x, distortion.offsets[i].y
+        );
+    }
+    bool ok = (ferror(f) == 0);
+    if (fclose(f) != 0)
+        ok = false;
+    if (!ok || rename(tmp, path) != 0) {
+        remove(tmp);
+        return false;
+    }
+    return true;
+}
+
+bool Calibration::load(const char* path) {
+    if (path == 0 || *path == 0)
+        return false;
+    FILE* f = fopen(path, "r");
+    if (f == 0)
+        return false;
+    int version = 0, w, h, n, cols, rows;
+    bool ok =
+        fscanf(f, "whiteboard-calibration %d", &version) == 1 &&
+        version == 1 &&
+        fscanf(f, " window %d %d", &w, &h) == 2 &&
+        fscanf(f, " points %d grid %d %d", &n, &cols, &rows) == 3 &&
+        w > 0 && h > 0;
+    if (ok) {
+        if (cols > 0)
+            ok = cols >= MIN_GRID_SIZE && cols <= MAX_GRID_SIZE &&
+                rows >= MIN_GRID_SIZE && rows <= MAX_GRID_SIZE &&
+                n == cols*rows;
+        else
+            ok = n >= MIN_CALIBRATION_POINTS && n <= MAX_CALIBRATION_POINTS;
+    }
+    I2Point t[MAX_CALIBRATION_TARGETS], c[MAX_CALIBRATION_TARGETS];
+    for (int i = 0; ok && i < n; ++i) {
+        ok = fscanf(
+            f, "%d %d %d %d", &t[i].x, &t[i].y, &c[i].x, &c[i].y
+        ) == 4;
+    }
+    double hm[9];
+    char word[16];
+    ok = ok &&
+        fscanf(f, "%15s", word) == 1 && strcmp(word, "transform") == 0;
+    for (int i = 0; ok && i < 9; ++i)
+        ok = fscanf(f, "%lf", &hm[i]) == 1;
+    ok = ok && hm[8] != 0.;
+    std::vector<R2Vector> offsets(cols > 0? n : 0);
+    for (unsigned int i = 0; ok && i < offsets.size(); ++i)
+        ok = fscanf(f, "%lf %lf", &offsets[i].x, &offsets[i].y) == 2;
+    fclose(f);
+    if (!ok)
+        return false;
+
+    if (cols > 0)
+        startGrid(w, h, cols, rows);
+    else
+        start(w, h, n);
+    for (int i = 0; i < n; ++i) {
+        points[i] = t[i];
+        clicks[i] = c[i];
+    }
+    numClicks = n;
+    setTransform(hm);
+    if (cols > 0) {
+        setDistortionGrid();
+        distortion.offsets = offsets;
+        distortion.build(w, h);
+    } else {
+        distortion.clear();
+    }
+    computeErrors();
+    return true;
+}
+
+const char* Calibration::cachePath() {
+    static char path[1024];
+    const char* env = getenv("WHITEBOARD_CALIBRATION_FILE");
+    if (env != 0)
+        return env;     // Empty: no cache
+    const char* home = getenv("HOME");
+    if (home == 0 || *home == 0)
+        return "";
+    snprintf(path, sizeof(path), "%s/.whiteboard-calibration", home);
+    return path;
+}
+
+DistortionGrid::DistortionGrid():
+    cols(0),
+    rows(0),
+    x0(0.),
+    y0(0.),
+    stepX(1.),
+    stepY(1.),
+    offsets(),
+    width(0),
+    height(0),
+    tableCols(0),
+    tableRows(0),
+    table()
+{}
+
+void DistortionGrid::clear() {
+    cols = 0;
+    rows = 0;
+    offsets.clear();
+    table.clear();
+    tableCols = 0;
+    tableRows = 0;
+}
+
+void DistortionGrid::setGrid(
+    int c, int r, double left, double top, double dx, double dy
+) {
+    cols = c;
+    rows = r;
+    x0 = left;
+    y0 = top;
+    stepX = dx;
+    stepY = dy;
+    offsets.assign(c*r, R2Vector(0., 0.));
+}
+
+// Weights of the nodes -1, 0, 1, 2 at t in [0, 1]
+static void catmullRom(double t, double* w) {
+    double t2 = t*t, t3 = t2*t;
+    w[0] = 0.5*(-t3 + 2.*t2 - t);
+    w[1] = 0.5*(3.*t3 - 5.*t2 + 2.);
+    w[2] = 0.5*(-3.*t3 + 4.*t2 + t);
+    w[3] = 0.5*(t3 - t2);
+}
+
+// Node index and position in the cell; beyond the grid the
+// offsets of its edge are kept
+static int gridCell(double u, int n, double& t) {
+    if (u < 0.)
+        u = 0.;
+    if (u > n - 1)
+        u = n - 1;
+    int i = (int) u;
+    if (i > n - 2)
+        i = n - 2;
+    t = u - i;
+    return i;
+}
+
+// Offset at a node; the nodes just outside the grid are
+// extrapolated linearly from its edge
+R2Vector DistortionGrid::node(int i, int j) const {
+    if (i < 0)
+        return node(0, j)*2. - node(1, j);
+    if (i >= cols)
+        return node(cols - 1, j)*2. - node(cols - 2, j);
+    if (j < 0)
+        return node(i, 0)*2. - node(i, 1);
+    if (j >= rows)
+        return node(i, rows - 1)*2. - node(i, rows - 2);
+    return offsets[j*cols + i];
+}
+
+R2Vector DistortionGrid::interpolate(const R2Point& p) const {
+    double tx, ty, wx[4], wy[4];
+    int i = gridCell((p.x - x0) / stepX, cols, tx);
+    int j = gridCell((p.y - y0) / stepY, rows, ty);
+    catmullRom(tx, wx);
+    catmullRom(ty, wy);
+    R2Vector v(0., 0.);
+    for (int b = 0; b < 4; ++b) {
+        for (int a = 0; a < 4; ++a)
+            v += node(i - 1 + a, j - 1 + b) * (wx[a]*wy[b]);
+    }
+    return v;
+}
+
+void DistortionGrid::build(int w, int h) {
+    width = w;
+    height = h;
+    const int cell = 1 << DISTORTION_CELL_SHIFT;
+    const double scale = (double)(1 << DISTORTION_FRACTION_BITS);
+    // Nodes at 0, cell, ... up to the first one at or beyond the edge
+    tableCols = (w + cell - 1) / cell + 1;
+    tableRows = (h + cell - 1) / cell + 1;
+    if (tableCols < 2)
+        tableCols = 2;
+    if (tableRows < 2)
+        tableRows = 2;
+    table.resize(tableCols * tableRows * 2);
+    for (int j = 0; j < tableRows; ++j) {
+        for (int i = 0; i < tableCols; ++i) {
+            R2Vector v = interpolate(R2Point(i*cell, j*cell));
+            int* t = &table[(j*tableCols + i) * 2];
+            t[0] = (int) floor(v.x*scale + 0.5);
+            t[1] = (int) floor(v.y*scale + 0.5);
+        }
+    }
+}
+
+R2Vector DistortionGrid::correction(const R2Point& p) const {
+    const double cell = (double)(1 << DISTORTION_CELL_SHIFT);
+    const double scale = 1. / (double)(1 << DISTORTION_FRACTION_BITS);
+    double tx, ty;
+    int i = gridCell(p.x / cell, tableCols, tx);
+    int j = gridCell(p.y / cell, tableRows, ty);
+    const int* a = &table[(j*tableCols + i) * 2];
+    const int* b = a + tableCols*2;
+    R2Vector v;
+    v.x = ((a[0]*(1. - tx) + a[2]*tx)*(1. - ty) +
+        (b[0]*(1. - tx) + b[2]*tx)*ty) * scale;
+    v.y = ((a[1]*(1. - tx) + a[3]*tx)*(1. - ty) +
+        (b[1]*(1. - tx) + b[3]*tx)*ty) * scale;
+    return v;
+}
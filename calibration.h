@@ -0,0 +1,171 @@
+//
+// Mapping of mouse (pen) coordinates to window coordinates,
+// found by clicking at the target points. Two points give a scale
+// and an offset per axis, three an affine transform, four or more
+// a projective one (homography), fitted by least squares. The
+// grid mode captures a grid of targets and corrects the lens
+// distortion left after the homography with a dense lookup table.
+// The transform is applied in fixed point. A finished calibration
+// is saved to a file and loaded at startup.
+//
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <stdio.h>
+#include <vector>
+#include "R2Graph.h"
+#include "renderbackend.h"
+
+const int MIN_CALIBRATION_POINTS = 2;
+const int MAX_CALIBRATION_POINTS = 9;
+// Four corners and the center
+const int DEFAULT_CALIBRATION_POINTS = 5;
+// Targets are placed this fraction of the window size from its edges
+const double CALIBRATION_MARGIN = 0.1;
+// Fixed-point coefficients have this many fraction bits
+const int CALIBRATION_FIXED_SHIFT = 30;
+
+// Grid mode: columns and rows of targets
+const int MIN_GRID_SIZE = 3;
+const int MAX_GRID_SIZE = 9;
+const int DEFAULT_GRID_COLS = 5;
+const int DEFAULT_GRID_ROWS = 4;
+const int MAX_CALIBRATION_TARGETS = MAX_GRID_SIZE * MAX_GRID_SIZE;
+// The lookup table has a node every 1 << DISTORTION_CELL_SHIFT pixels
+const int DISTORTION_CELL_SHIFT = 4;
+// Window points and offsets in the table have this many fraction bits
+const int DISTORTION_FRACTION_BITS = 8;
+// Refinements of the offsets at the captured nodes
+const int DISTORTION_ITERATIONS = 8;
+
+// Correction of window points, sampled at a coarse grid of targets
+// and resampled into a dense table for bilinear lookup
+class DistortionGrid {
+public:
+    // The captured grid, 0 x 0 if there is no correction
+    int cols, rows;
+    double x0, y0;              // Window position of the first node
+    double stepX, stepY;
+    std::vector<R2Vector> offsets;  // At the nodes, by rows
+
+    // The dense table covers the window [0, width) x [0, height)
+    int width, height;
+    int tableCols, tableRows;
+    // dx, dy at the nodes, by rows, DISTORTION_FRACTION_BITS fraction bits
+    std::vector<int> table;
+
+    DistortionGrid();
+
+    bool empty() const { return cols == 0; }
+    void clear();
+    void setGrid(
+        int c, int r, double left, double top, double dx, double dy
+    );
+    // Catmull-Rom interpolation of the offsets at the captured nodes
+    R2Vector interpolate(const R2Point& p) const;
+    // Resample the offsets into the table for a window of w x h
+    void build(int w, int h);
+    // Bilinear lookup in the table
+    R2Vector correction(const R2Point& p) const;
+
+    // x, y are window coordinates with DISTORTION_FRACTION_BITS
+    // fraction bits
+    void correct(long long& x, long long& y) const {
+        const int shift = DISTORTION_FRACTION_BITS + DISTORTION_CELL_SHIFT;
+        const long long cell = 1LL << shift;
+        long long cx = x, cy = y;
+        if (cx < 0)
+            cx = 0;
+        else if (cx >= (long long)(tableCols - 1) * cell)
+            cx = (long long)(tableCols - 1) * cell - 1;
+        if (cy < 0)
+            cy = 0;
+        else if (cy >= (long long)(tableRows - 1) * cell)
+            cy = (long long)(tableRows - 1) * cell - 1;
+        // Weights of 8 bits
+        int fx = (int)((cx & (cell - 1)) >> (shift - 8));
+        int fy = (int)((cy & (cell - 1)) >> (shift - 8));
+        const int* a = &table[
+            ((int)(cy >> shift) * tableCols + (int)(cx >> shift)) * 2
+        ];
+        const int* b = a + tableCols*2;
+        x += bilinear(a[0], a[2], b[0], b[2], fx, fy);
+        y += bilinear(a[1], a[3], b[1], b[3], fx, fy);
+    }
+
+private:
+    R2Vector node(int i, int j) const;
+    static long long bilinear(
+        long long v00, long long v10, long long v01, long long v11,
+        int fx, int fy
+    ) {
+        long long top = v00*(256 - fx) + v10*fx;
+        long long bottom = v01*(256 - fx) + v11*fx;
+        return (top*(256 - fy) + bottom*fy + (1 << 15)) >> 16;
+    }
+};
+
+class Calibration {
+public:
+    int numPoints;
+    I2Point points[MAX_CALIBRATION_TARGETS];    // Targets in window
+    I2Point clicks[MAX_CALIBRATION_TARGETS];    // Where the user clicked
+    int numClicks;
+
+    // Grid mode: targets by rows, 0 x 0 otherwise
+    int gridCols, gridRows;
+    int windowWidth, windowHeight;      // Of the last start()
+    DistortionGrid distortion;
+
+    // window = H * mouse in homogeneous coordinates, H[8] == 1
+    double transform[9];
+    bool affine;                // transform[6] == transform[7] == 0
+
+    // Of the last fit at the clicks, in window pixels
+    double rmsError;
+    double maxError;
+
+    Calibration(int n = DEFAULT_CALIBRATION_POINTS);
+
+    // "n" for n targets, "CxR" or "grid" for the grid mode;
+    // return false if the spec is not understood
+    bool configure(const char* spec);
+    // Place n targets (or numPoints if n <= 0) in the window
+    void start(int w, int h, int n = 0);
+    // Place a grid of targets (in grid mode the same as start())
+    void startGrid(int w, int h, int cols, int rows);
+
+    // Return true when all the targets have been clicked
+    bool addClick(const I2Point& t);
+
+    void map(const I2Point& mousePoint, I2Point& windowPoint) const;
+    // The same for many points at once; in and out may be equal
+    void mapPoints(const I2Point* in, I2Point* out, int n) const;
+    // With double precision, without rounding
+    R2Point mapExact(const R2Point& mousePoint) const;
+
+    // The current target
+    void draw(RenderBackend& r) const;
+
+    // Model and residual errors of the fit
+    void report(FILE* f) const;
+
+    // The finished calibration; return false on an I/O or format error
+    bool save(const char* path) const;
+    bool load(const char* path);
+    // WHITEBOARD_CALIBRATION_FILE or ~/.whiteboard-calibration
+    static const char* cachePath();
+
+private:
+    long long fixed[9];         // transform << CALIBRATION_FIXED_SHIFT
+
+    void setTransform(const double* h);
+    bool fitScale();
+    bool fitLeastSquares(bool projective);
+    void setDistortionGrid();
+    void fitDistortion();
+    R2Point mapBase(const R2Point& mousePoint) const;
+    void computeErrors();
+};
+
+#endif
@@ -0,0 +1,299 @@
+#include <QMetaObject>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+#include "inputthread.h"
+#include "actionio.h"
+#include "latency.h"
+
+InputThread::InputThread():
+    QThread(),
+    ring(),
+    worldCoordinates(false),
+    xMin(0),
+    xMax(0),
+    yMin(0),
+    yMax(0),
+    fd(-1),
+    actions(),
+    rate(DEFAULT_REPLAY_RATE),
+    hasPressure(false),
+    pressureMin(0),
+    pressureMax(0),
+    receiver(0),
+    slot(0),
+    stopping(0),
+    wakePending(0),
+    numOpenStrokes(0)
+{}
+
+InputThread::~InputThread() {
+    stop();
+    if (fd >= 0)
+        close(fd);
+}
+
+InputThread* InputThread::open(
+    const char* path, int rate, QObject* receiver, const char* slot
+) {
+    InputThread* t = new InputThread();
+    t->receiver = receiver;
+    t->slot = slot;
+    if (rate > 0)
+        t->rate = rate;
+
+    if (strncmp(path, "/dev/input/", 11) != 0) {
+        FILE* f = fopen(path, "r");
+        if (f == 0) {
+            perror(path);
+            delete t;
+            return 0;
+        }
+        bool ok = readActions(f, t->actions);
+        fclose(f);
+        if (!ok) {
+            delete t;
+            return 0;
+        }
+        t->worldCoordinates = true;
+        return t;
+    }
+
+    t->fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (t->fd < 0) {
+        perror(path);
+        delete t;
+        return 0;
+    }
+    input_absinfo x, y, p;
+    if (
+        ioctl(t->fd, EVIOCGABS(ABS_X), &x) < 0 ||
+        ioctl(t->fd, EVIOCGABS(ABS_Y), &y) < 0 ||
+        x.maximum <= x.minimum || y.maximum <= y.minimum
+    ) {
+        fprintf(stderr, "%s: not an absolute pointing device\n", path);
+        delete t;
+        return 0;
+    }
+    t->xMin = x.minimum;
+    t->xMax = x.maximum;
+    t->yMin = y.minimum;
+    t->yMax = y.maximum;
+    if (
+        ioctl(t->fd, EVIOCGABS(ABS_PRESSURE), &p) >= 0 &&
+        p.maximum > p.minimum
+    ) {
+        t->hasPressure = true;
+        t->pressureMin = p.minimum;
+        t->pressureMax = p.maximum;
+    }
+    return t;
+}
+
+void InputThread::stop() {
+    stopping.storeRelease(1);
+    wait();
+}
+
+void InputThread::run() {
+    if (fd >= 0)
+        readDevice();
+    else
+        replay();
+}
+
+// Index of the open stroke or -1
+static int findStroke(const int* strokes, int n, int touchId) {
+    for (int i = 0; i < n; ++i) {
+        if (strokes[i] == touchId)
+            return i;
+    }
+    return -1;
+}
+
+void InputThread::push(
+    int type, const I2Point& p, int pressure, int touchId /* = NO_TOUCH */,
+    unsigned char fraction /* = 0 */
+) {
+    InputSample s;
+    s.type = type;
+    s.pressure = pressure;
+    s.touchId = touchId;
+    s.point = p;
+    s.fraction = fraction;
+    s.time = latencyClock();
+    int open = findStroke(openStrokes, numOpenStrokes, touchId);
+    if (type == Action::START_CURVE) {
+        if (open >= 0) {
+            // Restarts the open stroke; if there is no room, ends it
+            // in its reserved sample instead
+            if (!ring.push(s, numOpenStrokes)) {
+                s.type = Action::END_CURVE;
+                s.point = openPoints[open];
+                s.fraction = 0;
+                ring.push(s);
+                openStrokes[open] = openStrokes[numOpenStrokes - 1];
+                openPoints[open] = openPoints[numOpenStrokes - 1];
+                --numOpenStrokes;
+                return;
+            }
+            openPoints[open] = p;
+        } else if (numOpenStrokes >= MAX_OPEN_STROKES) {
+            ring.dropped.fetchAndAddRelaxed(1);
+            return;
+        } else {
+            // Room for its end and for the ends of the open strokes
+            if (!ring.push(s, numOpenStrokes + 1))
+                return;
+            openStrokes[numOpenStrokes] = touchId;
+            openPoints[numOpenStrokes] = p;
+            ++numOpenStrokes;
+        }
+    } else {
+        if (open < 0) {
+            ring.dropped.fetchAndAddRelaxed(1);
+            return;
+        }
+        if (type == Action::END_CURVE) {
+            // Reserved when the stroke started
+            openStrokes[open] = openStrokes[numOpenStrokes - 1];
+            openPoints[open] = openPoints[numOpenStrokes - 1];
+            --numOpenStrokes;
+            ring.push(s);
+        } else if (ring.push(s, numOpenStrokes)) {
+            openPoints[open] = p;
+        } else {
+            return;
+        }
+    }
+    // The receiver drains everything pushed before it handles the
+    // wake, so one wake per drain is enough
+    if (wakePending.testAndSetOrdered(0, 1))
+        QMetaObject::invokeMethod(receiver, slot, Qt::QueuedConnection);
+}
+
+// The recorded actions at a constant rate, as a pen would send them
+void InputThread::replay() {
+    long long start = latencyClock();
+    for (unsigned int i = 0; i < actions.size(); ++i) {
+        if (stopping.loadAcquire() != 0)
+            return;
+        long long due = start + (long long) i * 1000000 / rate;
+        long long wait = due - latencyClock();
+        if (wait > 0)
+            usleep((useconds_t) wait);
+        const Action& a = actions[i];
+        push(a.type, a.point, a.pressure, a.touchId, a.fraction);
+    }
+}
+
+int InputThread::scalePressure(int value) const {
+    int pressure = (int)(
+        (long long)(value - pressureMin) * MAX_PRESSURE /
+        (pressureMax - pressureMin)
+    );
+    if (pressure < 0)
+        pressure = 0;
+    else if (pressure > MAX_PRESSURE)
+        pressure = MAX_PRESSURE;
+    return pressure;
+}
+
+// The current state of the device, after events were lost
+void InputThread::readState(I2Point& p, int& pressure, bool& down) const {
+    unsigned char keys[KEY_MAX/8 + 1];
+    memset(keys, 0, sizeof(keys));
+    if (ioctl(fd, EVIOCGKEY(sizeof(keys)), keys) >= 0) {
+        down =
+            (keys[BTN_TOUCH/8] & (1 << (BTN_TOUCH%8))) != 0 ||
+            (keys[BTN_LEFT/8] & (1 << (BTN_LEFT%8))) != 0;
+    }
+    input_absinfo a;
+    if (ioctl(fd, EVIOCGABS(ABS_X), &a) >= 0)
+        p.x = a.value;
+    if (ioctl(fd, EVIOCGABS(ABS_Y), &a) >= 0)
+        p.y = a.value;
+    if (hasPressure && ioctl(fd, EVIOCGABS(ABS_PRESSURE), &a) >= 0)
+        pressure = scalePressure(a.value);
+}
+
+// Single pointer: the contact (BTN_TOUCH, or BTN_LEFT of a mouse
+// emulation) starts and ends a stroke, every report in between
+// that moves the pointer continues it. After SYN_DROPPED the
+// events up to the next SYN_REPORT are incomplete: they are
+// discarded and the state is read from the device instead.
+void InputThread::readDevice() {
+    input_event events[64];
+    I2Point p(0, 0);
+    int pressure = hasPressure? 0 : NO_PRESSURE;
+    bool down = false;          // As reported by the device
+    bool drawing = false;       // As pushed into the ring
+    bool moved = false;
+    bool syncing = false;       // Discarding until SYN_REPORT
+    pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while (stopping.loadAcquire() == 0) {
+        pfd.revents = 0;
+        if (poll(&pfd, 1, INPUT_POLL_INTERVAL) <= 0)
+            continue;
+        ssize_t n = read(fd, events, sizeof(events));
+        if (n < (ssize_t) sizeof(input_event)) {
+            if (n < 0 && (errno == EINTR || errno == EAGAIN))
+                continue;
+            perror("input device");
+            return;
+        }
+        int count = (int)(n / sizeof(input_event));
+        for (int i = 0; i < count; ++i) {
+            const input_event& e = events[i];
+            if (e.type == EV_SYN && e.code == SYN_DROPPED) {
+                // The kernel buffer overflowed: count it with ours
+                ring.dropped.fetchAndAddRelaxed(1);
+                syncing = true;
+                continue;
+            }
+            bool report = (e.type == EV_SYN && e.code == SYN_REPORT);
+            if (syncing) {
+                if (!report)
+                    continue;
+                readState(p, pressure, down);
+                moved = true;
+                syncing = false;
+            } else if (e.type == EV_ABS) {
+                if (e.code == ABS_X) {
+                    p.x = e.value;
+                    moved = true;
+                } else if (e.code == ABS_Y) {
+                    p.y = e.value;
+                    moved = true;
+                } else if (e.code == ABS_PRESSURE && hasPressure) {
+                    pressure = scalePressure(e.value);
+                }
+            } else if (
+                e.type == EV_KEY &&
+                (e.code == BTN_TOUCH || e.code == BTN_LEFT)
+            ) {
+                down = (e.value != 0);
+            }
+            if (!report)
+                continue;
+            // A report, or the state read after a drop
+            if (down && !drawing) {
+                push(Action::START_CURVE, p, pressure);
+                drawing = true;
+            } else if (down && moved) {
+                push(Action::DRAW_CURVE, p, pressure);
+            } else if (!down && drawing) {
+                push(Action::END_CURVE, p, NO_PRESSURE);
+                drawing = false;
+            }
+            moved = false;
+        }
+    }
+}
@@ -0,0 +1,137 @@
+//
+// Input acquisition on a thread of its own, so that long paints
+// or layouts on the GUI thread neither delay nor lose pen samples.
+// The thread reads a Linux evdev device (a tablet, a touch screen
+// or a uinput test device) or replays a recorded action stream at
+// a fixed rate, timestamps every sample and pushes it into a
+// lock-free ring that the widget drains once per frame. Nothing is
+// allocated or locked per sample.
+//
+#ifndef INPUTTHREAD_H
+#define INPUTTHREAD_H
+
+#include <QThread>
+#include <QAtomicInt>
+#include <QObject>
+#include <vector>
+#include "board.h"
+
+// Samples in the ring, a power of two
+const int INPUT_RING_SIZE = 4096;
+// Samples per second of a replayed stream
+const int DEFAULT_REPLAY_RATE = 240;
+// How often the device thread checks for a stop, in milliseconds
+const int INPUT_POLL_INTERVAL = 100;
+// Strokes open at once, enough for the fingers of two hands;
+// starts beyond that are dropped
+const int MAX_OPEN_STROKES = 16;
+
+class InputSample {
+public:
+    int type;                   // Action::START_CURVE...
+    int pressure;               // 0..MAX_PRESSURE or NO_PRESSURE
+    int touchId;                // Of a replayed touch stroke or NO_TOUCH
+    I2Point point;              // See InputThread::worldCoordinates
+    unsigned char fraction;     // Sub-pixel offset of a world point
+    long long time;             // latencyClock() at acquisition
+};
+
+// Single producer (the input thread), single consumer (the GUI)
+class InputRing {
+public:
+    QAtomicInt head;            // Next sample to write, producer only
+    QAtomicInt tail;            // Next sample to read, consumer only
+    QAtomicInt dropped;         // Samples lost because the ring was full
+    InputSample samples[INPUT_RING_SIZE];
+
+    InputRing():
+        head(0),
+        tail(0),
+        dropped(0)
+    {}
+
+    // Fails unless reserve more samples still fit after this one
+    bool push(const InputSample& s, int reserve = 0) {
+        int h = head.load();
+        if (
+            (unsigned int)(h - tail.loadAcquire()) + reserve >=
+                INPUT_RING_SIZE
+        ) {
+            dropped.fetchAndAddRelaxed(1);
+            return false;
+        }
+        samples[h & (INPUT_RING_SIZE - 1)] = s;
+        head.storeRelease(h + 1);
+        return true;
+    }
+
+    bool pop(InputSample& s) {
+        int t = tail.load();
+        if (t == head.loadAcquire())
+            return false;
+        s = samples[t & (INPUT_RING_SIZE - 1)];
+        tail.storeRelease(t + 1);
+        return true;
+    }
+};
+
+class InputThread: public QThread {
+public:
+    InputRing ring;
+
+    // Replayed samples are world points; device samples are in the
+    // device range [xMin, xMax] x [yMin, yMax], to be scaled to the
+    // window and calibrated like mouse points
+    bool worldCoordinates;
+    int xMin, xMax, yMin, yMax;
+
+    // A path under /dev/input is read as an evdev device, any other
+    // file as an action stream replayed at rate samples per second;
+    // return 0 if it cannot be opened. Every time the ring becomes
+    // non-empty, the slot is invoked on the receiver (queued, at
+    // most once until wakeHandled()).
+    static InputThread* open(
+        const char* path, int rate, QObject* receiver, const char* slot
+    );
+    ~InputThread();
+
+    void stop();
+    // Call before draining the ring
+    void wakeHandled() {
+        wakePending.storeRelease(0);
+    }
+
+protected:
+    void run();
+
+private:
+    int fd;                     // Device, or -1 for a replay
+    std::vector<Action> actions;    // Of the replay
+    int rate;
+    bool hasPressure;
+    int pressureMin, pressureMax;
+    QObject* receiver;
+    const char* slot;
+    QAtomicInt stopping;
+    QAtomicInt wakePending;
+
+    // A full ring drops whole strokes: their starts are refused
+    // unless the ends of all the open strokes still fit, so that a
+    // stroke in the ring always ends. Samples of a stroke that is
+    // not open are dropped. By touch id.
+    int openStrokes[MAX_OPEN_STROKES];
+    I2Point openPoints[MAX_OPEN_STROKES];   // Their last samples
+    int numOpenStrokes;
+
+    InputThread();
+    void push(
+        int type, const I2Point& p, int pressure, int touchId = NO_TOUCH,
+        unsigned char fraction = 0
+    );
+    void replay();
+    void readDevice();
+    int scalePressure(int value) const;
+    void readState(I2Point& p, int& pressure, bool& down) const;
+};
+
+#endif
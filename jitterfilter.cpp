@@ -0,0 +1,53 @@
+#include <math.h>
+#include <stdio.h>
+#include "jitterfilter.h"
+
+// Smoothing factor of an exponential filter with the cutoff
+// frequency fc at the sampling interval dt
+static inline float smoothing(float fc, float dt) {
+    float tau = 1.f / (2.f * (float) M_PI * fc);
+    return 1.f / (1.f + tau / dt);
+}
+
+float OneEuroFilter::filter(
+    float x, float dt,
+    float minCutoff, float beta, float speedCutoff
+) {
+    if (!initialized) {
+        initialized = true;
+        value = x;
+        speed = 0.f;
+        return x;
+    }
+    float a = smoothing(speedCutoff, dt);
+    speed += a * ((x - value) / dt - speed);
+    float fc = minCutoff + beta * fabsf(speed);
+    value += smoothing(fc, dt) * (x - value);
+    return value;
+}
+
+void InkFilter::configure(const char* spec) {
+    enabled = true;
+    if (spec == 0)
+        return;
+    float v[3] = { minCutoff, beta, speedCutoff };
+    sscanf(spec, "%f,%f,%f", &v[0], &v[1], &v[2]);
+    if (v[0] > 0.f)
+        minCutoff = v[0];
+    if (v[1] >= 0.f)
+        beta = v[1];
+    if (v[2] > 0.f)
+        speedCutoff = v[2];
+}
+
+I2Point InkFilter::filter(const I2Point& p, double t) {
+    if (!enabled)
+        return p;
+    float dt = (float)((t - lastTime) * 1e-3);
+    lastTime = t;
+    if (dt < MIN_FILTER_INTERVAL)
+        dt = MIN_FILTER_INTERVAL;
+    float x = fx.filter((float) p.x, dt, minCutoff, beta, speedCutoff);
+    float y = fy.filter((float) p.y, dt, minCutoff, beta, speedCutoff);
+    return I2Point((int) floorf(x + 0.5f), (int) floorf(y + 0.5f));
+}
@@ -0,0 +1,82 @@
+//
+// Jitter filter for the pen input: the One-Euro filter, a low-pass
+// filter whose cutoff frequency grows with the speed of the pen.
+// A slow pen is smoothed strongly (no wobbly ink, fewer stroke
+// points), a fast one follows with little lag.
+//
+#ifndef JITTERFILTER_H
+#define JITTERFILTER_H
+
+#include "R2Graph.h"
+
+// Cutoff frequency of a resting pen, in Hz
+const float DEFAULT_FILTER_MIN_CUTOFF = 5.f;
+// Growth of the cutoff with the speed, in Hz per pixel/second
+const float DEFAULT_FILTER_BETA = 0.1f;
+// Cutoff of the speed estimate, in Hz
+const float DEFAULT_FILTER_SPEED_CUTOFF = 1.f;
+// Events closer in time are taken as this far apart, in seconds
+const float MIN_FILTER_INTERVAL = 0.001f;
+
+// One coordinate
+class OneEuroFilter {
+public:
+    OneEuroFilter():
+        initialized(false),
+        value(0.f),
+        speed(0.f)
+    {}
+
+    void reset() {
+        initialized = false;
+    }
+
+    // Raw value x, dt seconds after the previous one
+    float filter(
+        float x, float dt,
+        float minCutoff, float beta, float speedCutoff
+    );
+
+private:
+    bool initialized;
+    float value;            // Filtered, sub-pixel
+    float speed;            // Filtered derivative, per second
+};
+
+class InkFilter {
+public:
+    float minCutoff;
+    float beta;
+    float speedCutoff;
+    bool enabled;
+
+    InkFilter():
+        minCutoff(DEFAULT_FILTER_MIN_CUTOFF),
+        beta(DEFAULT_FILTER_BETA),
+        speedCutoff(DEFAULT_FILTER_SPEED_CUTOFF),
+        enabled(false),
+        lastTime(0.),
+        fx(),
+        fy()
+    {}
+
+    // "minCutoff,beta,speedCutoff", any of them may be omitted;
+    // enables the filter
+    void configure(const char* spec);
+
+    // Start of a stroke
+    void reset() {
+        fx.reset();
+        fy.reset();
+    }
+
+    // Input point p with the event time t in milliseconds;
+    // p itself if the filter is disabled
+    I2Point filter(const I2Point& p, double t);
+
+private:
+    double lastTime;
+    OneEuroFilter fx, fy;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include "lasso.h"
+
+static const int MAX_LASSO_BANDS = 256;
+
+void Lasso::push_back(const I2Point& p) {
+    if (vertices.size() == 0) {
+        bbox = I2Rectangle(p, 0, 0);
+    } else if (p == vertices.back()) {
+        return;
+    } else {
+        bbox.add(I2Rectangle(p, 0, 0));
+    }
+    vertices.push_back(p);
+}
+
+void Lasso::finish() {
+    bandStart.clear();
+    bandEdges.clear();
+    int n = size();
+    if (n < 3)
+        return;
+
+    bandTop = bbox.top();
+    int numBands = bbox.height() + 1;
+    if (numBands > MAX_LASSO_BANDS)
+        numBands = MAX_LASSO_BANDS;
+    bandHeight = (bbox.height() + numBands) / numBands;
+
+    // Count edges per band, then fill (compressed rows)
+    bandStart.assign(numBands + 1, 0);
+    for (int pass = 0; pass < 2; ++pass) {
+        std::vector<int> fill;
+        if (pass == 1) {
+            for (int b = 0; b < numBands; ++b)
+                bandStart[b+1] += bandStart[b];
+            bandEdges.resize(bandStart[numBands]);
+            fill.assign(bandStart.begin(), bandStart.end() - 1);
+        }
+        for (int i = 0; i < n; ++i) {
+            int y0 = vertices[i].y;
+            int y1 = vertices[(i + 1) % n].y;
+            if (y0 > y1) {
+                int t = y0; y0 = y1; y1 = t;
+            }
+            int b0 = (y0 - bandTop) / bandHeight;
+            int b1 = (y1 - bandTop) / bandHeight;
+            for (int b = b0; b <= b1; ++b) {
+                if (pass == 0)
+                    ++bandStart[b+1];
+                else
+                    bandEdges[fill[b]++] = i;
+            }
+        }
+    }
+}
+
+bool Lasso::contains(const I2Point& p) const {
+    int n = size();
+    if (
+        n < 3 ||
+        p.x < bbox.left() || p.x > bbox.right() ||
+        p.y < bbox.top() || p.y > bbox.bottom()
+    )
+        return false;
+
+    int e0 = 0, e1 = n;
+    if (!bandStart.empty()) {
+        int b = (p.y - bandTop) / bandHeight;
+        e0 = bandStart[b];
+        e1 = bandStart[b+1];
+    }
+
+    bool inside = false;
+    for (int k = e0; k < e1; ++k) {
+        int i = (bandStart.empty())? k : bandEdges[k];
+        const I2Point& a = vertices[i];
+        const I2Point& c = vertices[(i + 1) % n];
+        if ((a.y > p.y) == (c.y > p.y))
+            continue;
+        // Does the edge cross the horizontal ray to the right of p?
+        long long lhs = (long long)(p.x - a.x) * (long long)(c.y - a.y);
+        long long rhs = (long long)(c.x - a.x) * (long long)(p.y - a.y);
+        if ((c.y > a.y)? lhs < rhs : lhs > rhs)
+            inside = !inside;
+    }
+    return inside;
+}
+
+bool Lasso::containsAll(const I2Point* nodes, int numNodes) const {
+    for (int i = 0; i < numNodes; ++i) {
+        if (!contains(nodes[i]))
+            return false;
+    }
+    return numNodes > 0;
+}
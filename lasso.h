@@ -0,0 +1,55 @@
+//
+// Lasso: a closed polygon built from the pointer path
+//
+#ifndef LASSO_H
+#define LASSO_H
+
+#include <vector>
+#include "R2Graph.h"
+
+class Lasso {
+public:
+    std::vector<I2Point> vertices;
+    I2Rectangle bbox;
+
+    Lasso():
+        vertices(),
+        bbox(),
+        bandTop(0),
+        bandHeight(1),
+        bandStart(),
+        bandEdges()
+    {}
+
+    int size() const {
+        return (int) vertices.size();
+    }
+
+    void clear() {
+        vertices.clear();
+        bandStart.clear();
+        bandEdges.clear();
+    }
+
+    void push_back(const I2Point& p);
+
+    // Build the edge table used by contains();
+    // call after the last vertex is added
+    void finish();
+
+    // Point-in-polygon test (crossing number)
+    bool contains(const I2Point& p) const;
+
+    // All points of the polyline lie inside the lasso
+    bool containsAll(const I2Point* nodes, int numNodes) const;
+
+private:
+    // Edges are bucketed into horizontal bands, so that
+    // a test looks only at the edges crossing its band
+    int bandTop;
+    int bandHeight;
+    std::vector<int> bandStart;     // Offsets into bandEdges
+    std::vector<int> bandEdges;     // Edge indices
+};
+
+#endif
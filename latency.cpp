@@ -0,0 +1,106 @@
+#include <time.h>
+#include "latency.h"
+
+const char* const latencyStageNames[NUM_LATENCY_STAGES] = {
+    "action",
+    "queue",
+    "raster",
+    "blit",
+    "total"
+};
+
+long long latencyClock() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (long long) t.tv_sec * 1000000LL + t.tv_nsec / 1000;
+}
+
+void LatencyHistogram::clear() {
+    count = 0;
+    maxValue = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; ++i)
+        buckets[i] = 0;
+}
+
+static int bucketIndex(long long value) {
+    if (value < 2*LATENCY_SUB_BUCKETS)
+        return (int) value;
+    int shift = 0;
+    while ((value >> shift) >= 2*LATENCY_SUB_BUCKETS)
+        ++shift;
+    if (shift > LATENCY_MAX_SHIFT)
+        return LATENCY_BUCKETS - 1;
+    return shift*LATENCY_SUB_BUCKETS + (int)(value >> shift);
+}
+
+// The largest value in the bucket
+static long long bucketValue(int index) {
+    if (index < 2*LATENCY_SUB_BUCKETS)
+        return index;
+    int shift = index / LATENCY_SUB_BUCKETS - 1;
+    long long m = index - shift*LATENCY_SUB_BUCKETS;
+    return ((m + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(long long value) {
+    if (value < 0)
+        value = 0;
+    ++buckets[bucketIndex(value)];
+    ++count;
+    if (value > maxValue)
+        maxValue = value;
+}
+
+long long LatencyHistogram::percentile(double q) const {
+    if (count == 0)
+        return 0;
+    long long rank = (long long)(q * (double) count + 0.5);
+    if (rank < 1)
+        rank = 1;
+    long long n = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+        n += buckets[i];
+        if (n >= rank) {
+            long long v = bucketValue(i);
+            return (v < maxValue)? v : maxValue;
+        }
+    }
+    return maxValue;
+}
+
+void LatencyStats::frameStarted(long long t) {
+    for (unsigned int i = 0; i < queued.size(); ++i) {
+        stages[LATENCY_QUEUE].record(t - queued[i]);
+        drawn.push_back(queued[i]);
+    }
+    queued.clear();
+}
+
+void LatencyStats::frameShown(long long t) {
+    for (unsigned int i = 0; i < drawn.size(); ++i)
+        stages[LATENCY_TOTAL].record(t - drawn[i]);
+    drawn.clear();
+}
+
+void LatencyStats::report(FILE* f) const {
+    fprintf(f, "stage      count    p50 ms    p99 ms    max ms\n");
+    for (int s = 0; s < NUM_LATENCY_STAGES; ++s) {
+        const LatencyHistogram& h = stages[s];
+        fprintf(
+            f, "%-8s %7lld %9.3f %9.3f %9.3f\n",
+            latencyStageNames[s], h.count,
+            h.percentile(0.5) * 1e-3, h.percentile(0.99) * 1e-3,
+            h.maxValue * 1e-3
+        );
+    }
+}
+
+void LatencyStats::summary(char* text, int maxLength) const {
+    const LatencyHistogram& h = stages[LATENCY_TOTAL];
+    snprintf(
+        text, maxLength,
+        "ink latency p50 %.1f ms, p99 %.1f ms, max %.1f ms (%lld)",
+        h.percentile(0.5) * 1e-3, h.percentile(0.99) * 1e-3,
+        h.maxValue * 1e-3, h.count
+    );
+}
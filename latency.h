@@ -0,0 +1,73 @@
+//
+// End-to-end latency of the live ink: from an input event to the
+// paint that shows it. Times are in microseconds; every stage has
+// a histogram with log-linear buckets (HDR style) of about 3%
+// resolution.
+//
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdio.h>
+#include <vector>
+
+enum LatencyStage {
+    LATENCY_ACTION = 0,     // processAction of one event
+    LATENCY_QUEUE,          // Input event -> start of its frame
+    LATENCY_RASTER,         // Drawing the new ink into the offscreen
+    LATENCY_BLIT,           // paintEvent that shows it
+    LATENCY_TOTAL,          // Input event -> end of that paintEvent
+    NUM_LATENCY_STAGES
+};
+
+extern const char* const latencyStageNames[NUM_LATENCY_STAGES];
+
+// Monotonic time in microseconds
+long long latencyClock();
+
+// Values below 2*LATENCY_SUB_BUCKETS are exact; larger ones share
+// LATENCY_SUB_BUCKETS buckets per power of two
+const int LATENCY_SUB_BUCKETS = 32;
+const int LATENCY_SUB_BITS = 5;
+const int LATENCY_MAX_SHIFT = 31;
+const int LATENCY_BUCKETS = (LATENCY_MAX_SHIFT + 2) * LATENCY_SUB_BUCKETS;
+
+class LatencyHistogram {
+public:
+    long long count;
+    long long maxValue;
+
+    LatencyHistogram() {
+        clear();
+    }
+
+    void clear();
+    void record(long long value);
+    // The value below which the fraction q of the records lie
+    long long percentile(double q) const;
+
+private:
+    long long buckets[LATENCY_BUCKETS];
+};
+
+class LatencyStats {
+public:
+    LatencyHistogram stages[NUM_LATENCY_STAGES];
+
+    // Input events not drawn yet, and drawn but not shown yet
+    std::vector<long long> queued;
+    std::vector<long long> drawn;
+
+    void inputEvent(long long t) {
+        queued.push_back(t);
+    }
+
+    void frameStarted(long long t);
+    void frameShown(long long t);
+
+    // Stage, count, p50, p99 and max in milliseconds per line
+    void report(FILE* f) const;
+    // One line for the on-screen display
+    void summary(char* text, int maxLength) const;
+};
+
+#endif
@@ -1,6 +1,8 @@
 #include <QApplication>
 #include <QWidget>
+#include <stdio.h>
 #include "whitebrd.h"
+#include "tracer.h"
 
 int main(int argc, char *argv[]) {
     
@@ -12,5 +14,56 @@ int main(int argc, char *argv[]) {
     window.setWindowTitle("White Board");
     window.showMaximized();
 
-    return app.exec();
+    int res = app.exec();
+    Tracer::stopTracing();
+
+    DecimationStats decimation = window.board.decimationStats();
+    if (decimation.inputPoints > 0) {
+        fprintf(
+            stderr,
+            "Input points: %lld, stored: %lld (%.1f%% dropped), "
+            "max error %.3f px (bound %.2f px)\n",
+            decimation.inputPoints,
+            decimation.inputPoints - decimation.droppedPoints,
+            100. * (double) decimation.droppedPoints /
+                (double) decimation.inputPoints,
+            decimation.maxError,
+            DECIMATION_TOLERANCE
+        );
+    }
+    const TileCache& tiles = window.tiles;
+    if (tiles.hits + tiles.misses > 0) {
+        fprintf(
+            stderr,
+            "Tiles: %lld hits, %lld misses, %lld fallbacks, "
+            "%lld evictions, %lld KB cached\n",
+            tiles.hits, tiles.misses, tiles.fallbacks,
+            tiles.evictions, tiles.memoryUsed() / 1024
+        );
+    }
+    if (window.inkFrames > 0) {
+        fprintf(
+            stderr,
+            "Live ink: %lld events in %lld frames, "
+            "%.2f events/frame on average, %d max\n",
+            window.inkEvents, window.inkFrames,
+            (double) window.inkEvents / (double) window.inkFrames,
+            window.maxEventsPerFrame
+        );
+        fprintf(stderr, "Events/frame histogram:");
+        for (int i = 1; i < EVENTS_PER_FRAME_BUCKETS; ++i) {
+            if (window.eventsPerFrame[i] == 0)
+                continue;
+            fprintf(
+                stderr, " %d%s:%lld",
+                i, (i == EVENTS_PER_FRAME_BUCKETS - 1)? "+" : "",
+                window.eventsPerFrame[i]
+            );
+        }
+        fprintf(stderr, "\n");
+    }
+    window.dumpLatency();
+    if (totalAllocations() > 0)
+        reportAllocations(stderr);
+    return res;
 }
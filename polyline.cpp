@@ -0,0 +1,130 @@
+#include "polyline.h"
+
+double distanceToSegment(
+    const R2Point& p,
+    const R2Point& a, const R2Point& b
+) {
+    R2Vector v = b - a;
+    R2Vector w = p - a;
+    double vv = v*v;
+    if (vv <= R2GRAPH_EPSILON)
+        return w.length();
+    double t = (w*v) / vv;
+    if (t <= 0.)
+        return w.length();
+    if (t >= 1.)
+        return (p - b).length();
+    return fabs(v.signed_area(w)) / sqrt(vv);
+}
+
+static inline R2Point toR2(const I2Point& p) {
+    return R2Point(p.x, p.y);
+}
+
+void simplifyDouglasPeucker(
+    const I2Point* nodes, int numNodes,
+    double tolerance,
+    std::vector<I2Point>& result,
+    std::vector<int>* kept /* = 0 */
+) {
+    result.clear();
+    if (kept != 0)
+        kept->clear();
+    if (numNodes <= 2) {
+        result.assign(nodes, nodes + numNodes);
+        for (int i = 0; kept != 0 && i < numNodes; ++i)
+            kept->push_back(i);
+        return;
+    }
+
+    std::vector<char> keep(numNodes, 0);
+    keep[0] = 1;
+    keep[numNodes - 1] = 1;
+
+    // Explicit stack of index ranges instead of recursion
+    std::vector<int> stack;
+    stack.push_back(0);
+    stack.push_back(numNodes - 1);
+    while (!stack.empty()) {
+        int last = stack.back(); stack.pop_back();
+        int first = stack.back(); stack.pop_back();
+        R2Point a = toR2(nodes[first]);
+        R2Point b = toR2(nodes[last]);
+        double maxDist = -1.;
+        int maxIdx = -1;
+        for (int i = first + 1; i < last; ++i) {
+            double d = distanceToSegment(toR2(nodes[i]), a, b);
+            if (d > maxDist) {
+                maxDist = d;
+                maxIdx = i;
+            }
+        }
+        if (maxIdx >= 0 && maxDist > tolerance) {
+            keep[maxIdx] = 1;
+            stack.push_back(first);
+            stack.push_back(maxIdx);
+            stack.push_back(maxIdx);
+            stack.push_back(last);
+        }
+    }
+
+    for (int i = 0; i < numNodes; ++i) {
+        if (keep[i]) {
+            result.push_back(nodes[i]);
+            if (kept != 0)
+                kept->push_back(i);
+        }
+    }
+}
+
+// The tangent points are at a + ra*m and b + rb*m, where the unit
+// vector m makes the angle acos((ra - rb)/d) with ab
+bool taperedSegment(
+    const R2Point& a, double ra,
+    const R2Point& b, double rb,
+    R2Point quad[4]
+) {
+    R2Vector v = b - a;
+    double d = v.length();
+    if (d <= fabs(ra - rb) || d <= R2GRAPH_EPSILON)
+        return false;
+    R2Vector u = v * (1. / d);
+    R2Vector n(-u.y, u.x);
+    double k = (ra - rb) / d;
+    double h = sqrt(1. - k*k);
+    R2Vector m0 = u*k + n*h;
+    R2Vector m1 = u*k - n*h;
+    quad[0] = a + m0*ra;
+    quad[1] = b + m0*rb;
+    quad[2] = b + m1*rb;
+    quad[3] = a + m1*ra;
+    return true;
+}
+
+bool StreamDecimator::replaceTail(
+    const R2Point& anchor, const R2Point& tail, const R2Point& p
+) {
+    if (runLength >= DECIMATION_MAX_RUN) {
+        runLength = 0;
+        return false;
+    }
+
+    double err = distanceToSegment(tail, anchor, p);
+    for (int i = 0; err <= tolerance && i < runLength; ++i) {
+        double d = distanceToSegment(run[i], anchor, p);
+        if (d > err)
+            err = d;
+    }
+    if (err > tolerance) {
+        // The tail is fixed and becomes the new anchor
+        runLength = 0;
+        return false;
+    }
+
+    run[runLength] = tail;
+    ++runLength;
+    ++stats.droppedPoints;
+    if (err > stats.maxError)
+        stats.maxError = err;
+    return true;
+}
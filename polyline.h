@@ -0,0 +1,103 @@
+//
+// Polyline utilities: online decimation of input points,
+// Ramer-Douglas-Peucker simplification, outlines of segments
+// of a varying width
+//
+#ifndef POLYLINE_H
+#define POLYLINE_H
+
+#include <vector>
+#include "R2Graph.h"
+
+// Maximal distance (in pixels) from a dropped input point
+// to the stored polyline
+const double DECIMATION_TOLERANCE = 0.5;
+// Maximal number of consecutive points merged into one segment
+const int DECIMATION_MAX_RUN = 32;
+
+// Distance from the point p to the line segment [a, b]
+double distanceToSegment(
+    const R2Point& p,
+    const R2Point& a, const R2Point& b
+);
+
+// Ramer-Douglas-Peucker: keep a subset of nodes such that every
+// dropped node is within the tolerance of the result. The indices
+// of the kept nodes are stored in kept if it is not 0.
+void simplifyDouglasPeucker(
+    const I2Point* nodes, int numNodes,
+    double tolerance,
+    std::vector<I2Point>& result,
+    std::vector<int>* kept = 0
+);
+
+// A segment whose width changes linearly from 2*ra at a to 2*rb
+// at b is the convex hull of the two disks: the disks and the
+// quadrilateral between their outer tangents, stored as the
+// tangent points a+, b+, b-, a-. Return false if one disk
+// contains the other.
+bool taperedSegment(
+    const R2Point& a, double ra,
+    const R2Point& b, double rb,
+    R2Point quad[4]
+);
+
+// Points seen and dropped by decimators
+class DecimationStats {
+public:
+    long long inputPoints;
+    long long droppedPoints;
+    double maxError;
+
+    DecimationStats():
+        inputPoints(0),
+        droppedPoints(0),
+        maxError(0.)
+    {}
+
+    void add(const DecimationStats& s) {
+        inputPoints += s.inputPoints;
+        droppedPoints += s.droppedPoints;
+        if (s.maxError > maxError)
+            maxError = s.maxError;
+    }
+};
+
+// Streaming filter with a lookahead of one point. The last stored
+// point (tail) is tentative: when a new point arrives, the tail is
+// replaced by it if the tail and all the points merged before lie
+// within the tolerance of the segment from the last fixed point
+// (anchor). Thus the visible ink always ends at the latest point.
+// Only a stroke being drawn needs one: it is kept with the live
+// stroke, not in the committed ones.
+class StreamDecimator {
+public:
+    DecimationStats stats;      // Of all strokes filtered
+
+    StreamDecimator(double tol = DECIMATION_TOLERANCE):
+        stats(),
+        tolerance(tol),
+        runLength(0)
+    {}
+
+    void reset() {
+        runLength = 0;
+    }
+
+    void setTolerance(double tol) {
+        tolerance = tol;
+    }
+
+    // Return true if the tail may be replaced by p; the points
+    // have their sub-pixel offsets
+    bool replaceTail(
+        const R2Point& anchor, const R2Point& tail, const R2Point& p
+    );
+
+private:
+    double tolerance;
+    R2Point run[DECIMATION_MAX_RUN];    // Points merged since anchor
+    int runLength;
+};
+
+#endif
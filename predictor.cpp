@@ -0,0 +1,118 @@
+#include <math.h>
+#include "predictor.h"
+
+void InkPredictor::addSample(const R2Point& p, double t) {
+    if (numSamples > 0) {
+        double last = times[numSamples - 1];
+        if (t < last) {
+            // The clock went back: start again
+            numSamples = 0;
+        } else if (t == last) {
+            // Coalesced events with the same time stamp
+            points[numSamples - 1] = p;
+            return;
+        }
+    }
+
+    // Drop the points that are too old or do not fit
+    int first = 0;
+    while (
+        first < numSamples &&
+        (t - times[first] > PREDICTION_WINDOW ||
+            numSamples - first >= PREDICTION_SAMPLES)
+    )
+        ++first;
+    if (first > 0) {
+        for (int i = first; i < numSamples; ++i) {
+            points[i - first] = points[i];
+            times[i - first] = times[i];
+        }
+        numSamples -= first;
+    }
+    points[numSamples] = p;
+    times[numSamples] = t;
+    ++numSamples;
+}
+
+// Least squares fit of x(s) = c0 + c1*s + c2*s^2, where s is the
+// time relative to the last point
+static bool fitQuadratic(
+    const double* s, const double* x, int n,
+    double& c1, double& c2
+) {
+    double m[5] = {0., 0., 0., 0., 0.};     // Sums of s^k
+    double b[3] = {0., 0., 0.};             // Sums of s^k * x
+    for (int i = 0; i < n; ++i) {
+        double sk = 1.;
+        for (int k = 0; k < 5; ++k) {
+            m[k] += sk;
+            if (k < 3)
+                b[k] += sk * x[i];
+            sk *= s[i];
+        }
+    }
+    // Cramer's rule for the symmetric 3x3 normal equations
+    double det =
+        m[0]*(m[2]*m[4] - m[3]*m[3]) -
+        m[1]*(m[1]*m[4] - m[3]*m[2]) +
+        m[2]*(m[1]*m[3] - m[2]*m[2]);
+    if (fabs(det) < 1e-9)
+        return false;
+    c1 = (
+        m[0]*(b[1]*m[4] - m[3]*b[2]) -
+        b[0]*(m[1]*m[4] - m[3]*m[2]) +
+        m[2]*(m[1]*b[2] - b[1]*m[2])
+    ) / det;
+    c2 = (
+        m[0]*(m[2]*b[2] - b[1]*m[3]) -
+        m[1]*(m[1]*b[2] - b[1]*m[2]) +
+        b[0]*(m[1]*m[3] - m[2]*m[2])
+    ) / det;
+    return true;
+}
+
+bool InkPredictor::predict(double ahead, R2Point& p) const {
+    if (numSamples < 2 || ahead <= 0.)
+        return false;
+    int n = numSamples;
+    double tLast = times[n - 1];
+    if (tLast - times[0] < 1.)
+        return false;
+
+    R2Vector v;     // Velocity, pixels per ms
+    R2Vector a2;    // Half of the acceleration
+    bool fitted = false;
+    if (n >= 3) {
+        double s[PREDICTION_SAMPLES];
+        double x[PREDICTION_SAMPLES], y[PREDICTION_SAMPLES];
+        for (int i = 0; i < n; ++i) {
+            s[i] = times[i] - tLast;
+            x[i] = points[i].x;
+            y[i] = points[i].y;
+        }
+        fitted =
+            fitQuadratic(s, x, n, v.x, a2.x) &&
+            fitQuadratic(s, y, n, v.y, a2.y);
+    }
+    if (!fitted) {
+        // Too few points for the acceleration
+        v = (points[n - 1] - points[n - 2]) *
+            (1. / (tLast - times[n - 2]));
+        a2 = R2Vector(0., 0.);
+    }
+
+    R2Vector d1 = v * ahead;
+    R2Vector d2 = a2 * (ahead * ahead);
+    // The acceleration of noisy input is unreliable: it may
+    // only bend the linear prediction, not dominate it
+    double l1 = d1.length();
+    double l2 = d2.length();
+    if (l2 > 0.5 * l1)
+        d2 *= 0.5 * l1 / l2;
+    R2Vector d = d1 + d2;
+    double l = d.length();
+    if (l > MAX_PREDICTION_DISTANCE)
+        d *= MAX_PREDICTION_DISTANCE / l;
+    p = points[n - 1] + d;
+    return true;
+}
@@ -0,0 +1,48 @@
+//
+// Motion prediction for the live stroke: extrapolates the pen
+// a few milliseconds ahead of the last input event, from the
+// velocity and acceleration of the recent input points
+//
+#ifndef PREDICTOR_H
+#define PREDICTOR_H
+
+#include "R2Graph.h"
+
+// Maximal number of recent input points used for the fit
+const int PREDICTION_SAMPLES = 4;
+// Older input points (in milliseconds) are not used
+const double PREDICTION_WINDOW = 40.;
+// Maximal length of the predicted segment, in pixels
+const double MAX_PREDICTION_DISTANCE = 32.;
+// Time to predict ahead when the prediction is enabled without
+// an explicit value, in milliseconds
+const double DEFAULT_PREDICTION_AHEAD = 16.;
+
+class InkPredictor {
+public:
+    InkPredictor():
+        numSamples(0)
+    {}
+
+    void reset() {
+        numSamples = 0;
+    }
+
+    int size() const {
+        return numSamples;
+    }
+
+    // Input point p with the event time t in milliseconds
+    void addSample(const R2Point& p, double t);
+
+    // Predicted position at the time of the last point plus ahead.
+    // Return false if there are too few recent points.
+    bool predict(double ahead, R2Point& p) const;
+
+private:
+    R2Point points[PREDICTION_SAMPLES];     // The oldest first
+    double times[PREDICTION_SAMPLES];
+    int numSamples;
+};
+
+#endif
@@ -0,0 +1,411 @@
+#include <math.h>
+#include <assert.h>
+#include "qtrenderer.h"
+#include "tracer.h"
+
+static inline long long pathBytes(const QPainterPath& path) {
+    return path.elementCount() * (long long) sizeof(QPainterPath::Element);
+}
+
+// A polygon as a closed subpath. Under the nonzero fill rule
+// the pieces of an outline must not cancel each other, so all
+// of them are added with the same orientation.
+static void addPolygon(QPainterPath& path, const R2Point* p, int n) {
+    double area = 0.;
+    for (int i = 0; i < n; ++i) {
+        const R2Point& q = p[(i + 1) % n];
+        area += p[i].x * q.y - q.x * p[i].y;
+    }
+    if (area >= 0.) {
+        path.moveTo(p[0].x, p[0].y);
+        for (int i = 1; i < n; ++i)
+            path.lineTo(p[i].x, p[i].y);
+    } else {
+        path.moveTo(p[n - 1].x, p[n - 1].y);
+        for (int i = n - 2; i >= 0; --i)
+            path.lineTo(p[i].x, p[i].y);
+    }
+    path.closeSubpath();
+}
+
+// Regular polygon within 1/8 pixel of the disk
+static void addDisk(QPainterPath& path, const R2Point& c, double r) {
+    const int maxSides = 64;
+    int n = 8;
+    while (n < maxSides && r * (1. - cos(M_PI / n)) > 0.125)
+        n *= 2;
+    R2Point p[maxSides];
+    for (int i = 0; i < n; ++i) {
+        double a = 2. * M_PI * i / n;
+        p[i] = R2Point(c.x + r*cos(a), c.y + r*sin(a));
+    }
+    addPolygon(path, p, n);
+}
+
+// Sector of the disk at c between the points p0 and p1 on its
+// circle, the shorter way round
+static void addSector(
+    QPainterPath& path, const R2Point& c, double r,
+    const R2Point& p0, const R2Point& p1
+) {
+    const int maxSteps = 8;
+    double a0 = atan2(p0.y - c.y, p0.x - c.x);
+    double delta = atan2(p1.y - c.y, p1.x - c.x) - a0;
+    if (delta > M_PI)
+        delta -= 2.*M_PI;
+    else if (delta < -M_PI)
+        delta += 2.*M_PI;
+    if (fabs(delta) * r < 0.05)
+        return;
+    // Steps of at most pi/8
+    int steps = (int) ceil(fabs(delta) / (M_PI / maxSteps));
+    R2Point p[maxSteps + 2];
+    p[0] = c;
+    p[1] = p0;
+    for (int i = 1; i < steps; ++i) {
+        double a = a0 + delta * i / steps;
+        p[i + 1] = R2Point(c.x + r*cos(a), c.y + r*sin(a));
+    }
+    p[steps + 1] = p1;
+    addPolygon(path, p, steps + 2);
+}
+
+static inline R2Point nodePoint(
+    const I2Point* points, const unsigned char* fractions, int i
+) {
+    if (fractions != 0)
+        return subpixelPoint(points[i], fractions[i]);
+    return R2Point(points[i].x, points[i].y);
+}
+
+static inline QPointF toQPointF(const R2Point& p) {
+    return QPointF(p.x, p.y);
+}
+
+// The polyline through the points [first, size) of a stroke
+static void appendPolyline(
+    QPainterPath& path, const Stroke& str, int first
+) {
+    path.moveTo(toQPointF(str.exactPoint(first)));
+    for (int i = first + 1; i < str.size(); ++i)
+        path.lineTo(toQPointF(str.exactPoint(i)));
+}
+
+// Every segment is the hull of the disks at its ends (see
+// taperedSegment); where two hulls meet, the gaps between them
+// are filled with sectors of the disk at the common point
+void appendOutline(
+    QPainterPath& path,
+    const I2Point* points, const unsigned char* pressures,
+    const unsigned char* fractions,
+    int first, int last, bool cap, const Stroke& str
+) {
+    path.setFillRule(Qt::WindingFill);
+    for (int i = first; i < last; ++i) {
+        R2Point b = nodePoint(points, fractions, i);
+        double rb = str.radius(pressures[i]);
+        if (i == 0) {
+            addDisk(path, b, rb);
+            continue;
+        }
+        R2Point a = nodePoint(points, fractions, i-1);
+        double ra = str.radius(pressures[i-1]);
+        R2Point quad[4];
+        if (!taperedSegment(a, ra, b, rb, quad)) {
+            // One disk contains the other
+            if (rb > ra)
+                addDisk(path, b, rb);
+            continue;
+        }
+        addPolygon(path, quad, 4);
+        R2Point prev[4];
+        if (
+            i >= 2 &&
+            taperedSegment(
+                nodePoint(points, fractions, i-2), str.radius(pressures[i-2]),
+                a, ra, prev
+            )
+        ) {
+            addSector(path, a, ra, prev[1], quad[0]);
+            addSector(path, a, ra, prev[2], quad[3]);
+        }
+    }
+    if (cap && last >= 2)
+        addDisk(
+            path, nodePoint(points, fractions, last-1),
+            str.radius(pressures[last-1])
+        );
+}
+
+// Extend the outline of a pressure stroke to its fixed points; the
+// last point of a stroke being drawn may still move. Return the
+// growth in bytes.
+static long long extendOutline(const Stroke& str, QtStrokePaths& paths) {
+    int end = str.finished? str.size() : str.size() - 1;
+    if (end <= paths.outlineEnd)
+        return 0;
+    long long size = pathBytes(paths.path);
+    appendOutline(
+        paths.path, &(str.points[0]), &(str.pressures[0]),
+        strokeFractions(str),
+        paths.outlineEnd, end, str.finished, str
+    );
+    paths.outlineEnd = end;
+    return pathBytes(paths.path) - size;
+}
+
+const QtStrokePaths& strokePaths(const Stroke& str) {
+    // Only this backend attaches caches to strokes
+    if (str.cache != 0) {
+        QtStrokePaths* paths = static_cast<QtStrokePaths*>(str.cache);
+        if (paths->filled) {
+            // The element buffer of the path is reallocated
+            long long grown = extendOutline(str, *paths);
+            if (grown > 0) {
+                AllocCounter& c = allocCounters[ALLOC_PATHS];
+                c.freed(paths->bytes);
+                paths->bytes += grown;
+                c.allocated(paths->bytes);
+            }
+        }
+        return *paths;
+    }
+
+    QtStrokePaths* paths = new QtStrokePaths();
+    paths->levels.resize(str.levels.size());
+    if (str.hasPressure()) {
+        paths->filled = true;
+        extendOutline(str, *paths);
+        for (unsigned int l = 0; l < str.levels.size(); ++l) {
+            const StrokeLevel& level = str.levels[l];
+            appendOutline(
+                paths->levels[l], &(level.points[0]), &(level.pressures[0]),
+                0, 0, (int) level.points.size(), true, str
+            );
+        }
+    } else {
+        if (str.size() > 0)
+            appendPolyline(paths->path, str, 0);
+        for (unsigned int l = 0; l < str.levels.size(); ++l) {
+            const std::vector<I2Point>& nodes = str.levels[l].points;
+            QPainterPath& path = paths->levels[l];
+            path.moveTo(QPointF(nodes[0].x, nodes[0].y));
+            for (unsigned int i = 1; i < nodes.size(); ++i)
+                path.lineTo(QPointF(nodes[i].x, nodes[i].y));
+        }
+    }
+
+    // Every path is a heap block of elements
+    AllocCounter& c = allocCounters[ALLOC_PATHS];
+    long long size = pathBytes(paths->path);
+    c.allocated(size);
+    paths->bytes = size;
+    for (unsigned int l = 0; l < paths->levels.size(); ++l) {
+        size = pathBytes(paths->levels[l]);
+        c.allocated(size);
+        paths->bytes += size;
+    }
+    str.cache = paths;
+    return *paths;
+}
+
+QColor paletteColor(int color) {
+    return QColor(QRgb(paletteRgb[color]));
+}
+
+QtRenderer::QtRenderer(QPainter* painter, bool cache /* = true */):
+    qp(painter),
+    world(painter->transform()),
+    inWorld(true),
+    cachePaths(cache)
+{}
+
+QtRenderer::~QtRenderer() {
+    setWorld(true);
+}
+
+void QtRenderer::setWorld(bool w) {
+    if (w == inWorld)
+        return;
+    if (w)
+        qp->setTransform(world);
+    else
+        qp->resetTransform();
+    inWorld = w;
+}
+
+void QtRenderer::fillRect(const I2Rectangle& r, int color) {
+    setWorld(false);
+    qp->fillRect(
+        QRect(r.left(), r.top(), r.width(), r.height()),
+        paletteColor(color)
+    );
+}
+
+void QtRenderer::drawLine(
+    const I2Point& p0, const I2Point& p1,
+    int lineWidth, int color
+) {
+    setWorld(false);
+    QPen pen(paletteColor(color));
+    pen.setWidth(lineWidth);
+    qp->setPen(pen);
+    qp->drawLine(QPointF(p0.x, p0.y), QPointF(p1.x, p1.y));
+}
+
+void QtRenderer::drawText(const I2Point& p, const char* text, int color) {
+    setWorld(false);
+    QPen pen(paletteColor(color));
+    pen.setWidth(1);
+    qp->setPen(pen);
+    qp->drawText(p.x, p.y, text);
+}
+
+QPen QtRenderer::strokePen(const Stroke& str) const {
+    QPen pen(paletteColor(str.color % NUM_COLORS));
+    pen.setWidth(str.width);
+    return pen;
+}
+
+// The cached outline and, while the stroke is drawn, the piece
+// from its fixed points to the last one
+void QtRenderer::drawOutline(const Stroke& str, int l) {
+    const QtStrokePaths& paths = strokePaths(str);
+    QColor color = paletteColor(str.color % NUM_COLORS);
+    if (l >= 0) {
+        qp->fillPath(paths.levels[l], color);
+        return;
+    }
+    qp->fillPath(paths.path, color);
+    if (paths.outlineEnd < str.size()) {
+        QPainterPath tail;
+        appendOutline(
+            tail, &(str.points[0]), &(str.pressures[0]),
+            strokeFractions(str),
+            paths.outlineEnd, str.size(), true, str
+        );
+        qp->fillPath(tail, color);
+    }
+}
+
+// The full-resolution points, without touching the cache
+void QtRenderer::drawUncached(const Stroke& str) {
+    QPainterPath path;
+    if (str.hasPressure()) {
+        appendOutline(
+            path, &(str.points[0]), &(str.pressures[0]),
+            strokeFractions(str),
+            0, str.size(), true, str
+        );
+        qp->fillPath(path, paletteColor(str.color % NUM_COLORS));
+        return;
+    }
+    appendPolyline(path, str, 0);
+    qp->strokePath(path, strokePen(str));
+}
+
+void QtRenderer::drawStroke(const Stroke& str, const R2Rectangle* clip) {
+    TraceSpan span("drawStroke");
+    if (str.size() == 0)
+        return;
+    setWorld(true);
+    if (str.hasPressure()) {
+        // Clipped by the painter; the outline is cached in full
+        if (!cachePaths)
+            drawUncached(str);
+        else if (str.size() > 1 || str.finished)
+            drawOutline(str, str.levelForScale(fabs(world.m11())));
+        return;
+    }
+    QPen pen = strokePen(str);
+
+    if (str.size() == 1) {
+        if (str.finished) {
+            // A single point
+            qp->setPen(pen);
+            R2Point p = str.exactPoint(0);
+            qp->drawLine(QPointF(p.x - 1, p.y), QPointF(p.x + 1, p.y));
+            qp->drawLine(QPointF(p.x, p.y - 1), QPointF(p.x, p.y + 1));
+        }
+        return;
+    }
+    if (!cachePaths) {
+        drawUncached(str);
+        return;
+    }
+
+    // Device pixels per pixel, e.g. for zoomed-out views
+    double scale = fabs(world.m11());
+    int l = str.levelForScale(scale);
+
+    int w = str.margin();
+    if (
+        clip == 0 || (
+            clip->left() <= str.bbox.left() - w &&
+            str.bbox.right() + w <= clip->right() &&
+            clip->bottom() <= str.bbox.top() - w &&
+            str.bbox.bottom() + w <= clip->top()
+        )
+    ) {
+        // Completely visible: use the cached path
+        const QtStrokePaths& paths = strokePaths(str);
+        if (l < 0)
+            qp->strokePath(paths.path, pen);
+        else
+            qp->strokePath(paths.levels[l], pen);
+        return;
+    }
+
+    // Partly visible: clip long segments to the visible
+    // rectangle, extended by the line width
+    const std::vector<I2Point>& nodes =
+        (l < 0)? str.points : str.levels[l].points;
+    R2Rectangle r(
+        clip->left() - w, clip->bottom() - w,
+        clip->width() + 2*w, clip->height() + 2*w
+    );
+    QPainterPath path;
+    bool connected = false;
+    R2Point last;
+    const unsigned char* fractions = (l < 0)? strokeFractions(str) : 0;
+    for (unsigned int i = 1; i < nodes.size(); ++i) {
+        R2Point c0, c1;
+        if (!r.clip(
+            nodePoint(&(nodes[0]), fractions, i-1),
+            nodePoint(&(nodes[0]), fractions, i),
+            c0, c1
+        )) {
+            connected = false;
+            continue;
+        }
+        if (!connected || c0 != last)
+            path.moveTo(QPointF(c0.x, c0.y));
+        path.lineTo(QPointF(c1.x, c1.y));
+        last = c1;
+        connected = true;
+    }
+    qp->strokePath(path, pen);
+}
+
+void QtRenderer::drawStrokeTail(const Stroke& str, int first) {
+    int n = str.size();
+    if (first >= n || n < 2)
+        return;
+    setWorld(true);
+    if (str.hasPressure()) {
+        // Only the new pieces of the outline
+        QPainterPath path;
+        appendOutline(
+            path, &(str.points[0]), &(str.pressures[0]),
+            strokeFractions(str),
+            first, n, true, str
+        );
+        qp->fillPath(path, paletteColor(str.color % NUM_COLORS));
+        return;
+    }
+    if (first > 0)
+        --first;
+    QPainterPath path;
+    appendPolyline(path, str, first);
+    qp->strokePath(path, strokePen(str));
+}
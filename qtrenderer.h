@@ -0,0 +1,91 @@
+//
+// Qt rendering backend: draws with a QPainter. Strokes are drawn
+// through the painter transform that was set when the renderer
+// was created; buttons are drawn in window coordinates.
+// The paths of the strokes are cached in them, which only the GUI
+// thread may do; renderers on other threads (exports of snapshots)
+// build the paths anew every time.
+//
+#ifndef QTRENDERER_H
+#define QTRENDERER_H
+
+#include <QPainter>
+#include <QPainterPath>
+#include <QTransform>
+#include <vector>
+#include "board.h"
+
+// Paths of a stroke and of its levels, built on first use. For a
+// pressure stroke they are outlines to be filled; the outline of
+// a stroke being drawn covers its fixed points and is extended
+// as they are added.
+class QtStrokePaths: public StrokeCache {
+public:
+    QPainterPath path;
+    std::vector<QPainterPath> levels;
+    bool filled;        // Outlines of a pressure stroke
+    int outlineEnd;     // path is the outline of the points [0, outlineEnd)
+    long long bytes;    // Accounted in allocCounters[ALLOC_PATHS]
+
+    QtStrokePaths():
+        path(),
+        levels(),
+        filled(false),
+        outlineEnd(0),
+        bytes(0)
+    {}
+
+    ~QtStrokePaths() {
+        allocCounters[ALLOC_PATHS].freed(bytes, 1 + (long long) levels.size());
+    }
+
+    bool pointsChanged(int first) {
+        return filled && outlineEnd <= first;
+    }
+};
+
+const QtStrokePaths& strokePaths(const Stroke& str);
+
+// Outline of the points [first, last) of a pressure stroke, joined
+// to the point first-1; with cap, the last point is closed by a disk.
+// fractions are the sub-pixel offsets of the points, or 0.
+void appendOutline(
+    QPainterPath& path,
+    const I2Point* points, const unsigned char* pressures,
+    const unsigned char* fractions,
+    int first, int last, bool cap, const Stroke& str
+);
+
+inline const unsigned char* strokeFractions(const Stroke& str) {
+    return str.fractions.empty()? 0 : &(str.fractions[0]);
+}
+
+QColor paletteColor(int color);
+
+class QtRenderer: public RenderBackend {
+public:
+    QtRenderer(QPainter* painter, bool cache = true);
+    ~QtRenderer();
+
+    void fillRect(const I2Rectangle& r, int color);
+    void drawLine(
+        const I2Point& p0, const I2Point& p1,
+        int lineWidth, int color
+    );
+    void drawText(const I2Point& p, const char* text, int color);
+    void drawStroke(const Stroke& str, const R2Rectangle* clip);
+    void drawStrokeTail(const Stroke& str, int first);
+
+private:
+    QPainter* qp;
+    QTransform world;
+    bool inWorld;       // The painter has the world transform
+    bool cachePaths;
+
+    void setWorld(bool w);
+    QPen strokePen(const Stroke& str) const;
+    void drawOutline(const Stroke& str, int l);
+    void drawUncached(const Stroke& str);
+};
+
+#endif
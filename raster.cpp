@@ -0,0 +1,209 @@
+#include <math.h>
+#include <stdlib.h>
+#include "raster.h"
+#include "polyline.h"
+
+Raster::Raster():
+    data(0),
+    width(0),
+    height(0),
+    stride(0),
+    ownsData(false),
+    clip()
+{}
+
+Raster::Raster(int w, int h):
+    data(0),
+    width(0),
+    height(0),
+    stride(0),
+    ownsData(false),
+    clip()
+{
+    create(w, h);
+}
+
+Raster::~Raster() {
+    release();
+}
+
+void Raster::create(int w, int h) {
+    release();
+    data = (Pixel*) malloc((size_t) w*h*sizeof(Pixel));
+    if (data == 0)
+        return;
+    width = w;
+    height = h;
+    stride = w;
+    ownsData = true;
+    resetClip();
+}
+
+void Raster::attach(Pixel* d, int w, int h, int s) {
+    release();
+    data = d;
+    width = w;
+    height = h;
+    stride = s;
+    ownsData = false;
+    resetClip();
+}
+
+void Raster::release() {
+    if (ownsData)
+        free(data);
+    data = 0;
+    width = 0;
+    height = 0;
+    stride = 0;
+    ownsData = false;
+    resetClip();
+}
+
+void Raster::setClip(const I2Rectangle& r) {
+    resetClip();
+    clip.intersect(r);
+    if (clip.width() < 0)
+        clip.setWidth(0);
+    if (clip.height() < 0)
+        clip.setHeight(0);
+}
+
+void Raster::resetClip() {
+    clip = I2Rectangle(0, 0, width, height);
+}
+
+void Raster::fill(Pixel color) {
+    fillRect(I2Rectangle(0, 0, width, height), color);
+}
+
+void Raster::fillRect(const I2Rectangle& rect, Pixel color) {
+    I2Rectangle r = rect;
+    r.intersect(clip);
+    if (r.width() <= 0 || r.height() <= 0)
+        return;
+    for (int y = r.top(); y < r.bottom(); ++y) {
+        Pixel* p = scanLine(y) + r.left();
+        Pixel* end = p + r.width();
+        while (p < end)
+            *p++ = color;
+    }
+}
+
+// Pixels are sampled at integer points; the span [xl, xr) is filled
+void Raster::fillSpan(int y, double xl, double xr, Pixel color) {
+    int x0 = (int) ceil(xl);
+    int x1 = (int) ceil(xr);
+    if (x0 < clip.left())
+        x0 = clip.left();
+    if (x1 > clip.right())
+        x1 = clip.right();
+    Pixel* p = scanLine(y);
+    for (int x = x0; x < x1; ++x)
+        p[x] = color;
+}
+
+I2Rectangle Raster::drawLine(
+    const I2Point& p0, const I2Point& p1,
+    int lineWidth, Pixel color
+) {
+    double r = 0.5 * (lineWidth > 1? lineWidth : 1);
+    return drawTaperedLine(p0, r, p1, r, color);
+}
+
+// The convex hull of the two end disks is convex, so each scanline
+// crosses it in one span: the union of the spans of the disks and
+// of the quadrilateral between their tangents.
+I2Rectangle Raster::drawTaperedLine(
+    const I2Point& p0, double r0,
+    const I2Point& p1, double r1,
+    Pixel color
+) {
+    double ax = p0.x, ay = p0.y;
+    double bx = p1.x, by = p1.y;
+
+    int e0 = (int) ceil(r0), e1 = (int) ceil(r1);
+    int xMin = (p0.x - e0 < p1.x - e1)? p0.x - e0 : p1.x - e1;
+    int xMax = (p0.x + e0 > p1.x + e1)? p0.x + e0 : p1.x + e1;
+    int yMin = (p0.y - e0 < p1.y - e1)? p0.y - e0 : p1.y - e1;
+    int yMax = (p0.y + e0 > p1.y + e1)? p0.y + e0 : p1.y + e1;
+    I2Rectangle damage(xMin, yMin, xMax + 1 - xMin, yMax + 1 - yMin);
+
+    // Corners of the quadrilateral around the segment
+    R2Point quad[4];
+    int numCorners = 0;
+    if (taperedSegment(R2Point(ax, ay), r0, R2Point(bx, by), r1, quad))
+        numCorners = 4;
+
+    int y0 = (int) ceil((ay - r0 < by - r1)? ay - r0 : by - r1);
+    // Exclusive
+    int y1 = (int) ceil((ay + r0 > by + r1)? ay + r0 : by + r1);
+    if (y0 < clip.top())
+        y0 = clip.top();
+    if (y1 > clip.bottom())
+        y1 = clip.bottom();
+    for (int y = y0; y < y1; ++y) {
+        double xl = 1e30, xr = -1e30;
+
+        double ey = y - ay;
+        if (ey*ey <= r0*r0) {
+            double half = sqrt(r0*r0 - ey*ey);
+            if (ax - half < xl) xl = ax - half;
+            if (ax + half > xr) xr = ax + half;
+        }
+        ey = y - by;
+        if (ey*ey <= r1*r1) {
+            double half = sqrt(r1*r1 - ey*ey);
+            if (bx - half < xl) xl = bx - half;
+            if (bx + half > xr) xr = bx + half;
+        }
+
+        for (int i = 0; i < numCorners; ++i) {
+            const R2Point& c0 = quad[i];
+            const R2Point& c1 = quad[(i + 1) % numCorners];
+            double ly = c0.y, hy = c1.y;
+            if (ly > hy) {
+                ly = c1.y; hy = c0.y;
+            }
+            if (y < ly || y > hy)
+                continue;
+            double x;
+            if (hy - ly <= 1e-12) {
+                // Horizontal edge
+                x = c0.x;
+                if (c1.x < xl) xl = c1.x;
+                if (c1.x > xr) xr = c1.x;
+            } else {
+                x = c0.x + (y - c0.y) * (c1.x - c0.x) / (c1.y - c0.y);
+            }
+            if (x < xl) xl = x;
+            if (x > xr) xr = x;
+        }
+
+        if (xl < xr)
+            fillSpan(y, xl, xr, color);
+    }
+    return damage;
+}
+
+I2Rectangle Raster::drawLineStrip(
+    const I2Point* points, int numPoints,
+    int lineWidth, Pixel color
+) {
+    if (numPoints <= 0)
+        return I2Rectangle(0, 0, 0, 0);
+    if (numPoints == 1)
+        return drawLine(points[0], points[0], lineWidth, color);
+    I2Rectangle damage = drawLine(points[0], points[1], lineWidth, color);
+    for (int i = 2; i < numPoints; ++i)
+        damage.add(drawLine(points[i-1], points[i], lineWidth, color));
+    return damage;
+}
+
+I2Rectangle Raster::drawCross(const I2Point& p, int lineWidth, Pixel color) {
+    I2Vector vx(1, 0);
+    I2Vector vy(0, 1);
+    I2Rectangle damage = drawLine(p-vx, p+vx, lineWidth, color);
+    damage.add(drawLine(p-vy, p+vy, lineWidth, color));
+    return damage;
+}
@@ -0,0 +1,80 @@
+//
+// Client-side 32-bit framebuffer with a simple rasterizer for thick
+// polylines. Pixel values are opaque: they are written as given, so
+// an X TrueColor pixel value or an ARGB color may be used.
+//
+#ifndef RASTER_H
+#define RASTER_H
+
+#include "R2Graph.h"
+
+typedef unsigned int Pixel;
+
+class Raster {
+public:
+    Pixel* data;
+    int width;
+    int height;
+    int stride;         // In pixels
+
+    Raster();
+    Raster(int w, int h);
+    ~Raster();
+
+    // Allocate own memory
+    void create(int w, int h);
+    // Use memory owned by somebody else, e.g. a shared memory segment
+    void attach(Pixel* d, int w, int h, int s);
+    void release();
+
+    bool empty() const {
+        return (data == 0);
+    }
+
+    Pixel* scanLine(int y) {
+        return data + (long) y*stride;
+    }
+
+    const Pixel* scanLine(int y) const {
+        return data + (long) y*stride;
+    }
+
+    // Drawing is restricted to the clip rectangle
+    void setClip(const I2Rectangle& r);
+    void resetClip();
+
+    void fill(Pixel color);
+    void fillRect(const I2Rectangle& r, Pixel color);
+
+    // Line of the given width with round caps. All drawing functions
+    // return the bounding box of the pixels that may have changed.
+    I2Rectangle drawLine(
+        const I2Point& p0, const I2Point& p1,
+        int lineWidth, Pixel color
+    );
+    // Round caps of the radii r0 and r1, the width changing linearly
+    I2Rectangle drawTaperedLine(
+        const I2Point& p0, double r0,
+        const I2Point& p1, double r1,
+        Pixel color
+    );
+    // Round joins
+    I2Rectangle drawLineStrip(
+        const I2Point* points, int numPoints,
+        int lineWidth, Pixel color
+    );
+    // A single point is drawn as a small cross
+    I2Rectangle drawCross(const I2Point& p, int lineWidth, Pixel color);
+
+private:
+    bool ownsData;
+    I2Rectangle clip;
+
+    void fillSpan(int y, double xl, double xr, Pixel color);
+
+    // Not copyable
+    Raster(const Raster&);
+    Raster& operator=(const Raster&);
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "rasterrenderer.h"
+
+RasterRenderer::RasterRenderer(Raster* r):
+    raster(r),
+    origin(0, 0),
+    damage(),
+    damaged(false),
+    shifted()
+{
+    for (int i = 0; i < NUM_PALETTE_COLORS; ++i)
+        palette[i] = 0xff000000 | paletteRgb[i];
+}
+
+void RasterRenderer::addDamage(const I2Rectangle& r) {
+    if (!damaged)
+        damage = r;
+    else
+        damage.add(r);
+    damaged = true;
+}
+
+void RasterRenderer::fillRect(const I2Rectangle& r, int color) {
+    raster->fillRect(r, palette[color]);
+    addDamage(r);
+}
+
+void RasterRenderer::drawLine(
+    const I2Point& p0, const I2Point& p1,
+    int lineWidth, int color
+) {
+    addDamage(raster->drawLine(p0, p1, lineWidth, palette[color]));
+}
+
+void RasterRenderer::drawText(
+    const I2Point& /* p */, const char* /* text */, int /* color */
+) {
+    // No fonts here
+}
+
+// Shift world points to raster coordinates; no copy when
+// the origin is zero
+const I2Point* RasterRenderer::toRaster(const I2Point* nodes, int numNodes) {
+    if (origin.x == 0 && origin.y == 0)
+        return nodes;
+    shifted.resize(numNodes);
+    for (int i = 0; i < numNodes; ++i)
+        shifted[i] = I2Point(nodes[i].x - origin.x, nodes[i].y - origin.y);
+    return &(shifted[0]);
+}
+
+void RasterRenderer::drawStroke(
+    const Stroke& str, const R2Rectangle* /* clip */
+) {
+    // Spans outside of the raster are clipped by the rasterizer
+    if (str.size() == 0)
+        return;
+    Pixel c = palette[str.color % NUM_COLORS];
+    const I2Point* nodes = toRaster(&(str.points[0]), str.size());
+    if (str.hasPressure())
+        drawPressureStrip(str, nodes, 0, str.size(), c);
+    else if (str.size() == 1)
+        addDamage(raster->drawCross(nodes[0], str.width, c));
+    else
+        addDamage(raster->drawLineStrip(nodes, str.size(), str.width, c));
+}
+
+void RasterRenderer::drawStrokeTail(const Stroke& str, int first) {
+    int n = str.size();
+    if (first >= n)
+        return;
+    if (n == 1) {
+        drawStroke(str, 0);
+        return;
+    }
+    if (first > 0)
+        --first;
+    const I2Point* nodes = toRaster(&(str.points[first]), n - first);
+    Pixel c = palette[str.color % NUM_COLORS];
+    if (str.hasPressure()) {
+        drawPressureStrip(str, nodes, first, n, c);
+        return;
+    }
+    addDamage(raster->drawLineStrip(nodes, n - first, str.width, c));
+}
+
+// Without antialiasing thinner lines break up into dots
+static double rasterRadius(const Stroke& str, int i) {
+    double r = str.radius(str.pressures[i]);
+    return (r > 0.5)? r : 0.5;
+}
+
+// Points [first, last) of a pressure stroke; nodes are their
+// raster positions. Every segment is the hull of its end disks.
+void RasterRenderer::drawPressureStrip(
+    const Stroke& str, const I2Point* nodes, int first, int last, Pixel c
+) {
+    double r0 = rasterRadius(str, first);
+    if (last - first == 1) {
+        addDamage(raster->drawTaperedLine(nodes[0], r0, nodes[0], r0, c));
+        return;
+    }
+    for (int i = first + 1; i < last; ++i) {
+        double r1 = rasterRadius(str, i);
+        addDamage(raster->drawTaperedLine(
+            nodes[i - 1 - first], r0, nodes[i - first], r1, c
+        ));
+        r0 = r1;
+    }
+}
@@ -0,0 +1,47 @@
+//
+// Headless rendering backend: draws into a Raster. Used by the
+// X11 backing store and for tests and benchmarks without a display.
+// It is never zoomed in: points are drawn at their whole pixels.
+//
+#ifndef RASTERRENDERER_H
+#define RASTERRENDERER_H
+
+#include <vector>
+#include "board.h"
+#include "raster.h"
+
+class RasterRenderer: public RenderBackend {
+public:
+    Raster* raster;
+    Pixel palette[NUM_PALETTE_COLORS];  // By default 0xffRRGGBB
+    I2Vector origin;                    // World point at the pixel (0, 0)
+    I2Rectangle damage;                 // Union of the changed pixels
+    bool damaged;
+
+    RasterRenderer(Raster* r);
+
+    void resetDamage() {
+        damaged = false;
+    }
+
+    void fillRect(const I2Rectangle& r, int color);
+    void drawLine(
+        const I2Point& p0, const I2Point& p1,
+        int lineWidth, int color
+    );
+    void drawText(const I2Point& p, const char* text, int color);
+    void drawStroke(const Stroke& str, const R2Rectangle* clip);
+    void drawStrokeTail(const Stroke& str, int first);
+
+private:
+    std::vector<I2Point> shifted;       // Scratch buffer
+
+    const I2Point* toRaster(const I2Point* nodes, int numNodes);
+    void addDamage(const I2Rectangle& r);
+    void drawPressureStrip(
+        const Stroke& str, const I2Point* nodes, int first, int last,
+        Pixel c
+    );
+};
+
+#endif
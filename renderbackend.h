@@ -0,0 +1,32 @@
+//
+// Interface between the board engine and a drawing backend
+// (Qt painter, X11 window, client-side raster)
+//
+#ifndef RENDERBACKEND_H
+#define RENDERBACKEND_H
+
+#include "R2Graph.h"
+
+class Stroke;
+
+class RenderBackend {
+public:
+    virtual ~RenderBackend() {}
+
+    // Window coordinates; colors are palette indices (see board.h)
+    virtual void fillRect(const I2Rectangle& r, int color) = 0;
+    virtual void drawLine(
+        const I2Point& p0, const I2Point& p1,
+        int lineWidth, int color
+    ) = 0;
+    virtual void drawText(const I2Point& p, const char* text, int color) = 0;
+
+    // World coordinates. clip is the world rectangle being redrawn,
+    // or 0 when the whole stroke is needed.
+    virtual void drawStroke(const Stroke& str, const R2Rectangle* clip) = 0;
+    // Points [first, size) of a stroke being drawn, joined
+    // to the point first-1
+    virtual void drawStrokeTail(const Stroke& str, int first) = 0;
+};
+
+#endif
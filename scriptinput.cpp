@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "scriptinput.h"
+
+ScriptInput::ScriptInput():
+    listenFd(-1),
+    sourceFd(-1),
+    decoders(),
+    buffer(SCRIPT_READ_SIZE),
+    socketPath()
+{}
+
+ScriptInput::~ScriptInput() {
+    while (!decoders.empty())
+        closeSource(decoders.begin()->first);
+    if (listenFd >= 0) {
+        close(listenFd);
+        unlink(socketPath.c_str());
+    }
+}
+
+ScriptInput* ScriptInput::open(const char* spec) {
+    ScriptInput* s = new ScriptInput();
+    if (strcmp(spec, "-") == 0) {
+        fcntl(0, F_SETFL, fcntl(0, F_GETFL) | O_NONBLOCK);
+        s->addSource(0);
+        return s;
+    }
+
+    if (strncmp(spec, "unix:", 5) == 0) {
+        const char* path = spec + 5;
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(addr.sun_path)) {
+            fprintf(stderr, "%s: socket path too long\n", path);
+            delete s;
+            return 0;
+        }
+        strcpy(addr.sun_path, path);
+        // A socket left by a previous run
+        struct stat st;
+        if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+            unlink(path);
+        int fd = socket(
+            AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0
+        );
+        if (
+            fd < 0 ||
+            bind(fd, (const sockaddr*) &addr, sizeof(addr)) < 0 ||
+            listen(fd, 8) < 0
+        ) {
+            perror(path);
+            if (fd >= 0)
+                close(fd);
+            delete s;
+            return 0;
+        }
+        s->listenFd = fd;
+        s->socketPath = path;
+        return s;
+    }
+
+    // A FIFO is also opened for writing: it does not end when the
+    // writers close it, and the next writer can continue
+    struct stat st;
+    int mode = O_RDONLY;
+    if (stat(spec, &st) == 0 && S_ISFIFO(st.st_mode))
+        mode = O_RDWR;
+    int fd = ::open(spec, mode | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        perror(spec);
+        delete s;
+        return 0;
+    }
+    s->addSource(fd);
+    return s;
+}
+
+void ScriptInput::addSource(int fd) {
+    decoders[fd].reset();
+    if (listenFd < 0)
+        sourceFd = fd;
+}
+
+void ScriptInput::closeSource(int fd) {
+    decoders.erase(fd);
+    close(fd);
+    if (fd == sourceFd)
+        sourceFd = -1;
+}
+
+int ScriptInput::acceptClient() {
+    if (listenFd < 0)
+        return -1;
+    int fd = accept4(listenFd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    addSource(fd);
+    return fd;
+}
+
+bool ScriptInput::read(int fd, std::vector<Action>& actions) {
+    std::map<int, ActionDecoder>::iterator d = decoders.find(fd);
+    if (d == decoders.end())
+        return false;
+    ActionDecoder& decoder = d->second;
+    bool open = true;
+    int total = 0;
+    while (total < SCRIPT_BATCH_BYTES) {
+        ssize_t n = ::read(fd, &(buffer[0]), SCRIPT_READ_SIZE);
+        if (n > 0) {
+            decoder.decode(&(buffer[0]), (int) n, actions);
+            total += (int) n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        // The end of the stream, or an error
+        if (n < 0)
+            perror("script input");
+        decoder.finish(actions);
+        open = false;
+        break;
+    }
+    if (decoder.numErrors > 0) {
+        fprintf(
+            stderr, "Script input: %lld bad actions skipped\n",
+            decoder.numErrors
+        );
+        decoder.numErrors = 0;
+    }
+    if (!open)
+        closeSource(fd);
+    return open;
+}
@@ -0,0 +1,50 @@
+//
+// Endpoint for scripted actions, for demos, load tests and other
+// tools: stdin, a FIFO, a file or a Unix socket that accepts any
+// number of clients. Every source is read without blocking into
+// its own ActionDecoder, so text lines and binary records may be
+// split anywhere. The frontend waits until a descriptor becomes
+// readable and applies the actions of a read as one batch.
+//
+#ifndef SCRIPTINPUT_H
+#define SCRIPTINPUT_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "actionio.h"
+
+// Bytes per read() call
+const int SCRIPT_READ_SIZE = 65536;
+// Bytes read from a source per batch, so that a fast writer
+// cannot starve the rest of the event loop
+const int SCRIPT_BATCH_BYTES = 1 << 20;
+
+class ScriptInput {
+public:
+    int listenFd;               // The Unix socket, or -1
+    int sourceFd;               // Otherwise the only source
+
+    // "-" for stdin, "unix:path" for a socket, otherwise the path
+    // of a FIFO or a file; 0 if it cannot be opened
+    static ScriptInput* open(const char* spec);
+    ~ScriptInput();
+
+    // A new client of the socket, or -1
+    int acceptClient();
+    // Read what the source has (at most SCRIPT_BATCH_BYTES) and
+    // append its actions; return false when the source has ended,
+    // it is then closed
+    bool read(int fd, std::vector<Action>& actions);
+
+private:
+    std::map<int, ActionDecoder> decoders;  // By source
+    std::vector<char> buffer;
+    std::string socketPath;     // Removed with the endpoint
+
+    ScriptInput();
+    void addSource(int fd);
+    void closeSource(int fd);
+};
+
+#endif
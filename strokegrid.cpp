@@ -0,0 +1,53 @@
+#include <algorithm>
+#include "strokegrid.h"
+
+void StrokeGrid::insert(int idx, const I2Rectangle& r) {
+    int cx0 = cellOf(r.left());
+    int cx1 = cellOf(r.right());
+    int cy0 = cellOf(r.top());
+    int cy1 = cellOf(r.bottom());
+    for (int cy = cy0; cy <= cy1; ++cy) {
+        for (int cx = cx0; cx <= cx1; ++cx) {
+            cells[key(cx, cy)].push_back(idx);
+        }
+    }
+}
+
+void StrokeGrid::query(const I2Rectangle& r, std::vector<int>& result) const {
+    result.clear();
+    int cx0 = cellOf(r.left());
+    int cx1 = cellOf(r.right());
+    int cy0 = cellOf(r.top());
+    int cy1 = cellOf(r.bottom());
+
+    double numCells = (double)(cx1 - cx0 + 1) * (double)(cy1 - cy0 + 1);
+    if (numCells > (double) cells.size()) {
+        // The query covers more cells than are occupied:
+        // scan the occupied ones instead
+        std::map<long long, std::vector<int> >::const_iterator i;
+        for (i = cells.begin(); i != cells.end(); ++i) {
+            int cx = (int)(i->first >> 32);
+            int cy = (int)(unsigned int)(i->first & 0xffffffffLL);
+            if (cx < cx0 || cx > cx1 || cy < cy0 || cy > cy1)
+                continue;
+            result.insert(result.end(), i->second.begin(), i->second.end());
+        }
+    } else {
+        for (int cy = cy0; cy <= cy1; ++cy) {
+            for (int cx = cx0; cx <= cx1; ++cx) {
+                std::map<long long, std::vector<int> >::const_iterator i =
+                    cells.find(key(cx, cy));
+                if (i == cells.end())
+                    continue;
+                result.insert(
+                    result.end(), i->second.begin(), i->second.end()
+                );
+            }
+        }
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(
+        std::unique(result.begin(), result.end()),
+        result.end()
+    );
+}
@@ -0,0 +1,45 @@
+//
+// Uniform grid of stroke bounding boxes: a broad phase for
+// hit tests (lasso selection, culling) over a page
+//
+#ifndef STROKEGRID_H
+#define STROKEGRID_H
+
+#include <vector>
+#include <map>
+#include "R2Graph.h"
+
+const int STROKE_GRID_CELL = 128;   // Cell size in pixels
+
+class StrokeGrid {
+public:
+    StrokeGrid(int cell = STROKE_GRID_CELL):
+        cellSize(cell),
+        cells()
+    {}
+
+    void clear() {
+        cells.clear();
+    }
+
+    // Register the stroke with index idx and bounding box r
+    void insert(int idx, const I2Rectangle& r);
+
+    // Indices of strokes whose cells intersect r,
+    // sorted in ascending order, without duplicates
+    void query(const I2Rectangle& r, std::vector<int>& result) const;
+
+private:
+    int cellSize;
+    std::map<long long, std::vector<int> > cells;
+
+    int cellOf(int c) const {      // Floor division, c may be negative
+        return (c >= 0)? c / cellSize : -((-c - 1) / cellSize) - 1;
+    }
+
+    static long long key(int cx, int cy) {
+        return ((long long) cx << 32) | (unsigned int) cy;
+    }
+};
+
+#endif
@@ -0,0 +1,246 @@
+#include <QPainter>
+#include <QThread>
+#include <math.h>
+#include "tilecache.h"
+#include "tracer.h"
+#include "allocstats.h"
+
+// Renders one tile in a worker thread
+class TileJob: public QRunnable {
+public:
+    TileJob(
+        TileCache* c, const TileKey& k,
+        const std::vector<TileStroke>& s, int e
+    ):
+        cache(c),
+        key(k),
+        strokes(s),
+        epoch(e)
+    {
+        setAutoDelete(true);
+    }
+
+    void run() {
+        TraceSpan span("renderTile");
+        cache->finished(key, TileCache::rasterize(key, strokes), epoch);
+    }
+
+private:
+    TileCache* cache;
+    TileKey key;
+    std::vector<TileStroke> strokes;
+    int epoch;
+};
+
+TileCache::TileCache(QObject* parent /* = 0 */, qint64 b /* = TILE_CACHE_BUDGET */):
+    QObject(parent),
+    hits(0),
+    misses(0),
+    fallbacks(0),
+    evictions(0),
+    tiles(),
+    lruList(),
+    pending(),
+    budget(b),
+    used(0),
+    epoch(0),
+    priority(0),
+    pool(),
+    resultsMutex(),
+    results(),
+    ready()
+{
+    int n = QThread::idealThreadCount() - 1;    // Leave one for the GUI
+    pool.setMaxThreadCount(n > 0? n : 1);
+}
+
+TileCache::~TileCache() {
+    pool.clear();
+    pool.waitForDone();
+    clear();    // Accounts the freed tile images
+}
+
+double TileCache::levelScale(int level) {
+    return ldexp(1., -level);
+}
+
+// The finest level that is not finer than needed: tiles are
+// downscaled by at most 2 when drawn
+int TileCache::levelForScale(double scale) {
+    int level = (int) floor(-log(scale)/log(2.) + 1e-9);
+    if (level < 0)
+        level = 0;
+    if (level > MAX_TILE_LEVEL)
+        level = MAX_TILE_LEVEL;
+    return level;
+}
+
+R2Rectangle TileCache::tileRect(const TileKey& key) {
+    double size = TILE_SIZE / levelScale(key.level);
+    return R2Rectangle(key.x*size, key.y*size, size, size);
+}
+
+const QImage* TileCache::find(
+    const TileKey& key, bool* stale /* = 0 */, bool count /* = true */
+) {
+    std::map<TileKey, Entry>::iterator i = tiles.find(key);
+    if (i == tiles.end()) {
+        if (count)
+            ++misses;
+        return 0;
+    }
+    if (stale != 0)
+        *stale = i->second.stale;
+    if (count) {
+        if (i->second.stale)
+            ++misses;
+        else
+            ++hits;
+        lruList.splice(lruList.begin(), lruList, i->second.lru);
+    }
+    return &(i->second.image);
+}
+
+void TileCache::request(
+    const TileKey& key, const std::vector<TileStroke>& strokes
+) {
+    if (isPending(key))
+        return;
+    pending[key] = false;
+    // Later requests (the current view) go first
+    ++priority;
+    pool.start(new TileJob(this, key, strokes, epoch), priority);
+}
+
+const QImage* TileCache::render(
+    const TileKey& key, const std::vector<TileStroke>& strokes
+) {
+    // A job still running for this tile works on older data
+    pending.erase(key);
+    insert(key, rasterize(key, strokes), false);
+    return &(tiles[key].image);
+}
+
+QImage TileCache::rasterize(
+    const TileKey& key, const std::vector<TileStroke>& strokes
+) {
+    QImage image(TILE_SIZE, TILE_SIZE, QImage::Format_RGB32);
+    image.fill(Qt::white);
+
+    R2Rectangle r = tileRect(key);
+    double s = levelScale(key.level);
+    QPainter qp(&image);
+    qp.setRenderHint(QPainter::Antialiasing);
+    qp.scale(s, s);
+    qp.translate(-r.left(), -r.bottom());   // bottom() is the minimal y
+    for (unsigned int i = 0; i < strokes.size(); ++i) {
+        if (strokes[i].filled)
+            qp.fillPath(strokes[i].path, strokes[i].pen.color());
+        else
+            qp.strokePath(strokes[i].path, strokes[i].pen);
+    }
+    qp.end();
+    return image;
+}
+
+void TileCache::invalidate(const R2Rectangle& r) {
+    std::map<TileKey, Entry>::iterator i;
+    for (i = tiles.begin(); i != tiles.end(); ++i) {
+        R2Rectangle t = tileRect(i->first);
+        if (!t.intersect(r).empty())
+            i->second.stale = true;
+    }
+    std::map<TileKey, bool>::iterator j;
+    for (j = pending.begin(); j != pending.end(); ++j) {
+        R2Rectangle t = tileRect(j->first);
+        if (!t.intersect(r).empty())
+            j->second = true;   // Rendered from old data
+    }
+}
+
+void TileCache::clear() {
+    allocCounters[ALLOC_IMAGES].freed(used, (long long) tiles.size());
+    tiles.clear();
+    lruList.clear();
+    pending.clear();
+    ready.clear();
+    used = 0;
+    ++epoch;    // Results of running jobs are dropped
+}
+
+void TileCache::finished(const TileKey& key, const QImage& image, int e) {
+    {
+        QMutexLocker lock(&resultsMutex);
+        Result res;
+        res.key = key;
+        res.image = image;
+        res.epoch = e;
+        results.push_back(res);
+        if (results.size() > 1)
+            return;     // collect() is already posted
+    }
+    QMetaObject::invokeMethod(this, "collect", Qt::QueuedConnection);
+}
+
+void TileCache::collect() {
+    std::vector<Result> done;
+    {
+        QMutexLocker lock(&resultsMutex);
+        done.swap(results);
+    }
+
+    bool changed = false;
+    for (unsigned int i = 0; i < done.size(); ++i) {
+        if (done[i].epoch != epoch)
+            continue;
+        std::map<TileKey, bool>::iterator p = pending.find(done[i].key);
+        if (p == pending.end())
+            continue;   // Superseded by render()
+        bool stale = p->second;
+        pending.erase(p);
+        insert(done[i].key, done[i].image, stale);
+        ready.push_back(done[i].key);
+        changed = true;
+    }
+    if (changed)
+        emit tilesReady();
+}
+
+void TileCache::takeReady(std::vector<TileKey>& keys) {
+    keys.clear();
+    keys.swap(ready);
+}
+
+void TileCache::insert(const TileKey& key, const QImage& image, bool stale) {
+    std::map<TileKey, Entry>::iterator i = tiles.find(key);
+    if (i != tiles.end()) {
+        qint64 size = i->second.image.bytesPerLine() * i->second.image.height();
+        used -= size;
+        allocCounters[ALLOC_IMAGES].freed(size);
+        i->second.image = image;
+        i->second.stale = stale;
+        lruList.splice(lruList.begin(), lruList, i->second.lru);
+    } else {
+        lruList.push_front(key);
+        Entry& e = tiles[key];
+        e.image = image;
+        e.stale = stale;
+        e.lru = lruList.begin();
+    }
+    used += image.bytesPerLine() * image.height();
+    allocCounters[ALLOC_IMAGES].allocated(image.bytesPerLine() * image.height());
+    evict();
+}
+
+void TileCache::evict() {
+    while (used > budget && lruList.size() > 1) {
+        TileKey key = lruList.back();
+        lruList.pop_back();
+        std::map<TileKey, Entry>::iterator i = tiles.find(key);
+        qint64 size = i->second.image.bytesPerLine() * i->second.image.height();
+        used -= size;
+        allocCounters[ALLOC_IMAGES].freed(size);
+        tiles.erase(i);
+        ++evictions;
+    }
+}
@@ -0,0 +1,163 @@
+//
+// Mipmapped tile cache for zoomed-out views. Tiles are rasterized
+// lazily by worker threads at power-of-two scales; until the exact
+// tile is ready, the view is composed from cached tiles of other
+// levels (upscaled or downscaled).
+//
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <QObject>
+#include <QImage>
+#include <QPainterPath>
+#include <QPen>
+#include <QMutex>
+#include <QThreadPool>
+#include <map>
+#include <list>
+#include <vector>
+#include "R2Graph.h"
+
+const int TILE_SIZE = 256;                      // In device pixels
+const int MAX_TILE_LEVEL = 6;                   // Scale 1/64
+const qint64 TILE_CACHE_BUDGET = 64*1024*1024;  // In bytes
+
+class TileKey {
+public:
+    int level;      // Scale is 2^(-level)
+    int x;
+    int y;
+
+    TileKey():
+        level(0),
+        x(0),
+        y(0)
+    {}
+
+    TileKey(int l, int xx, int yy):
+        level(l),
+        x(xx),
+        y(yy)
+    {}
+
+    bool operator<(const TileKey& k) const {
+        if (level != k.level)
+            return level < k.level;
+        if (x != k.x)
+            return x < k.x;
+        return y < k.y;
+    }
+};
+
+// What a worker thread needs to draw a stroke: implicitly shared
+// Qt objects, safe to copy to another thread
+class TileStroke {
+public:
+    QPainterPath path;
+    QPen pen;
+    bool filled;        // An outline filled with the pen color
+
+    TileStroke():
+        path(),
+        pen(),
+        filled(false)
+    {}
+};
+
+class TileCache: public QObject {
+    Q_OBJECT
+
+public:
+    // Statistics
+    long long hits;         // Exact and up to date tile found
+    long long misses;       // Tile missing or stale
+    long long fallbacks;    // Tile of another level shown instead
+    long long evictions;
+
+    TileCache(QObject* parent = 0, qint64 budget = TILE_CACHE_BUDGET);
+    ~TileCache();
+
+    static double levelScale(int level);
+    static int levelForScale(double scale);
+    static R2Rectangle tileRect(const TileKey& key);   // In world
+
+    // Cached image of a tile or 0. A stale image (the page has
+    // changed since) is still returned, with *stale set.
+    // When count is false, statistics and LRU order are not touched.
+    const QImage* find(
+        const TileKey& key, bool* stale = 0, bool count = true
+    );
+
+    bool isPending(const TileKey& key) const {
+        return pending.count(key) > 0;
+    }
+
+    int numPending() const {
+        return (int) pending.size();
+    }
+
+    // Render the tile in background
+    void request(const TileKey& key, const std::vector<TileStroke>& strokes);
+
+    // Render the tile now, e.g. to replace a stale one
+    const QImage* render(
+        const TileKey& key, const std::vector<TileStroke>& strokes
+    );
+
+    static QImage rasterize(
+        const TileKey& key, const std::vector<TileStroke>& strokes
+    );
+
+    // The page has changed inside the world rectangle
+    void invalidate(const R2Rectangle& r);
+    void clear();
+
+    qint64 memoryUsed() const {
+        return used;
+    }
+
+    // Called by a worker thread
+    void finished(const TileKey& key, const QImage& image, int epoch);
+
+    // The tiles inserted since the last call
+    void takeReady(std::vector<TileKey>& keys);
+
+signals:
+    void tilesReady();
+
+public slots:
+    void collect();
+
+private:
+    class Entry {
+    public:
+        QImage image;
+        bool stale;
+        std::list<TileKey>::iterator lru;
+    };
+
+    class Result {
+    public:
+        TileKey key;
+        QImage image;
+        int epoch;
+    };
+
+    std::map<TileKey, Entry> tiles;
+    std::list<TileKey> lruList;         // Most recently used first
+    std::map<TileKey, bool> pending;    // Value: invalidated meanwhile
+    qint64 budget;
+    qint64 used;
+    int epoch;                          // Incremented by clear()
+    int priority;
+
+    QThreadPool pool;
+    QMutex resultsMutex;
+    std::vector<Result> results;        // Finished by workers
+    std::vector<TileKey> ready;         // Collected, not taken yet
+
+    void insert(const TileKey& key, const QImage& image, bool stale);
+    void evict();
+};
+
+#endif
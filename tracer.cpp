@@ -0,0 +1,152 @@
+#include <QThreadStorage>
+#include <unistd.h>
+#include "tracer.h"
+
+QAtomicInt Tracer::enabled(0);
+Tracer* Tracer::instance = 0;
+QMutex Tracer::ringsMutex;
+std::vector<TraceRing*> Tracer::rings;
+int Tracer::lastThreadId = 0;
+
+// QThreadStorage deletes pointers when the thread exits, but the
+// writer may still read the ring: keep the pointer in a value,
+// which only releases the ring
+class ThreadRingRef {
+public:
+    TraceRing* ring;
+
+    ThreadRingRef():
+        ring(0)
+    {}
+
+    ~ThreadRingRef() {
+        if (ring != 0)
+            ring->released.storeRelease(1);
+    }
+};
+
+static QThreadStorage<ThreadRingRef> threadRingRef;
+
+Tracer::Tracer(FILE* f):
+    QThread(),
+    file(f),
+    firstEvent(true),
+    stopping(0)
+{}
+
+TraceRing* Tracer::threadRing() {
+    ThreadRingRef& ref = threadRingRef.localData();
+    if (ref.ring == 0) {
+        QMutexLocker lock(&ringsMutex);
+        for (unsigned int i = 0; i < rings.size(); ++i) {
+            if (rings[i]->reusable()) {
+                // A new track in the trace; the writer reads the id
+                // after the events, which publish it
+                ref.ring = rings[i];
+                ref.ring->threadId = ++lastThreadId;
+                ref.ring->released.storeRelease(0);
+                return ref.ring;
+            }
+        }
+        ref.ring = new TraceRing(++lastThreadId);
+        rings.push_back(ref.ring);
+    }
+    return ref.ring;
+}
+
+void Tracer::record(const char* name, long long start, long long end) {
+    TraceEvent e;
+    e.name = name;
+    e.start = start;
+    e.duration = end - start;
+    threadRing()->push(e);
+}
+
+bool Tracer::startTracing(const char* path) {
+    if (instance != 0)
+        return true;
+    FILE* f = fopen(path, "w");
+    if (f == 0) {
+        perror(path);
+        return false;
+    }
+    fprintf(f, "[\n");
+    {
+        // Drop the spans left from the previous session
+        QMutexLocker lock(&ringsMutex);
+        for (unsigned int i = 0; i < rings.size(); ++i)
+            rings[i]->tail.storeRelease(rings[i]->head.loadAcquire());
+    }
+    instance = new Tracer(f);
+    instance->start();
+    enabled.storeRelease(1);
+    return true;
+}
+
+void Tracer::stopTracing() {
+    if (instance == 0)
+        return;
+    enabled.storeRelease(0);
+    instance->stopping.storeRelease(1);
+    instance->wait();
+    fprintf(instance->file, "\n]\n");
+    fclose(instance->file);
+    delete instance;
+    instance = 0;
+}
+
+bool Tracer::toggleTracing(const char* path) {
+    if (instance != 0) {
+        stopTracing();
+        return false;
+    }
+    return startTracing(path);
+}
+
+void Tracer::run() {
+    while (stopping.loadAcquire() == 0) {
+        msleep(TRACE_FLUSH_INTERVAL);
+        flush();
+    }
+    flush();
+}
+
+void Tracer::flush() {
+    std::vector<TraceRing*> r;
+    {
+        QMutexLocker lock(&ringsMutex);
+        r = rings;
+    }
+    int pid = (int) getpid();
+    for (unsigned int i = 0; i < r.size(); ++i) {
+        TraceRing& ring = *r[i];
+        int t = ring.tail.load();
+        int h = ring.head.loadAcquire();
+        for (; t != h; ++t) {
+            const TraceEvent& e = ring.events[t & (TRACE_RING_SIZE - 1)];
+            fprintf(
+                file,
+                "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                "\"ts\":%lld,\"dur\":%lld}",
+                firstEvent? "" : ",\n",
+                e.name, pid, ring.threadId, e.start, e.duration
+            );
+            firstEvent = false;
+        }
+        ring.tail.storeRelease(h);
+
+        int dropped = ring.dropped.fetchAndStoreRelaxed(0);
+        if (dropped > 0) {
+            // Instant event, to see where the trace has holes
+            fprintf(
+                file,
+                "%s{\"name\":\"dropped %d spans\",\"ph\":\"i\",\"s\":\"t\","
+                "\"pid\":%d,\"tid\":%d,\"ts\":%lld}",
+                firstEvent? "" : ",\n",
+                dropped, pid, ring.threadId, latencyClock()
+            );
+            firstEvent = false;
+        }
+    }
+    fflush(file);
+}
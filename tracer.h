@@ -0,0 +1,128 @@
+//
+// Span profiler writing Chrome trace JSON (chrome://tracing or
+// ui.perfetto.dev). Every thread records its spans into its own
+// lock-free ring buffer; a background thread writes them to the
+// file. Tracing is switched on and off at run time; when it is
+// off, a span costs one atomic load.
+//
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QThread>
+#include <QAtomicInt>
+#include <QMutex>
+#include <stdio.h>
+#include <vector>
+#include "latency.h"
+
+// Events per thread, a power of two
+const int TRACE_RING_SIZE = 16384;
+// How often the rings are written to the file, in milliseconds
+const int TRACE_FLUSH_INTERVAL = 100;
+
+class TraceEvent {
+public:
+    const char* name;       // A string literal
+    long long start;        // Microseconds
+    long long duration;
+};
+
+// Single producer (the owner thread), single consumer (the writer).
+// When its thread exits, the ring is released; once the writer has
+// read it, a new thread takes it over.
+class TraceRing {
+public:
+    int threadId;           // Set by the owner thread
+    QAtomicInt head;        // Next event to write, owner thread only
+    QAtomicInt tail;        // Next event to read, writer thread only
+    QAtomicInt dropped;     // Events lost because the ring was full
+    QAtomicInt released;    // The owner thread has exited
+    TraceEvent events[TRACE_RING_SIZE];
+
+    TraceRing(int tid):
+        threadId(tid),
+        head(0),
+        tail(0),
+        dropped(0),
+        released(0)
+    {}
+
+    // Released and read to the end
+    bool reusable() const {
+        return
+            released.loadAcquire() != 0 &&
+            tail.loadAcquire() == head.load() &&
+            dropped.load() == 0;
+    }
+
+    void push(const TraceEvent& e) {
+        int h = head.load();
+        if ((unsigned int)(h - tail.loadAcquire()) >= TRACE_RING_SIZE) {
+            dropped.fetchAndAddRelaxed(1);
+            return;
+        }
+        events[h & (TRACE_RING_SIZE - 1)] = e;
+        head.storeRelease(h + 1);
+    }
+};
+
+class Tracer: public QThread {
+public:
+    static QAtomicInt enabled;
+
+    static bool isEnabled() {
+        return enabled.load() != 0;
+    }
+
+    // Start writing to the file; return false if it cannot be opened
+    static bool startTracing(const char* path);
+    static void stopTracing();
+    // Return true if tracing is on after the call
+    static bool toggleTracing(const char* path);
+
+    static void record(const char* name, long long start, long long end);
+
+protected:
+    void run();
+
+private:
+    FILE* file;
+    bool firstEvent;
+    QAtomicInt stopping;
+
+    static Tracer* instance;
+    static QMutex ringsMutex;
+    // Reused by new threads, never deleted: short-lived workers
+    // (autosave, export) do not add a ring per run
+    static std::vector<TraceRing*> rings;
+    static int lastThreadId;
+
+    Tracer(FILE* f);
+    static TraceRing* threadRing();
+    void flush();
+};
+
+// Span of the enclosing scope
+class TraceSpan {
+public:
+    TraceSpan(const char* spanName):
+        name(0),
+        start(0)
+    {
+        if (Tracer::isEnabled()) {
+            name = spanName;
+            start = latencyClock();
+        }
+    }
+
+    ~TraceSpan() {
+        if (name != 0)
+            Tracer::record(name, start, latencyClock());
+    }
+
+private:
+    const char* name;
+    long long start;
+};
+
+#endif
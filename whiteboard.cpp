@@ -1,8 +1,11 @@
 //
 // File "whiteboard.cpp"
+// X11 version of the white board; link with -lX11 -lXext
 //
 #include <unistd.h>
 #include <sys/wait.h>
+#include <sys/select.h>
+#include <sys/resource.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
@@ -11,147 +14,81 @@
 #include <vector>
 
 #include "gwindow.h"
+#include "board.h"
+#include "calibration.h"
+#include "jitterfilter.h"
+#include "rasterrenderer.h"
+#include "xbackstore.h"
+#include "latency.h"
 
-static const int DX = 80;
-static const int DY = 80;
-static const int THIN_WIDTH = 1;
-static const int NORMAL_WIDTH = 2;
-static const int THICK_WIDTH = 3;
-static const int VERY_THICK_WIDTH = 5;
-static const int LINE_WIDTH = THICK_WIDTH;
-
-static const int ERASER_WIDTH = 15;
-
-static const int NUM_COLORS = 5;
-/*...
-static const char* const strokeColors[NUM_COLORS] = {
-    "black",
-    "blue",
-    "red",
-    "SeaGreen",
-    "white"     // Eraser color
-};
-...*/
-static unsigned int strokeColors[NUM_COLORS] = {
-    0,
-    1,
-    2,
-    3,
-    4
-};
-const int BLACK_COLOR_IDX = 0;
-const int BLUE_COLOR_IDX = 1;
-const int RED_COLOR_IDX = 2;
-const int GREEN_COLOR_IDX = 3;
-const int ERASER_COLOR_IDX = 4;
-
-class Stroke {
+//--------------------------------------------------
+// Rendering backend drawing with Xlib in a GWindow;
+// colors are the pixel values allocated for the palette
+//
+class XlibRenderer: public RenderBackend {
 public:
-    int color;
-    int width;
-    std::vector<I2Point> points;
-};
+    GWindow* window;
+    const unsigned long* pixels;
 
-class Action {
-public:
-    enum {
-        START_CURVE,
-        DRAW_CURVE,
-        END_CURVE
-    };
-
-    int type;
-    int color;
-    int width;
-    I2Point point;
-
-    Action():
-        type(START_CURVE),
-        color(0),
-        width(LINE_WIDTH),
-        point()
+    XlibRenderer(GWindow* w, const unsigned long* p):
+        window(w),
+        pixels(p)
     {}
 
-    Action(int t, int c, int w, const I2Point& pnt):
-        type(t),
-        color(c),
-        width(w),
-        point(pnt)
-    {}
-};
+    void fillRect(const I2Rectangle& r, int color) {
+        window->setForeground(pixels[color]);
+        window->fillRectangle(r);
+    }
+
+    void drawLine(
+        const I2Point& p0, const I2Point& p1,
+        int lineWidth, int color
+    ) {
+        window->setForeground(pixels[color]);
+        window->setLineWidth(lineWidth);
+        window->drawLine(p0, p1);
+    }
 
-static const int MODE_CALIBRATION = 0;
-static const int MODE_NORMAL = 1;
-static const int NUM_CALIBRATION_POINTS = 2;
-static const int MAX_PAGES = 8;
-
-// Positions of buttons
-static int BUTTON_WIDTH = 70;
-static int BUTTON_WIDTH2 = BUTTON_WIDTH/2;
-static int BUTTON_HEIGHT = 20;
-static int BUTTON_SKIP = 8;
-static int BUTTON_DX = BUTTON_WIDTH + BUTTON_SKIP;
-static int BUTTON_DX2 = BUTTON_WIDTH2 + BUTTON_SKIP;
-
-static const I2Rectangle blackButtonRect(
-    I2Point(10, 10),
-    BUTTON_WIDTH, BUTTON_HEIGHT
-);
-
-static const I2Rectangle redButtonRect(
-    I2Point(10 + BUTTON_DX, 10),
-    BUTTON_WIDTH, BUTTON_HEIGHT
-);
-
-static const I2Rectangle blueButtonRect(
-    I2Point(10 + 2*BUTTON_DX, 10),
-    BUTTON_WIDTH, BUTTON_HEIGHT
-);
-
-static const I2Rectangle greenButtonRect(
-    I2Point(10 + 3*BUTTON_DX, 10),
-    BUTTON_WIDTH, BUTTON_HEIGHT
-);
-
-static const I2Rectangle clearButtonRect(
-    I2Point(10 + 4*BUTTON_DX, 10),
-    BUTTON_WIDTH, BUTTON_HEIGHT
-);
-
-static const I2Rectangle eraseButtonRect(
-    I2Point(10 + 5*BUTTON_DX, 10),
-    BUTTON_WIDTH, BUTTON_HEIGHT
-);
-
-static const I2Rectangle calibrateButtonRect(
-    I2Point(10 + 6*BUTTON_DX, 10),
-    BUTTON_WIDTH, BUTTON_HEIGHT
-);
-
-static const I2Rectangle thinButtonRect(
-    I2Point(10 + 7*BUTTON_DX, 10),
-    BUTTON_WIDTH2, BUTTON_HEIGHT
-);
-
-static const I2Rectangle normalButtonRect(
-    I2Point(10 + 7*BUTTON_DX + BUTTON_DX2, 10),
-    BUTTON_WIDTH2, BUTTON_HEIGHT
-);
-
-static const I2Rectangle thickButtonRect(
-    I2Point(10 + 7*BUTTON_DX + 2*BUTTON_DX2, 10),
-    BUTTON_WIDTH2, BUTTON_HEIGHT
-);
-
-static const I2Rectangle veryThickButtonRect(
-    I2Point(10 + 7*BUTTON_DX + 3*BUTTON_DX2, 10),
-    BUTTON_WIDTH2, BUTTON_HEIGHT
-);
-
-static const I2Rectangle quitButtonRect(
-    I2Point(10 + 7*BUTTON_DX + 4*BUTTON_DX2, 10),
-    BUTTON_WIDTH, BUTTON_HEIGHT
-);
+    void drawText(const I2Point& p, const char* text, int color) {
+        window->setForeground(pixels[color]);
+        window->drawString(p, text);
+    }
+
+    void drawStroke(const Stroke& str, const R2Rectangle* /* clip */) {
+        drawStrokeTail(str, 0);
+    }
+
+    void drawStrokeTail(const Stroke& str, int first) {
+        int n = str.size();
+        if (first >= n)
+            return;
+        window->setForeground(pixels[str.color % NUM_COLORS]);
+        window->setLineWidth(str.width);
+        if (n == 1) {
+            // A single point
+            I2Point p = str.points[0];
+            I2Vector vx(1, 0);
+            I2Vector vy(0, 1);
+            window->drawLine(p-vx, p+vx);
+            window->drawLine(p-vy, p+vy);
+            return;
+        }
+        if (first > 0)
+            --first;
+        if (str.hasPressure()) {
+            // Every segment with the mean width of its ends
+            for (int i = first + 1; i < n; ++i) {
+                double r =
+                    str.radius(str.pressures[i-1]) +
+                    str.radius(str.pressures[i]);
+                window->setLineWidth((int)(r + 0.5));
+                window->drawLine(str.points[i-1], str.points[i]);
+            }
+            return;
+        }
+        window->drawLineStrip(&(str.points[first]), n - first);
+    }
+};
 
 //--------------------------------------------------
 // Definition of our main class "MyWindow"
@@ -161,54 +98,42 @@ public:
     bool finished;
     bool initialUpdate;
 
-    class Page {
-    public:
-        std::vector<Stroke> strokes;
-    };
+    Board board;
 
-    Page pages[MAX_PAGES];
-    int currentPage;
+    int mode;                   // MODE_CALIBRATION / MODE_NORMAL
+    Calibration calibration;
+    InkFilter inkFilter;
 
-    Stroke myDrawing;
-    bool myDrawingActive;
+    // Pixel values of the palette colors
+    unsigned long pixels[NUM_PALETTE_COLORS];
 
-    int mode;                   // MODE_CALIBRATION / MODE_NORMAL
-    int currentColor;           // current color index
-    int currentWidth;           // current line width
-    int lastColor;
-    int lastWidth;
-    I2Point calibrationPoints[NUM_CALIBRATION_POINTS];
-    I2Point calibrationClicks[NUM_CALIBRATION_POINTS];
-    int numCalibrationClicks;
-
-    // Colors
-    unsigned int whiteColor, blackColor, redColor, greenColor, blueColor;
-    unsigned int buttonColor1, buttonColor2, buttonColor3;
-
-    // Mapping
-    double xIntercept, xSlope;
-    double yIntercept, ySlope;
+    // Page image kept on the client side. Strokes are rasterized
+    // into it; Expose only copies it to the window.
+    XBackingStore backStore;
+    bool backStoreFailed;       // Visual not supported: draw with Xlib
+
+    bool prepareBackStore();
+    void renderPage();
+    void setPixels(RasterRenderer& r) const;
 
     void mapMousePoint(const I2Point& mousePoint, I2Point& windowPoint) const;
-    void mapWindowPoint(const I2Point& mousePoint, I2Point& windowPoint) const;
+
+    std::vector<I2Rectangle> staleRects;    // Scratch of flushInk
+
+    // Input to draw latency: the X server times of the input
+    // events not sent to the server as ink yet
+    std::vector<Time> inputTimes;
+    LatencyHistogram inputLatency;
+
+    void inputEvent(Time t);
+    void inkSent();
 
     MyWindow();
     void drawStroke(const Stroke& str);
-    void drawCalibration();
     void drawButtons();
-    void drawButton(
-        const I2Rectangle& rect, 
-        const char* text,
-        unsigned long fgColor,
-        unsigned long bgColor
-    );
-    void drawLineButton(
-        const I2Rectangle& rect, 
-        int lineWidth,
-        unsigned long fgColor,
-        unsigned long bgColor
-    );
     void processAction(const Action& a, bool myAction = true);
+    void flushInk();
+    void redrawStaleInk(RenderBackend& r);
     void init();
 
     virtual void onExpose(XEvent& event);
@@ -225,302 +150,145 @@ public:
 MyWindow::MyWindow():
     finished(false),
     initialUpdate(true),
-    currentPage(0),
-    myDrawing(),
-    myDrawingActive(false),
+    board(),
     mode(MODE_CALIBRATION),
-    currentColor(BLACK_COLOR_IDX),
-    currentWidth(THICK_WIDTH),
-    lastColor(BLACK_COLOR_IDX),
-    lastWidth(THICK_WIDTH),
-    numCalibrationClicks(0),
-
-    // Mapping
-    xIntercept(0.), 
-    xSlope(1.),
-    yIntercept(0.),
-    ySlope(1.)
+    calibration(),
+    inkFilter(),
+    backStore(),
+    backStoreFailed(false),
+    staleRects(),
+    inputTimes(),
+    inputLatency()
 {
-    int x0 = 100, x1 = 500;
-    int y0 = 100, y1 = 400;
-
-    calibrationPoints[0] = I2Point(x0, y0);
-    //... calibrationPoints[1] = I2Point(x1, y0);
-    //... calibrationPoints[2] = I2Point(x0, y1);
-    //... calibrationPoints[3] = I2Point(x1, y1);
-    calibrationPoints[1] = I2Point(x1, y1);
+    for (int i = 0; i < NUM_PALETTE_COLORS; ++i)
+        pixels[i] = 0;
+    // WHITEBOARD_CALIBRATION=n (points) or CxR (grid) calibrates
+    // anew; otherwise the last calibration is loaded if there is one
+    if (!calibration.configure(getenv("WHITEBOARD_CALIBRATION"))) {
+        if (calibration.load(Calibration::cachePath()))
+            mode = MODE_NORMAL;
+    }
+    // WHITEBOARD_FILTER=minCutoff,beta,speedCutoff enables the
+    // jitter filter; empty for the defaults
+    const char* filter = getenv("WHITEBOARD_FILTER");
+    if (filter != 0)
+        inkFilter.configure(filter);
 }
 
 void MyWindow::init() {
-    pages[currentPage].strokes.clear();
-    myDrawingActive = false;
+    board.clearPage();
+    if (backStore.valid())
+        renderPage();
     redraw();
 }
 
 //
 // Process the Expose event: draw in the window
 //
-void MyWindow::onExpose(XEvent& /* event */) {
+void MyWindow::onExpose(XEvent& event) {
     if (initialUpdate) {
-        whiteColor = allocateColor("white");
-        blackColor = allocateColor("black");
-        redColor = allocateColor("red");
-        greenColor = allocateColor("SeaGreen");
-        blueColor = allocateColor("blue");
-
-        buttonColor1 = allocateColor("LightGray");
-        buttonColor2 = blackColor;
-        buttonColor3 = allocateColor("SlateGray3");
-
-        strokeColors[BLACK_COLOR_IDX] = blackColor;
-        strokeColors[BLUE_COLOR_IDX] = blueColor;
-        strokeColors[RED_COLOR_IDX] = redColor;
-        strokeColors[GREEN_COLOR_IDX] = greenColor;
-        strokeColors[ERASER_COLOR_IDX] = whiteColor;
-
+        for (int i = 0; i < NUM_PALETTE_COLORS; ++i) {
+            char name[16];
+            sprintf(name, "#%06x", paletteRgb[i]);
+            pixels[i] = allocateColor(name);
+        }
         initialUpdate = false;
     }
 
+    if (mode != MODE_CALIBRATION && prepareBackStore()) {
+        I2Rectangle r(0, 0, backStore.raster.width, backStore.raster.height);
+        if (event.type == Expose) {
+            r = I2Rectangle(
+                event.xexpose.x, event.xexpose.y,
+                event.xexpose.width, event.xexpose.height
+            );
+        }
+        backStore.put(m_GC, r);
+        // Buttons are not in the backing store
+        if (event.type != Expose || event.xexpose.count == 0)
+            drawButtons();
+        return;
+    }
+
     // Erase a window
     setForeground(getBackground());
     fillRectangle(m_RWinRect);
 
+    XlibRenderer renderer(this, pixels);
     if (mode == MODE_CALIBRATION) {
-        drawCalibration();
+        // Fit the targets to the window until the first click
+        if (calibration.numClicks == 0)
+            calibration.start(m_IWinRect.width(), m_IWinRect.height());
+        calibration.draw(renderer);
     } else {
-        setLineWidth(currentWidth);     // Not necessary...
-        for (
-            unsigned int i = 0; 
-            i < pages[currentPage].strokes.size(); 
-            ++i
-        ) {
-            drawStroke(pages[currentPage].strokes[i]);
-        }
-
-        if (myDrawingActive)
-            drawStroke(myDrawing);
-
+        R2Rectangle all(
+            0., 0., m_IWinRect.width(), m_IWinRect.height()
+        );
+        board.drawPage(renderer, all);
+        board.drawLiveStroke(renderer);
+        board.numDrawnPoints = board.myDrawing.size();
         drawButtons();
     }
 }
 
-void MyWindow::drawStroke(const Stroke& str) {
-    if (str.points.size() == 0)
-        return;
-    int c = str.color % NUM_COLORS;
-    setForeground(strokeColors[c]);
-    setLineWidth(str.width);
-
-    /*...
-    I2Point p = str.points[0];
-    bool drawn = false;
-    moveTo(p);
-    for (unsigned int i = 1; i < str.points.size(); ++i) {
-        if (str.points[i] != p) {
-            drawLineTo(str.points[i]);
-            p = str.points[i];
-            drawn = true;
-        }
-    }
-    if (!drawn) {
-        // A single point
-        I2Vector vx(1, 0);
-        I2Vector vy(0, 1);
-        drawLine(p-vx, p+vx);
-        drawLine(p-vy, p+vy);
-    }
-    ...*/
-
-    if (str.points.size() == 1) {
-        // A single point
-        I2Point p = str.points[0];
-        I2Vector vx(1, 0);
-        I2Vector vy(0, 1);
-        drawLine(p-vx, p+vx);
-        drawLine(p-vy, p+vy);
-    } else {
-        drawLineStrip(
-            &(str.points[0]),
-            (int) str.points.size()
-        );
+// Create the backing store on the first use and when the window
+// size has changed; return false if it cannot be used
+bool MyWindow::prepareBackStore() {
+    if (backStoreFailed)
+        return false;
+    int w = m_IWinRect.width();
+    int h = m_IWinRect.height();
+    if (
+        backStore.valid() &&
+        backStore.raster.width == w && backStore.raster.height == h
+    )
+        return true;
+    if (!backStore.create(m_Display, m_Window, w, h)) {
+        backStoreFailed = true;
+        return false;
     }
+    renderPage();
+    return true;
 }
 
-void MyWindow::drawCalibration() {
-    if (mode != MODE_CALIBRATION)
-        return;
-
-    setForeground("red");
-
-    I2Vector dx(16, 0);
-    I2Vector dy(0, 16);
-    I2Point t = calibrationPoints[numCalibrationClicks];
-    drawString(t - dy*2 - dx*2, "Click in cross:");
-
-    setLineWidth(3);
-    setForeground("blue");
-    drawLine(t - dx, t + dx);
-    drawLine(t - dy, t + dy);
+void MyWindow::renderPage() {
+    backStore.sync();
+    RasterRenderer renderer(&backStore.raster);
+    setPixels(renderer);
+    backStore.raster.fill(renderer.palette[WHITE_COLOR_IDX]);
+    R2Rectangle all(0., 0., backStore.raster.width, backStore.raster.height);
+    board.drawPage(renderer, all);
+    board.drawLiveStroke(renderer);
+    board.numDrawnPoints = board.myDrawing.size();
 }
 
-void MyWindow::drawButtons() {
-    drawButton(
-        blackButtonRect,
-        "Black",
-        // blackColor,
-        // buttonColor3
-        whiteColor,
-        blackColor
-    );
-    drawButton(
-        redButtonRect,
-        "Red",
-        // redColor,
-        // buttonColor3
-        whiteColor,
-        redColor
-    );
-    drawButton(
-        greenButtonRect,
-        "Green",
-        whiteColor,
-        greenColor
-    );
-    drawButton(
-        blueButtonRect,
-        "Blue",
-        whiteColor,
-        blueColor
-    );
-    drawButton(
-        clearButtonRect,
-        "Clear",
-        blackColor,
-        whiteColor
-    );
-    drawButton(
-        eraseButtonRect,
-        "Eraser",
-        blackColor,
-        buttonColor3
-    );
-    drawButton(
-        calibrateButtonRect,
-        "Calibrate",
-        blackColor,
-        buttonColor3
-    );
-    drawButton(
-        quitButtonRect,
-        "Quit",
-        blackColor,
-        buttonColor3
-    );
-
-    drawLineButton(
-        thinButtonRect,
-        THIN_WIDTH,
-        blackColor,
-        whiteColor
-    );
-    drawLineButton(
-        normalButtonRect,
-        NORMAL_WIDTH,
-        blackColor,
-        whiteColor
-    );
-    drawLineButton(
-        thickButtonRect,
-        THICK_WIDTH,
-        blackColor,
-        whiteColor
-    );
-    drawLineButton(
-        veryThickButtonRect,
-        VERY_THICK_WIDTH,
-        blackColor,
-        whiteColor
-    );
-
-    setForeground(strokeColors[currentColor]);
-    setLineWidth(currentWidth);
-    int x = quitButtonRect.right() + BUTTON_SKIP;
-    int y = (
-            calibrateButtonRect.top() +
-            calibrateButtonRect.bottom()
-        ) / 2 - 2;
-    drawLine(
-        x, y, x + BUTTON_WIDTH, y
-    );
+// The raster holds X pixel values
+void MyWindow::setPixels(RasterRenderer& r) const {
+    for (int i = 0; i < NUM_PALETTE_COLORS; ++i)
+        r.palette[i] = (Pixel) pixels[i];
 }
 
-void MyWindow::drawButton(
-    const I2Rectangle& rect, 
-    const char* text,
-    unsigned long fgColor,
-    unsigned long bgColor
-) {
-    setLineWidth(1);
-
-    // setForeground(buttonColor3);
-    setForeground(bgColor);
-    fillRectangle(rect);
-
-    setForeground(buttonColor1);
-    moveTo(rect.left(), rect.bottom());
-    drawLineTo(rect.left(), rect.top());
-    drawLineTo(rect.right(), rect.top());
-
-    setForeground(buttonColor2);
-    drawLineTo(rect.right(), rect.bottom());
-    drawLineTo(rect.left(), rect.bottom());
-
-    setForeground(fgColor);
-    drawString(
-        rect.left() + 8,
-        rect.top() + 14,
-        text
-    );
+void MyWindow::drawStroke(const Stroke& str) {
+    if (backStore.valid()) {
+        backStore.sync();
+        RasterRenderer renderer(&backStore.raster);
+        setPixels(renderer);
+        renderer.drawStroke(str, 0);
+        if (renderer.damaged)
+            backStore.put(m_GC, renderer.damage);
+        return;
+    }
+    XlibRenderer renderer(this, pixels);
+    renderer.drawStroke(str, 0);
 }
 
-void MyWindow::drawLineButton(
-    const I2Rectangle& rect, 
-    int lineWidth,
-    unsigned long fgColor,
-    unsigned long bgColor
-) {
-    setLineWidth(1);
-
-    setForeground(bgColor);
-    fillRectangle(rect);
-
-    setForeground(buttonColor1);
-    moveTo(rect.left(), rect.bottom());
-    drawLineTo(rect.left(), rect.top());
-    drawLineTo(rect.right(), rect.top());
-
-    setForeground(buttonColor2);
-    drawLineTo(rect.right(), rect.bottom());
-    drawLineTo(rect.left(), rect.bottom());
-
-    setForeground(fgColor);
-    setLineWidth(lineWidth);
-    int y = (rect.top() + rect.bottom())/2;
-    drawLine(
-        rect.left() + 2, y,
-        rect.right() - 2, y
-    );
+void MyWindow::drawButtons() {
+    XlibRenderer renderer(this, pixels);
+    board.drawButtons(renderer);
 }
 
 void MyWindow::mapMousePoint(const I2Point& mousePoint, I2Point& windowPoint) const {
-    windowPoint.x = (int)(
-        xIntercept + (double) mousePoint.x * xSlope
-        + 0.49
-    );
-    windowPoint.y = (int)(
-        yIntercept + (double) mousePoint.y * ySlope
-        + 0.49
-    );
+    calibration.map(mousePoint, windowPoint);
 }
 
 //
@@ -542,7 +310,7 @@ void MyWindow::onKeyPress(XEvent& event) {
             init();
         } else if (keyName[0] == 'c' || keyName[0] == 'C') { // 'c' => calibrate
             mode = MODE_CALIBRATION;
-            numCalibrationClicks = 0;
+            calibration.start(m_IWinRect.width(), m_IWinRect.height());
             redraw();
         }
     }
@@ -565,34 +333,11 @@ void MyWindow::onButtonPress(XEvent& event) {
     I2Point t(x, y);
 
     if (mode == MODE_CALIBRATION) {
-        assert(numCalibrationClicks < NUM_CALIBRATION_POINTS);
-        calibrationClicks[numCalibrationClicks] = t;
-        ++numCalibrationClicks;
-
-        if (numCalibrationClicks == NUM_CALIBRATION_POINTS) {
-            int lastClick = NUM_CALIBRATION_POINTS - 1;
-            if (
-                t.x == calibrationPoints[0].x ||
-                t.y == calibrationPoints[0].y
-            )
-                return;
-
-            xSlope =
-                (double)(calibrationPoints[lastClick].x - calibrationPoints[0].x) /
-                (double)(calibrationClicks[lastClick].x - calibrationClicks[0].x);
-            ySlope =
-                (double)(calibrationPoints[lastClick].y - calibrationPoints[0].y) /
-                (double)(calibrationClicks[lastClick].y - calibrationClicks[0].y);
-            // wx = wx0 + (cx - cx0)*sx =
-            //      (wx0 - cx0*sx) + cx*sx;
-            xIntercept = calibrationPoints[0].x - 
-                calibrationClicks[0].x * xSlope;
-            yIntercept = calibrationPoints[0].y -
-                calibrationClicks[0].y * ySlope;
-        }
-
-        if (numCalibrationClicks >= NUM_CALIBRATION_POINTS)
+        if (calibration.addClick(t)) {
             mode = MODE_NORMAL;
+            calibration.report(stderr);
+            calibration.save(Calibration::cachePath());
+        }
         redraw();
         return;
     }
@@ -600,110 +345,29 @@ void MyWindow::onButtonPress(XEvent& event) {
     I2Point wp;
     mapMousePoint(t, wp);
 
-    if (blackButtonRect.contains(wp)) {
-        currentColor = BLACK_COLOR_IDX;
-        lastColor = currentColor;
-        currentWidth = lastWidth;
-        myDrawing.color = currentColor;
-        redraw();
-        return;
-    }
-    if (blueButtonRect.contains(wp)) {
-        currentColor = BLUE_COLOR_IDX;
-        lastColor = currentColor;
-        currentWidth = lastWidth;
-        myDrawing.color = currentColor;
-        redraw();
-        return;
-    }
-    if (redButtonRect.contains(wp)) {
-        currentColor = RED_COLOR_IDX;
-        lastColor = currentColor;
-        myDrawing.color = currentColor;
-        currentWidth = lastWidth;
-        redraw();
-        return;
-    }
-    if (greenButtonRect.contains(wp)) {
-        currentColor = GREEN_COLOR_IDX;
-        lastColor = currentColor;
-        myDrawing.color = currentColor;
-        currentWidth = lastWidth;
-        redraw();
-        return;
-    }
-    if (clearButtonRect.contains(wp)) {
-        currentColor = BLACK_COLOR_IDX; // Black
-        lastColor = currentColor;
-        currentWidth = LINE_WIDTH;
-        init();
-        redraw();
-        return;
-    }
-    if (calibrateButtonRect.contains(wp)) {
-        mode = MODE_CALIBRATION;
-        numCalibrationClicks = 0;
-        redraw();
-        return;
-    }
-    if (eraseButtonRect.contains(wp)) {
-        currentColor = ERASER_COLOR_IDX;
-        currentWidth = ERASER_WIDTH;
-        myDrawing.color = currentColor;
-        myDrawing.width = currentWidth;
-        redraw();
-        return;
-    }
-
-    if (thinButtonRect.contains(wp)) {
-        currentWidth = THIN_WIDTH;
-        lastWidth = currentWidth;
-        currentColor = lastColor;
-        myDrawing.color = currentColor;
-        myDrawing.width = currentWidth;
-        redraw();
-        return;
-    }
-
-    if (normalButtonRect.contains(wp)) {
-        currentWidth = NORMAL_WIDTH;
-        lastWidth = currentWidth;
-        currentColor = lastColor;
-        myDrawing.color = currentColor;
-        myDrawing.width = currentWidth;
-        redraw();
-        return;
-    }
-
-    if (thickButtonRect.contains(wp)) {
-        currentWidth = THICK_WIDTH;
-        lastWidth = currentWidth;
-        currentColor = lastColor;
-        myDrawing.color = currentColor;
-        myDrawing.width = currentWidth;
-        redraw();
-        return;
-    }
-
-    if (veryThickButtonRect.contains(wp)) {
-        currentWidth = VERY_THICK_WIDTH;
-        lastWidth = currentWidth;
-        currentColor = lastColor;
-        myDrawing.color = currentColor;
-        myDrawing.width = currentWidth;
-        redraw();
-        return;
-    }
-
-    if (quitButtonRect.contains(wp)) {
-        destroyWindow();
+    int button = board.buttonAt(wp);
+    if (button >= 0) {
+        if (board.pressButton(button)) {
+            redraw();
+        } else if (button == CLEAR_BUTTON) {
+            init();
+        } else if (button == CALIBRATE_BUTTON) {
+            mode = MODE_CALIBRATION;
+            calibration.start(m_IWinRect.width(), m_IWinRect.height());
+            redraw();
+        } else if (button == QUIT_BUTTON) {
+            destroyWindow();
+        }
         return;
     }
 
+    inputEvent(event.xbutton.time);
+    inkFilter.reset();
+    wp = inkFilter.filter(wp, (double) event.xbutton.time);
     Action a(
         Action::START_CURVE,
-        currentColor,
-        currentWidth,
+        board.currentColor,
+        board.currentWidth,
         wp
     );
     /*...
@@ -726,6 +390,10 @@ void MyWindow::onButtonRelease(XEvent& event) {
     I2Point t(x, y);
     I2Point wp;
     mapMousePoint(t, wp);
+    if (board.myDrawingActive) {
+        inputEvent(event.xbutton.time);
+        wp = inkFilter.filter(wp, (double) event.xbutton.time);
+    }
     Action a(
         Action::END_CURVE,
         0,
@@ -736,13 +404,15 @@ void MyWindow::onButtonRelease(XEvent& event) {
 }
 
 void MyWindow::onMotionNotify(XEvent& event) {
-    if (!myDrawingActive)
+    if (!board.myDrawingActive)
         return;
     int x = event.xbutton.x;
     int y = event.xbutton.y;
     I2Point t(x, y);
     I2Point wp;
     mapMousePoint(t, wp);
+    inputEvent(event.xmotion.time);
+    wp = inkFilter.filter(wp, (double) event.xmotion.time);
     Action a(
         Action::DRAW_CURVE,
         0,
@@ -756,86 +426,159 @@ bool MyWindow::onWindowClosing() {
     return true;
 }
 
+// DRAW_CURVE only stores the point: all the points received in
+// one wakeup of the event loop are drawn by flushInk()
 void MyWindow::processAction(const Action& a, bool /* myAction = true */) {
-    Stroke* curve = &myDrawing;
-    bool* drawingActive = &myDrawingActive;
-
-    if (a.type == Action::START_CURVE) {
-
-        /*
-        printf(
-            "Action: START_CURVE, point=(%d, %d)\n",
-            a.point.x, a.point.y
-        );
-        */
-
-        if (*drawingActive && curve->points.size() > 0) {
-            pages[currentPage].strokes.push_back(*curve);
-            curve->points.clear();
-        }
-        curve->color = a.color;
-        curve->width = a.width;
-        curve->points.push_back(a.point);
-        *drawingActive = true;
-        drawStroke(*curve);
-    } else if (a.type == Action::DRAW_CURVE) {
-        if (!*drawingActive)
-            return;
+    bool ending = (a.type == Action::END_CURVE && board.myDrawingActive);
+    board.processAction(a);
+    board.damage.clear();
+    board.pageDamage.clear();
+
+    if (ending) {
+        const Page& page = board.page();
+        if (!page.strokes.empty())
+            drawStroke(*page.strokes.back());
+        drawButtons();
+    }
+}
 
-        /*
-        printf(
-            "Action: DRAW_CURVE, point=(%d, %d)\n",
-            a.point.x, a.point.y
-        );
-        */
+// Draw the points of the live stroke received since the last call
+// with one request to the X server
+void MyWindow::flushInk() {
+    if (!board.myDrawingActive)
+        return;
+    if (backStore.valid()) {
+        backStore.sync();
+        RasterRenderer renderer(&backStore.raster);
+        setPixels(renderer);
+        board.drawLiveInk(renderer);
+        redrawStaleInk(renderer);
+        backStore.raster.resetClip();
+        if (renderer.damaged)
+            backStore.put(m_GC, renderer.damage);
+        return;
+    }
+    XlibRenderer renderer(this, pixels);
+    board.drawLiveInk(renderer);
+    redrawStaleInk(renderer);
+    XSetClipMask(m_Display, m_GC, None);
+}
 
-        int s = (int) curve->points.size();
-        if (s <= 2) {
-            curve->points.push_back(a.point);
-            drawStroke(*curve);
+// The old segments of the tails moved by the decimator are drawn
+// over: their rectangles are drawn again from the strokes, clipped.
+// The caller resets the clip.
+void MyWindow::redrawStaleInk(RenderBackend& r) {
+    staleRects.clear();
+    board.takeStaleInk(staleRects);
+    for (unsigned int i = 0; i < staleRects.size(); ++i) {
+        const I2Rectangle& d = staleRects[i];
+        if (backStore.valid()) {
+            backStore.raster.resetClip();
+            backStore.raster.setClip(d);
         } else {
-            I2Point lastPoint = curve->points[s-1];
-            if (a.point != lastPoint) {
-                setForeground(strokeColors[curve->color]);
-                setLineWidth(curve->width);
-                curve->points.push_back(a.point);
-                //... drawLine(lastPoint, a.point);
-                drawLineStrip(
-                   &(curve->points[s-3]), 3
-                );
-            }
+            XRectangle clip;
+            clip.x = (short) d.left();
+            clip.y = (short) d.top();
+            clip.width = (unsigned short) d.width();
+            clip.height = (unsigned short) d.height();
+            XSetClipRectangles(m_Display, m_GC, 0, 0, &clip, 1, Unsorted);
         }
-    } else if (a.type == Action::END_CURVE) {
-
-        /*
-        printf(
-            "Action: END_CURVE, point=(%d, %d)\n",
-            a.point.x, a.point.y
+        r.fillRect(d, WHITE_COLOR_IDX);
+        board.drawPage(
+            r, R2Rectangle(d.left(), d.top(), d.width(), d.height())
         );
-        */
-
-        if (*drawingActive && curve->points.size() > 0) {
-
-            /*
-            printf(
-                "Action: END_CURVE, drawing...\n"
-            );
-            */
+        board.drawLiveStroke(r);
+    }
+}
 
-            pages[currentPage].strokes.push_back(*curve);
-            drawStroke(*curve);
+void MyWindow::inputEvent(Time t) {
+    inputTimes.push_back(t);
+}
 
-            curve->points.clear();
-        }
-        *drawingActive = false;
-        drawButtons();
+// The ink of the input events is flushed to the server. The server
+// time is CLOCK_MONOTONIC in milliseconds on Linux; values from a
+// server with another clock are out of range and dropped.
+void MyWindow::inkSent() {
+    if (inputTimes.empty())
+        return;
+    Time now = (Time)(latencyClock() / 1000);
+    for (unsigned int i = 0; i < inputTimes.size(); ++i) {
+        // Server times are 32 bits and wrap around
+        unsigned long d = (unsigned long)(now - inputTimes[i]);
+        d &= 0xffffffffUL;
+        if (d < 10000)
+            inputLatency.record((long long) d * 1000);
     }
+    inputTimes.clear();
 }
 
 //
 // End of class MyWindow implementation
 //----------------------------------------------------------
 
+//----------------------------------------------------------
+// Event loop: sleeps in select() on the X connection until
+// something arrives; return the number of wakeups
+
+static long long runEventLoop(MyWindow& w) {
+    Display* display = GWindow::m_Display;
+    int xfd = ConnectionNumber(display);
+    long long wakeups = 0;
+    XEvent e;
+    while (GWindow::m_NumCreatedWindows > 0) {
+        // Drain everything already queued, so that a burst of
+        // MotionNotify events is handled in one batch
+        while (
+            GWindow::m_NumCreatedWindows > 0 &&
+            XPending(display) > 0
+        ) {
+            XNextEvent(display, &e);
+            if (!w.backStore.handleEvent(e))
+                GWindow::dispatchEvent(e);
+        }
+        if (GWindow::m_NumCreatedWindows <= 0)
+            break;
+        w.flushInk();
+        XFlush(display);
+        w.inkSent();
+
+        fd_set readFds;
+        FD_ZERO(&readFds);
+        FD_SET(xfd, &readFds);
+        select(xfd + 1, &readFds, 0, 0, 0);     // Also returns on EINTR
+        ++wakeups;
+    }
+    return wakeups;
+}
+
+// Wakeups and CPU time of the session, and the input to draw
+// latency, to compare the event loops
+static void reportLoopStats(
+    const MyWindow& w, long long wakeups, double seconds
+) {
+    rusage u;
+    getrusage(RUSAGE_SELF, &u);
+    double cpu =
+        u.ru_utime.tv_sec + u.ru_utime.tv_usec * 1e-6 +
+        u.ru_stime.tv_sec + u.ru_stime.tv_usec * 1e-6;
+    fprintf(
+        stderr,
+        "Event loop: %lld wakeups in %.1f s (%.1f/s), "
+        "CPU %.2f s (%.2f%%)\n",
+        wakeups, seconds, wakeups / seconds, cpu, 100. * cpu / seconds
+    );
+    const LatencyHistogram& h = w.inputLatency;
+    if (h.count > 0) {
+        fprintf(
+            stderr,
+            "Input to draw: %lld events, p50 %lld ms, p99 %lld ms, "
+            "max %lld ms\n",
+            h.count, h.percentile(0.5) / 1000, h.percentile(0.99) / 1000,
+            h.maxValue / 1000
+        );
+    }
+}
+
 /////////////////////////////////////////////////////////////
 // Main: initialize X, create an instance of MyWindow class,
 //       and start the message loop
@@ -864,20 +607,26 @@ int main() {
     w.setBackground("white");
 
     //... GWindow::messageLoop();
-    // Message loop, animation
-    XEvent e;
-    while (GWindow::m_NumCreatedWindows > 0) {
-        if (GWindow::getNextEvent(e)) {
-            GWindow::dispatchEvent(e);
-        } else {
-            // Sleep a bit (we use select for sleeping)
-            timeval dt;
-            dt.tv_sec = 0;
-            dt.tv_usec = 10000; // sleeping time 0.01 sec
-            select(1, 0, 0, 0, &dt);
-        }
+    // Message loop
+    long long start = latencyClock();
+    long long wakeups = runEventLoop(w);
+    reportLoopStats(w, wakeups, (latencyClock() - start) * 1e-6);
+    if (w.backStore.valid()) {
+        // The completions of the last puts; they precede the
+        // destruction of the window in the request stream
+        w.backStore.sync();
+        fprintf(
+            stderr, "Backing store: %s, %lld puts, %lld completed\n",
+            w.backStore.usingShm()? "MIT-SHM" : "XPutImage",
+            w.backStore.numPuts, w.backStore.numCompletions
+        );
+    } else {
+        fprintf(stderr, "Backing store: none, drawn with Xlib\n");
     }
 
+    // Detach the shared memory while the display is still open
+    w.backStore.destroy();
+
     GWindow::closeX();
     return 0;
 }
@@ -1,192 +1,338 @@
 #include <QApplication>
+#include <QGuiApplication>
+#include <QScreen>
 #include "whitebrd.h"
+#include "qtrenderer.h"
+#include "tracer.h"
+#include "actionio.h"
 #include <vector>
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+// Images are accounted in allocCounters[ALLOC_IMAGES]
+static QImage* newImage(int w, int h, QImage::Format format) {
+    QImage* im = new QImage(w, h, format);
+    allocCounters[ALLOC_IMAGES].allocated(
+        (long long) im->bytesPerLine() * im->height()
+    );
+    return im;
+}
 
-const QColor strokeColors[NUM_COLORS] = {
-    Qt::black,
-    Qt::blue,
-    Qt::red,
-    Qt::darkGreen,
-    Qt::white
-};
-
-const int BLACK_COLOR_IDX = 0;
-const int BLUE_COLOR_IDX = 1;
-const int RED_COLOR_IDX = 2;
-const int GREEN_COLOR_IDX = 3;
-const int ERASER_COLOR_IDX = 4;
-
-// Positions of buttons
-static int BUTTON_WIDTH = 70;
-static int BUTTON_WIDTH2 = BUTTON_WIDTH/2;
-static int BUTTON_HEIGHT = 20;
-static int BUTTON_SKIP = 8;
-static int BUTTON_DX = BUTTON_WIDTH + BUTTON_SKIP;
-static int BUTTON_DX2 = BUTTON_WIDTH2 + BUTTON_SKIP;
-
-static const I2Rectangle blackButtonRect(
-    I2Point(10, 10),
-    BUTTON_WIDTH, BUTTON_HEIGHT
-);
-
-static const I2Rectangle redButtonRect(
-    I2Point(10 + BUTTON_DX, 10),
-    BUTTON_WIDTH, BUTTON_HEIGHT
-);
-
-static const I2Rectangle blueButtonRect(
-    I2Point(10 + 2*BUTTON_DX, 10),
-    BUTTON_WIDTH, BUTTON_HEIGHT
-);
-
-static const I2Rectangle greenButtonRect(
-    I2Point(10 + 3*BUTTON_DX, 10),
-    BUTTON_WIDTH, BUTTON_HEIGHT
-);
-
-static const I2Rectangle clearButtonRect(
-    I2Point(10 + 4*BUTTON_DX, 10),
-    BUTTON_WIDTH, BUTTON_HEIGHT
-);
-
-static const I2Rectangle eraseButtonRect(
-    I2Point(10 + 5*BUTTON_DX, 10),
-    BUTTON_WIDTH, BUTTON_HEIGHT
-);
-
-static const I2Rectangle calibrateButtonRect(
-    I2Point(10 + 6*BUTTON_DX, 10),
-    BUTTON_WIDTH, BUTTON_HEIGHT
-);
-
-static const I2Rectangle thinButtonRect(
-    I2Point(10 + 7*BUTTON_DX, 10),
-    BUTTON_WIDTH2, BUTTON_HEIGHT
-);
-
-static const I2Rectangle normalButtonRect(
-    I2Point(10 + 7*BUTTON_DX + BUTTON_DX2, 10),
-    BUTTON_WIDTH2, BUTTON_HEIGHT
-);
-
-static const I2Rectangle thickButtonRect(
-    I2Point(10 + 7*BUTTON_DX + 2*BUTTON_DX2, 10),
-    BUTTON_WIDTH2, BUTTON_HEIGHT
-);
-
-static const I2Rectangle veryThickButtonRect(
-    I2Point(10 + 7*BUTTON_DX + 3*BUTTON_DX2, 10),
-    BUTTON_WIDTH2, BUTTON_HEIGHT
-);
-
-static const I2Rectangle quitButtonRect(
-    I2Point(10 + 7*BUTTON_DX + 4*BUTTON_DX2, 10),
-    BUTTON_WIDTH, BUTTON_HEIGHT
-);
+static void deleteImage(QImage* im) {
+    allocCounters[ALLOC_IMAGES].freed(
+        (long long) im->bytesPerLine() * im->height()
+    );
+    delete im;
+}
 
 WhiteBoard::WhiteBoard(QWidget *parent /* = 0 */):
     QWidget(parent),
+    xmin(0.),
+    xmax(0.),
+    ymin(0.),
+    ymax(0.),
+    xCoeff(1.),
+    yCoeff(1.),
+    panning(false),
+    panLast(),
     image(0),
     imageWidth(0),
     imageHeight(0),
     finished(false),
-    initialUpdate(true),
-    currentPage(0),
-    myDrawing(),
-    myDrawingActive(false),
+    board(),
     mode(MODE_CALIBRATION),
-    currentColor(BLACK_COLOR_IDX),
-    currentWidth(THICK_WIDTH),
-    lastColor(BLACK_COLOR_IDX),
-    lastWidth(THICK_WIDTH),
-    numCalibrationClicks(0),
-
-    // Mapping
-    xIntercept(0.), 
-    xSlope(1.),
-    yIntercept(0.),
-    ySlope(1.)
+    calibration(),
+    lassoActive(false),
+    lasso(),
+    selection(),
+    hidden(),
+    selectionRect(),
+    sprite(0),
+    dragging(false),
+    dragCopy(false),
+    dragStart(),
+    dragOffset(),
+    tiles(),
+    referenceDrawing(false),
+    frameTimer(),
+    framePeriod(0),
+    nextFrame(0),
+    pendingEvents(0),
+    idleFrames(0),
+    inkFrames(0),
+    inkEvents(0),
+    maxEventsPerFrame(0),
+    predictor(),
+    predictionAhead(0.),
+    predictionVisible(false),
+    predictedPoint(),
+    predictionRect(),
+    traceFile(0),
+    inkFilter(),
+    tabletDrawing(false),
+    touchFilters(),
+    inkRects(),
+    staleRects(),
+    latency(0),
+    inputTime(0),
+    latencyHud(false),
+    latencyDump(0),
+    profilePath("whiteboard-trace.json"),
+    recordFile(0),
+    inputThread(0),
+    script(0),
+    scriptNotifiers(),
+    scriptActions(),
+    scriptInkPending(false),
+    scriptStrokes(),
+    exportPath("whiteboard.pdf"),
+    exportView(false),
+    exporter(0),
+    exportTitle(),
+    autosavePath(0),
+    autosaveTimer(),
+    autoSaver(0),
+    savedVersion(0),
+    savingVersion(0)
 {
-    int x0 = 100, x1 = 500;
-    int y0 = 100, y1 = 400;
-    calibrationPoints[0] = I2Point(x0, y0);
-    calibrationPoints[1] = I2Point(x1, y1);
+    board.showSelectButton = true;
+    setAttribute(Qt::WA_AcceptTouchEvents);
+    for (int i = 0; i < EVENTS_PER_FRAME_BUCKETS; ++i)
+        eventsPerFrame[i] = 0;
+    connect(&tiles, SIGNAL(tilesReady()), this, SLOT(onTilesReady()));
+    frameTimer.setTimerType(Qt::PreciseTimer);
+    frameTimer.setSingleShot(true);
+    connect(&frameTimer, SIGNAL(timeout()), this, SLOT(onFrame()));
+
+    // WHITEBOARD_PREDICT=ms enables the predicted ink
+    const char* predict = getenv("WHITEBOARD_PREDICT");
+    if (predict != 0) {
+        predictionAhead = atof(predict);
+        if (*predict == 0)
+            predictionAhead = DEFAULT_PREDICTION_AHEAD;
+    }
+    // WHITEBOARD_FILTER=minCutoff,beta,speedCutoff enables the
+    // jitter filter; empty for the defaults
+    const char* filter = getenv("WHITEBOARD_FILTER");
+    if (filter != 0)
+        inkFilter.configure(filter);
+    // WHITEBOARD_TRACE=file records the input points
+    const char* trace = getenv("WHITEBOARD_TRACE");
+    if (trace != 0 && *trace != 0) {
+        traceFile = fopen(trace, "a");
+        if (traceFile == 0)
+            perror(trace);
+    }
+    // WHITEBOARD_LATENCY=file ("-" for stderr) writes the latency
+    // report at exit, WHITEBOARD_HUD=1 shows it on the screen
+    const char* dump = getenv("WHITEBOARD_LATENCY");
+    if (dump != 0 && *dump != 0)
+        latencyDump = dump;
+    const char* hud = getenv("WHITEBOARD_HUD");
+    latencyHud = (hud != 0 && *hud != 0 && strcmp(hud, "0") != 0);
+    if (latencyDump != 0 || latencyHud)
+        latency = new LatencyStats();
+    // WHITEBOARD_PROFILE=file traces from the start; F12 switches
+    // tracing on and off
+    const char* profile = getenv("WHITEBOARD_PROFILE");
+    if (profile != 0 && *profile != 0) {
+        profilePath = profile;
+        Tracer::startTracing(profilePath);
+    }
+    // WHITEBOARD_EXPORT=file.{png,svg,pdf} for F9; every page
+    // covers all its strokes, or the view with WHITEBOARD_EXPORT_VIEW=1
+    const char* exportFile = getenv("WHITEBOARD_EXPORT");
+    if (exportFile != 0 && *exportFile != 0)
+        exportPath = exportFile;
+    const char* view = getenv("WHITEBOARD_EXPORT_VIEW");
+    exportView = (view != 0 && *view != 0 && strcmp(view, "0") != 0);
+    // WHITEBOARD_AUTOSAVE=file restores the board from the file and
+    // saves it there every WHITEBOARD_AUTOSAVE_INTERVAL seconds
+    const char* autosave = getenv("WHITEBOARD_AUTOSAVE");
+    if (autosave != 0 && *autosave != 0) {
+        autosavePath = autosave;
+        restoreAutosave();
+        int interval = DEFAULT_AUTOSAVE_INTERVAL;
+        const char* s = getenv("WHITEBOARD_AUTOSAVE_INTERVAL");
+        if (s != 0 && atoi(s) > 0)
+            interval = atoi(s);
+        connect(&autosaveTimer, SIGNAL(timeout()), this, SLOT(onAutosave()));
+        autosaveTimer.start(interval * 1000);
+    }
+    // WHITEBOARD_CALIBRATION=n (points) or CxR (grid) calibrates
+    // anew; otherwise the last calibration is loaded if there is one
+    if (!calibration.configure(getenv("WHITEBOARD_CALIBRATION"))) {
+        if (calibration.load(Calibration::cachePath()))
+            mode = MODE_NORMAL;
+    }
+    // WHITEBOARD_RECORD=file records the actions for renderhash
+    const char* record = getenv("WHITEBOARD_RECORD");
+    if (record != 0 && *record != 0) {
+        recordFile = fopen(record, "w");
+        if (recordFile == 0)
+            perror(record);
+    }
+    // WHITEBOARD_INPUT=/dev/input/eventN reads the pen on a thread
+    // of its own; WHITEBOARD_INPUT=file replays an action stream
+    // there at WHITEBOARD_INPUT_RATE samples per second
+    const char* input = getenv("WHITEBOARD_INPUT");
+    if (input != 0 && *input != 0) {
+        const char* rate = getenv("WHITEBOARD_INPUT_RATE");
+        inputThread = InputThread::open(
+            input, (rate != 0)? atoi(rate) : DEFAULT_REPLAY_RATE,
+            this, "onInputReady"
+        );
+        if (inputThread != 0)
+            inputThread->start();
+    }
+    // WHITEBOARD_SCRIPT=- (stdin), a FIFO, a file or unix:socket
+    // takes scripted actions in text or binary form
+    const char* scriptSpec = getenv("WHITEBOARD_SCRIPT");
+    if (scriptSpec != 0 && *scriptSpec != 0)
+        openScript(scriptSpec);
+}
+
+WhiteBoard::~WhiteBoard() {
+    if (image != 0)
+        deleteImage(image);
+    if (sprite != 0)
+        deleteImage(sprite);
+    if (traceFile != 0)
+        fclose(traceFile);
+    if (recordFile != 0)
+        fclose(recordFile);
+    if (exporter != 0) {
+        exporter->requestInterruption();
+        exporter->wait();
+        delete exporter;
+    }
+    if (autoSaver != 0) {
+        // The last complete save stays
+        autoSaver->requestInterruption();
+        delete autoSaver;
+    }
+    delete inputThread;
+    delete script;
+    delete latency;
 }
 
 QPointF WhiteBoard::map(QPointF p) const {
     return QPointF(
         (p.x() - xmin)*xCoeff,
-        (ymax - p.y())*yCoeff
+        (p.y() - ymin)*yCoeff
     );
 }
 
 QPointF WhiteBoard::invMap(QPointF p) const {
     return QPointF(
         xmin + p.x()/xCoeff,
-        ymax - p.y()/yCoeff
+        ymin + p.y()/yCoeff
     );
 }
 
-void WhiteBoard::mapMousePoint(const I2Point& mousePoint, I2Point& windowPoint) const {
-    windowPoint.x = (int)(
-        xIntercept + (double) mousePoint.x * xSlope
-        + 0.49
+I2Point WhiteBoard::touchWindowPoint(
+    const QTouchEvent::TouchPoint& p
+) const {
+    I2Point wp;
+    mapMousePoint(
+        I2Point((int) floor(p.pos().x() + 0.5), (int) floor(p.pos().y() + 0.5)),
+        wp
+    );
+    return wp;
+}
+
+I2Point WhiteBoard::worldPoint(const I2Point& windowPoint) const {
+    QPointF p = invMap(QPointF(windowPoint.x, windowPoint.y));
+    return I2Point(
+        (int) floor(p.x() + 0.5),
+        (int) floor(p.y() + 0.5)
     );
-    windowPoint.y = (int)(
-        yIntercept + (double) mousePoint.y * ySlope
-        + 0.49
+}
+
+Action WhiteBoard::inkAction(
+    int type, const I2Point& windowPoint,
+    int pressure /* = NO_PRESSURE */, int touchId /* = NO_TOUCH */
+) const {
+    QPointF p = invMap(QPointF(windowPoint.x, windowPoint.y));
+    unsigned char fraction;
+    I2Point q = splitPoint(R2Point(p.x(), p.y()), fraction);
+    Action a(type, 0, 0, q, pressure, touchId);
+    if (type == Action::START_CURVE) {
+        a.color = board.currentColor;
+        a.width = board.currentWidth;
+    }
+    a.fraction = fraction;
+    return a;
+}
+
+void WhiteBoard::updateViewRect() {
+    xmax = xmin + width()/xCoeff;
+    ymax = ymin + height()/yCoeff;
+}
+
+QTransform WhiteBoard::viewTransform() const {
+    return QTransform(
+        xCoeff, 0.,
+        0., yCoeff,
+        -xmin*xCoeff, -ymin*yCoeff
     );
 }
 
+R2Rectangle WhiteBoard::viewRect() const {
+    return R2Rectangle(xmin, ymin, xmax - xmin, ymax - ymin);
+}
+
+void WhiteBoard::mapMousePoint(const I2Point& mousePoint, I2Point& windowPoint) const {
+    calibration.map(mousePoint, windowPoint);
+}
+
 void WhiteBoard::paintEvent(QPaintEvent*) {
+    TraceSpan span("paintEvent");
+    long long paintStart = (latency != 0)? latencyClock() : 0;
     QPainter qp(this);
     qp.setRenderHint(QPainter::Antialiasing);
 
     int w = width();
     int h = height();
 
-    if (initialUpdate) {
-        whiteColor = Qt::white;
-        blackColor = Qt::black;
-        redColor = Qt::red;
-        greenColor = Qt::darkGreen;
-        blueColor = Qt::blue;
-
-        buttonColor1 = Qt::lightGray;
-        buttonColor2 = blackColor;
-        buttonColor3 = QColor(0x9f, 0xb6, 0xcd); // SlateGray3 #9fb6cd
-
-        initialUpdate = false;
-    }
-
     if (mode == MODE_CALIBRATION) {
         // Erase a window
         qp.setBrush(QBrush(Qt::white));
         qp.drawRect(0, 0, w, h);
 
-        drawCalibration(&qp);
+        QtRenderer r(&qp);
+        calibration.draw(r);
     } else {
         if (image != 0) {
             qp.drawImage(0, 0, *image);
+            drawPrediction(&qp);
+            drawSelection(&qp);
         } else {
-            for (
-                unsigned int i = 0;
-                i < pages[currentPage].strokes.size();
-                ++i
-            ) {
-                drawStroke(&qp, pages[currentPage].strokes.at(i));
+            qp.setTransform(viewTransform());
+            {
+                QtRenderer r(&qp);
+                board.drawPage(r, viewRect(), &hidden);
+                board.drawLiveStroke(r);
             }
-
-            if (myDrawingActive)
-                drawStroke(&qp, myDrawing);
+            qp.resetTransform();
 
             drawButtons(&qp);
         }
+        if (latencyHud)
+            drawLatencyHud(&qp);
+    }
+
+    if (latency != 0 && !latency->drawn.empty()) {
+        qp.end();
+        long long t = latencyClock();
+        latency->stages[LATENCY_BLIT].record(t - paintStart);
+        latency->frameShown(t);
     }
 }
 
 void WhiteBoard::drawInOffscreen() {
+    TraceSpan span("drawInOffscreen");
     if (
         image == 0 || 
         imageWidth != width() || 
@@ -206,186 +352,785 @@ void WhiteBoard::drawInOffscreen() {
     qp.drawRect(0, 0, w, h);
 
     assert(mode != MODE_CALIBRATION);
-    for (
-        unsigned int i = 0;
-        i < pages[currentPage].strokes.size();
-        ++i
-    ) {
-        drawStroke(&qp, pages[currentPage].strokes.at(i));
+    if (useTiles())
+        drawTiles(&qp, QRect(0, 0, w, h));
+    qp.setTransform(viewTransform());
+    {
+        QtRenderer r(&qp, !referenceDrawing);
+        if (!useTiles())
+            board.drawPage(r, viewRect(), &hidden);
+        board.drawLiveStroke(r);
     }
 
-    if (myDrawingActive)
-        drawStroke(&qp, myDrawing);
-
+    qp.resetTransform();
     drawButtons(&qp);
 }
 
-void WhiteBoard::drawLastCurveInOffscreen() {
-    if (!myDrawingActive || image == 0)
+// Redraw a rectangle of the window in the offscreen image
+void WhiteBoard::drawRegionInOffscreen(const QRect& r) {
+    if (image == 0 || r.isEmpty())
         return;
     QPainter qp(image);
     qp.setRenderHint(QPainter::Antialiasing);
-    drawStroke(&qp, myDrawing);
+    qp.setClipRect(r);
+    qp.fillRect(r, Qt::white);
+
+    QPointF p0 = invMap(QPointF(r.left(), r.top()));
+    QPointF p1 = invMap(QPointF(r.right() + 1, r.bottom() + 1));
+    R2Rectangle world(p0.x(), p0.y(), p1.x() - p0.x(), p1.y() - p0.y());
+
+    if (useTiles())
+        drawTiles(&qp, r);
+    qp.setTransform(viewTransform());
+    {
+        QtRenderer renderer(&qp, !referenceDrawing);
+        if (!useTiles())
+            board.drawPage(renderer, world, &hidden);
+        board.drawLiveStroke(renderer);
+    }
+    qp.resetTransform();
+    drawButtons(&qp);
 }
 
-void WhiteBoard::mousePressEvent(QMouseEvent* event) {
-    int x = event->x();
-    int y = event->y();
-    I2Point t(x, y);
+// Zoomed out views are composed from tiles, unless some strokes
+// are dragged (the tiles contain them)
+bool WhiteBoard::useTiles() const {
+    return xCoeff < 1. && hidden.empty() && !referenceDrawing;
+}
 
-    if (mode == MODE_CALIBRATION) {
-        assert(numCalibrationClicks < NUM_CALIBRATION_POINTS);
-        calibrationClicks[numCalibrationClicks] = t;
-        ++numCalibrationClicks;
-
-        if (numCalibrationClicks == NUM_CALIBRATION_POINTS) {
-            int lastClick = NUM_CALIBRATION_POINTS - 1;
-            if (
-                t.x == calibrationPoints[0].x ||
-                t.y == calibrationPoints[0].y
-            )
-                return;
-
-            xSlope =
-                (double)(calibrationPoints[lastClick].x - calibrationPoints[0].x) /
-                (double)(calibrationClicks[lastClick].x - calibrationClicks[0].x);
-            ySlope =
-                (double)(calibrationPoints[lastClick].y - calibrationPoints[0].y) /
-                (double)(calibrationClicks[lastClick].y - calibrationClicks[0].y);
-            // wx = wx0 + (cx - cx0)*sx =
-            //      (wx0 - cx0*sx) + cx*sx;
-            xIntercept = calibrationPoints[0].x - 
-                calibrationClicks[0].x * xSlope;
-            yIntercept = calibrationPoints[0].y -
-                calibrationClicks[0].y * ySlope;
+static int floorDiv(int a, int b) {
+    return (a >= 0)? a / b : -((-a - 1) / b) - 1;
+}
+
+// Compose a rectangle of the window from cached tiles; missing
+// tiles are requested in background and meanwhile replaced by
+// cached tiles of other levels
+void WhiteBoard::drawTiles(QPainter* qp, const QRect& r) {
+    int level = TileCache::levelForScale(xCoeff);
+    double size = TILE_SIZE / TileCache::levelScale(level);
+    QPointF w0 = invMap(QPointF(r.left(), r.top()));
+    QPointF w1 = invMap(QPointF(r.right() + 1, r.bottom() + 1));
+    int tx0 = (int) floor(w0.x() / size);
+    int tx1 = (int) floor(w1.x() / size);
+    int ty0 = (int) floor(w0.y() / size);
+    int ty1 = (int) floor(w1.y() / size);
+
+    qp->setRenderHint(QPainter::SmoothPixmapTransform);
+    std::vector<TileStroke> strokes;
+    for (int ty = ty0; ty <= ty1; ++ty) {
+        for (int tx = tx0; tx <= tx1; ++tx) {
+            TileKey key(level, tx, ty);
+            // Rounded corners, so that neighbours share edges
+            R2Rectangle wr = TileCache::tileRect(key);
+            QPointF d0 = map(QPointF(wr.left(), wr.bottom()));
+            QPointF d1 = map(QPointF(wr.right(), wr.top()));
+            int x0 = (int) floor(d0.x() + 0.5);
+            int y0 = (int) floor(d0.y() + 0.5);
+            QRect target(
+                x0, y0,
+                (int) floor(d1.x() + 0.5) - x0,
+                (int) floor(d1.y() + 0.5) - y0
+            );
+
+            bool stale = false;
+            const QImage* img = tiles.find(key, &stale);
+            if (img != 0 && stale) {
+                // Changed by editing: a few tiles, render them now
+                makeTileStrokes(key, strokes);
+                img = tiles.render(key, strokes);
+            } else if (img == 0 && !tiles.isPending(key)) {
+                makeTileStrokes(key, strokes);
+                tiles.request(key, strokes);
+            }
+            if (img != 0) {
+                qp->drawImage(target, *img, img->rect());
+                continue;
+            }
+
+            // Coarser ancestor, upscaled
+            bool shown = false;
+            for (int l = level + 1; !shown && l <= MAX_TILE_LEVEL; ++l) {
+                int k = 1 << (l - level);
+                TileKey parent(l, floorDiv(tx, k), floorDiv(ty, k));
+                const QImage* p = tiles.find(parent, 0, false);
+                if (p == 0)
+                    continue;
+                int sub = TILE_SIZE / k;
+                QRect source(
+                    (tx - parent.x*k) * sub, (ty - parent.y*k) * sub,
+                    sub, sub
+                );
+                qp->drawImage(target, *p, source);
+                shown = true;
+            }
+
+            // Finer children, downscaled
+            for (int i = 0; !shown && level > 0 && i < 4; ++i) {
+                TileKey child(level - 1, 2*tx + i%2, 2*ty + i/2);
+                const QImage* c = tiles.find(child, 0, false);
+                if (c == 0)
+                    continue;
+                int hw = target.width() / 2;
+                int hh = target.height() / 2;
+                QRect quarter(
+                    target.left() + (i%2)*hw, target.top() + (i/2)*hh,
+                    (i%2)? target.width() - hw : hw,
+                    (i/2)? target.height() - hh : hh
+                );
+                qp->drawImage(quarter, *c, c->rect());
+                // The other children are drawn as well
+                for (int j = i + 1; j < 4; ++j) {
+                    TileKey other(level - 1, 2*tx + j%2, 2*ty + j/2);
+                    const QImage* o = tiles.find(other, 0, false);
+                    if (o == 0)
+                        continue;
+                    QRect q(
+                        target.left() + (j%2)*hw, target.top() + (j/2)*hh,
+                        (j%2)? target.width() - hw : hw,
+                        (j/2)? target.height() - hh : hh
+                    );
+                    qp->drawImage(q, *o, o->rect());
+                }
+                shown = true;
+            }
+
+            if (shown)
+                ++tiles.fallbacks;
         }
+    }
+}
 
-        if (numCalibrationClicks >= NUM_CALIBRATION_POINTS)
-            mode = MODE_NORMAL;
+// Collect what a worker needs to draw the strokes of a tile
+void WhiteBoard::makeTileStrokes(
+    const TileKey& key, std::vector<TileStroke>& res
+) {
+    res.clear();
+    R2Rectangle wr = TileCache::tileRect(key);
+    int margin = ERASER_WIDTH;
+    I2Rectangle query(
+        (int) floor(wr.left()) - margin, (int) floor(wr.bottom()) - margin,
+        (int) ceil(wr.width()) + 2*margin, (int) ceil(wr.height()) + 2*margin
+    );
+    const Page& page = board.page();
+    std::vector<int> found;
+    page.grid.query(query, found);
+
+    double scale = TileCache::levelScale(key.level);
+    for (unsigned int k = 0; k < found.size(); ++k) {
+        const Stroke& str = *page.strokes[found[k]];
+        int w = str.margin();
+        if (
+            str.bbox.right() + w < wr.left() ||
+            str.bbox.left() - w > wr.right() ||
+            str.bbox.bottom() + w < wr.bottom() ||
+            str.bbox.top() - w > wr.top()
+        )
+            continue;
+
+        TileStroke ts;
+        ts.pen = QPen(paletteColor(str.color % NUM_COLORS));
+        ts.pen.setWidth(str.width);
+        if (str.hasPressure()) {
+            int l = str.levelForScale(scale);
+            const QtStrokePaths& paths = strokePaths(str);
+            ts.path = (l < 0)? paths.path : paths.levels[l];
+            ts.filled = true;
+        } else if (str.size() == 1) {
+            // A single point: a small cross, as in drawStroke
+            R2Point p = str.exactPoint(0);
+            ts.path.moveTo(QPointF(p.x - 1, p.y));
+            ts.path.lineTo(QPointF(p.x + 1, p.y));
+            ts.path.moveTo(QPointF(p.x, p.y - 1));
+            ts.path.lineTo(QPointF(p.x, p.y + 1));
+        } else {
+            int l = str.levelForScale(scale);
+            const QtStrokePaths& paths = strokePaths(str);
+            ts.path = (l < 0)? paths.path : paths.levels[l];
+        }
+        res.push_back(ts);
+    }
+}
+
+void WhiteBoard::invalidateTiles(const I2Rectangle& r) {
+    int m = ERASER_WIDTH;
+    tiles.invalidate(R2Rectangle(
+        r.left() - m, r.top() - m, r.width() + 2*m, r.height() + 2*m
+    ));
+}
+
+// Compose only the window rectangles of the tiles that have
+// arrived: they replace fallbacks there and nowhere else
+void WhiteBoard::onTilesReady() {
+    std::vector<TileKey> ready;
+    tiles.takeReady(ready);
+    if (mode == MODE_CALIBRATION || !useTiles())
+        return;
+    if (image == 0 || imageWidth != width() || imageHeight != height()) {
+        drawInOffscreen();
         update();
         return;
     }
+    QRect window(0, 0, width(), height());
+    for (unsigned int i = 0; i < ready.size(); ++i) {
+        R2Rectangle wr = TileCache::tileRect(ready[i]);
+        QPointF d0 = map(QPointF(wr.left(), wr.bottom()));
+        QPointF d1 = map(QPointF(wr.right(), wr.top()));
+        QRect r = QRectF(d0, d1).toAlignedRect().intersected(window);
+        if (r.isEmpty())
+            continue;   // Requested for a view left since
+        drawRegionInOffscreen(r);
+        update(r);
+    }
+}
 
-    I2Point wp;
-    mapMousePoint(t, wp);
+// Draw the points of the live strokes added since the last frame
+// and repaint only the rectangles they cover: one per stroke, so
+// that the fingers far apart do not repaint everything between
+// them. Qt merges the rectangles into the region of the next
+// paint event.
+void WhiteBoard::drawLastCurveInOffscreen() {
+    TraceSpan span("drawLastCurveInOffscreen");
+    if (!board.drawingActive() || image == 0)
+        return;
+    inkRects.clear();
+    {
+        QPainter qp(image);
+        qp.setRenderHint(QPainter::Antialiasing);
+        qp.setTransform(viewTransform());
+        QtRenderer r(&qp);
+        board.drawLiveInk(r, &inkRects);
+    }
+    for (unsigned int i = 0; i < inkRects.size(); ++i)
+        update(windowRect(inkRects[i]));
+    redrawStaleInk();
+    board.damage.clear();
+}
 
-    if (blackButtonRect.contains(wp)) {
-        currentColor = BLACK_COLOR_IDX;
-        lastColor = currentColor;
-        currentWidth = lastWidth;
-        myDrawing.color = currentColor;
-        drawCurrentLineType();
-        update();
+void WhiteBoard::startFrameTimer() {
+    idleFrames = 0;
+    if (frameTimer.isActive())
+        return;
+    double rate = 60.;
+    QScreen* screen = QGuiApplication::primaryScreen();
+    if (screen != 0 && screen->refreshRate() > 1.)
+        rate = screen->refreshRate();
+    framePeriod = (long long) floor(1e6 / rate + 0.5);
+    nextFrame = latencyClock();
+    scheduleFrame();
+}
+
+// Start the timer for the first multiple of the period after now;
+// missed ticks are skipped
+void WhiteBoard::scheduleFrame() {
+    long long now = latencyClock();
+    do {
+        nextFrame += framePeriod;
+    } while (nextFrame <= now);
+    frameTimer.start((int)((nextFrame - now + 500) / 1000));
+}
+
+void WhiteBoard::countFrame() {
+    if (pendingEvents == 0)
+        return;
+    ++inkFrames;
+    inkEvents += pendingEvents;
+    if (pendingEvents > maxEventsPerFrame)
+        maxEventsPerFrame = pendingEvents;
+    int bucket = pendingEvents;
+    if (bucket >= EVENTS_PER_FRAME_BUCKETS)
+        bucket = EVENTS_PER_FRAME_BUCKETS - 1;
+    ++eventsPerFrame[bucket];
+    pendingEvents = 0;
+}
+
+void WhiteBoard::onFrame() {
+    // Before the input is drained, which restarts an idle timer
+    scheduleFrame();
+    drainInput();
+    drawScriptInk();
+    if (pendingEvents == 0) {
+        // The pen stays: its predicted motion is wrong
+        if (++idleFrames >= MAX_PREDICTION_IDLE_FRAMES)
+            clearPrediction();
+        // Do not wake up when nobody draws
+        if (idleFrames >= MAX_IDLE_FRAMES)
+            frameTimer.stop();
         return;
     }
-    if (blueButtonRect.contains(wp)) {
-        currentColor = BLUE_COLOR_IDX;
-        lastColor = currentColor;
-        currentWidth = lastWidth;
-        myDrawing.color = currentColor;
-        drawCurrentLineType();
-        update();
+    idleFrames = 0;
+    if (latency != 0) {
+        long long t = latencyClock();
+        latency->frameStarted(t);
+        drawLastCurveInOffscreen();
+        latency->stages[LATENCY_RASTER].record(latencyClock() - t);
+        if (latencyHud)
+            update(0, height() - 24, width(), 24);
+    } else {
+        drawLastCurveInOffscreen();
+    }
+    updatePrediction();
+    countFrame();
+}
+
+// The input thread has pushed samples into an empty ring
+void WhiteBoard::onInputReady() {
+    startFrameTimer();
+}
+
+// Everything the input thread has acquired since the last frame,
+// in order. Device points go the way of the mouse points:
+// calibration, buttons, jitter filter.
+void WhiteBoard::drainInput() {
+    if (inputThread == 0)
         return;
+    inputThread->wakeHandled();
+    InputSample s;
+    while (inputThread->ring.pop(s)) {
+        I2Point p = s.point;
+        Action a;
+        if (!inputThread->worldCoordinates) {
+            // The device covers the screen; the calibration maps it
+            // onto the window
+            I2Point t(
+                (int)((long long)(p.x - inputThread->xMin) * (width() - 1) /
+                    (inputThread->xMax - inputThread->xMin)),
+                (int)((long long)(p.y - inputThread->yMin) * (height() - 1) /
+                    (inputThread->yMax - inputThread->yMin))
+            );
+            if (mode == MODE_CALIBRATION) {
+                if (s.type == Action::START_CURVE)
+                    calibrationClick(t);
+                continue;
+            }
+            I2Point wp;
+            mapMousePoint(t, wp);
+            if (s.type == Action::START_CURVE) {
+                int button = board.buttonAt(wp);
+                if (button >= 0) {
+                    pressButton(button);
+                    continue;
+                }
+                inkFilter.reset();
+            }
+            wp = inkFilter.filter(wp, (double) s.time * 1e-3);
+            a = inkAction(s.type, wp, s.pressure, s.touchId);
+        } else if (mode == MODE_CALIBRATION) {
+            continue;
+        } else {
+            a = Action(s.type, 0, 0, p, s.pressure, s.touchId);
+            if (s.type == Action::START_CURVE) {
+                a.color = board.currentColor;
+                a.width = board.currentWidth;
+            }
+            a.fraction = s.fraction;
+        }
+
+        inputTime = s.time;
+        processAction(a);
+        if (s.type == Action::START_CURVE && s.touchId == NO_TOUCH)
+            predictor.reset();
+        if (s.touchId == NO_TOUCH && s.type != Action::END_CURVE) {
+            addInputSample(
+                subpixelPoint(a.point, a.fraction),
+                (unsigned long)(s.time / 1000)
+            );
+        }
     }
-    if (redButtonRect.contains(wp)) {
-        currentColor = RED_COLOR_IDX;
-        lastColor = currentColor;
-        myDrawing.color = currentColor;
-        currentWidth = lastWidth;
-        drawCurrentLineType();
-        update();
+    int dropped = inputThread->ring.dropped.fetchAndStoreRelaxed(0);
+    if (dropped > 0)
+        fprintf(stderr, "Input ring overflow: %d samples dropped\n", dropped);
+}
+
+void WhiteBoard::openScript(const char* spec) {
+    script = ScriptInput::open(spec);
+    if (script == 0)
         return;
+    if (script->listenFd >= 0)
+        watchScriptSource(script->listenFd, SLOT(onScriptClient(int)));
+    else
+        watchScriptSource(script->sourceFd, SLOT(onScriptInput(int)));
+}
+
+void WhiteBoard::watchScriptSource(int fd, const char* slot) {
+    QSocketNotifier* n = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(n, SIGNAL(activated(int)), this, slot);
+    scriptNotifiers.push_back(n);
+}
+
+void WhiteBoard::onScriptClient(int /* fd */) {
+    int client = script->acceptClient();
+    if (client >= 0)
+        watchScriptSource(client, SLOT(onScriptInput(int)));
+}
+
+// Everything a source has is one batch
+void WhiteBoard::onScriptInput(int fd) {
+    TraceSpan span("onScriptInput");
+    scriptActions.clear();
+    bool open = script->read(fd, scriptActions);
+    applyScript(scriptActions);
+    if (open)
+        return;
+    for (unsigned int i = 0; i < scriptNotifiers.size(); ++i) {
+        if (scriptNotifiers[i]->socket() == fd) {
+            scriptNotifiers[i]->setEnabled(false);
+            scriptNotifiers[i]->deleteLater();
+            scriptNotifiers.erase(scriptNotifiers.begin() + i);
+            break;
+        }
     }
-    if (greenButtonRect.contains(wp)) {
-        currentColor = GREEN_COLOR_IDX;
-        lastColor = currentColor;
-        myDrawing.color = currentColor;
-        currentWidth = lastWidth;
-        drawCurrentLineType();
-        update();
+}
+
+// Scripted actions go to the board without the per-event work
+// of processAction; their ink is drawn by the next frame, once
+// for all the batches since the last one
+void WhiteBoard::applyScript(const std::vector<Action>& actions) {
+    if (actions.empty())
         return;
+    scriptInkPending = true;
+    for (unsigned int i = 0; i < actions.size(); ++i) {
+        if (recordFile != 0)
+            writeAction(recordFile, actions[i]);
+        board.processAction(actions[i]);
+        if (!board.pageDamage.empty) {
+            // A stroke committed by the script
+            scriptStrokes.push_back(board.pageDamage.rect);
+            invalidateTiles(board.pageDamage.rect);
+            board.pageDamage.clear();
+        }
     }
-    if (clearButtonRect.contains(wp)) {
-        currentColor = BLACK_COLOR_IDX; // Black
-        lastColor = currentColor;
-        currentWidth = LINE_WIDTH;
-        drawCurrentLineType();
-        init();
-        update();
+    board.damage.clear();
+    startFrameTimer();
+}
+
+// The ink of the scripted batches is drawn over the offscreen
+// image: the new points of the live strokes, then the regions of
+// the strokes committed since the last frame, redrawn from the
+// page. Nothing else is redrawn, so the cost follows the new
+// points, not the page.
+void WhiteBoard::drawScriptInk() {
+    if (!scriptInkPending || mode == MODE_CALIBRATION || image == 0)
         return;
+    TraceSpan span("drawScriptInk");
+    scriptInkPending = false;
+    inkRects.clear();
+    {
+        QPainter qp(image);
+        qp.setRenderHint(QPainter::Antialiasing);
+        qp.setTransform(viewTransform());
+        QtRenderer r(&qp);
+        board.drawLiveInk(r, &inkRects);
     }
-    if (calibrateButtonRect.contains(wp)) {
-        mode = MODE_CALIBRATION;
-        numCalibrationClicks = 0;
-        update();
+
+    bool toolbar = false;
+    for (unsigned int i = 0; i < inkRects.size(); ++i) {
+        QRect r = windowRect(inkRects[i]);
+        if (r.top() < TOOLBAR_BOTTOM)
+            toolbar = true;
+        update(r);
+    }
+    if (toolbar) {
+        // The buttons stay above the ink
+        QPainter qp(image);
+        drawButtons(&qp);
+    }
+    redrawStaleInk();
+}
+
+// The window rectangle of a world rectangle, with a margin for
+// rounding
+QRect WhiteBoard::windowRect(const I2Rectangle& world) const {
+    QPointF p0 = map(QPointF(world.left(), world.top()));
+    QPointF p1 = map(QPointF(world.right(), world.bottom()));
+    return QRectF(
+        p0.x(), p0.y(), p1.x() - p0.x(), p1.y() - p0.y()
+    ).toAlignedRect().adjusted(-2, -2, 2, 2);
+}
+
+// Redraw from the strokes what the incremental ink has left wrong:
+// the old segments of moved tails and the committed script strokes
+// (drawn in pieces while they were live). After the live ink, so
+// that these regions end up as a full redraw would draw them.
+void WhiteBoard::redrawStaleInk() {
+    staleRects.clear();
+    board.takeStaleInk(staleRects);
+    staleRects.insert(
+        staleRects.end(), scriptStrokes.begin(), scriptStrokes.end()
+    );
+    scriptStrokes.clear();
+    QRect window(0, 0, width(), height());
+    for (unsigned int i = 0; i < staleRects.size(); ++i) {
+        QRect r = windowRect(staleRects[i]).intersected(window);
+        drawRegionInOffscreen(r);
+        update(r);
+    }
+}
+
+// Input point of the live stroke with its event time
+void WhiteBoard::addInputSample(const R2Point& p, unsigned long time) {
+    predictor.addSample(p, (double) time);
+    if (traceFile != 0) {
+        fprintf(
+            traceFile, "%lu %d %d\n",
+            time, (int) floor(p.x + 0.5), (int) floor(p.y + 0.5)
+        );
+    }
+}
+
+// Replace the predicted ink of the previous frame
+void WhiteBoard::updatePrediction() {
+    clearPrediction();
+    if (
+        predictionAhead <= 0. ||
+        !board.myDrawingActive || board.myDrawing.size() == 0
+    )
+        return;
+    if (!predictor.predict(predictionAhead, predictedPoint))
+        return;
+
+    R2Point last = board.myDrawing.exactPoint(board.myDrawing.size() - 1);
+    QPointF p0 = map(QPointF(last.x, last.y));
+    QPointF p1 = map(QPointF(predictedPoint.x, predictedPoint.y));
+    int w = (int) ceil(board.myDrawing.margin() * fabs(xCoeff)) + 1;
+    predictionRect = QRectF(p0, p1).normalized().toAlignedRect().adjusted(
+        -w, -w, w, w
+    );
+    predictionVisible = true;
+    update(predictionRect);
+}
+
+// The offscreen image has no predicted ink: repainting the
+// rectangle removes it
+void WhiteBoard::clearPrediction() {
+    if (!predictionVisible)
+        return;
+    predictionVisible = false;
+    update(predictionRect);
+}
+
+void WhiteBoard::drawPrediction(QPainter* qp) {
+    if (!predictionVisible || !board.myDrawingActive)
+        return;
+    const Stroke& str = board.myDrawing;
+    R2Point last = str.exactPoint(str.size() - 1);
+    QPen pen(paletteColor(str.color % NUM_COLORS));
+    if (str.hasPressure())
+        pen.setWidthF(2. * str.radius(str.pressures.back()));
+    else
+        pen.setWidth(str.width);
+    pen.setCapStyle(Qt::RoundCap);
+    qp->setTransform(viewTransform());
+    qp->setPen(pen);
+    qp->drawLine(
+        QPointF(last.x, last.y),
+        QPointF(predictedPoint.x, predictedPoint.y)
+    );
+    qp->resetTransform();
+}
+
+// One line at the bottom of the window
+void WhiteBoard::drawLatencyHud(QPainter* qp) {
+    char text[128];
+    latency->summary(text, sizeof(text));
+    QRect r(0, height() - 24, width(), 24);
+    qp->fillRect(r, QColor(255, 255, 255, 200));
+    qp->setPen(Qt::darkGray);
+    qp->drawText(8, height() - 8, text);
+}
+
+void WhiteBoard::dumpLatency() const {
+    if (latency == 0 || latencyDump == 0)
+        return;
+    if (strcmp(latencyDump, "-") == 0) {
+        latency->report(stderr);
         return;
     }
-    if (eraseButtonRect.contains(wp)) {
-        currentColor = ERASER_COLOR_IDX;
-        currentWidth = ERASER_WIDTH;
-        myDrawing.color = currentColor;
-        myDrawing.width = currentWidth;
-        update();
+    FILE* f = fopen(latencyDump, "w");
+    if (f == 0) {
+        perror(latencyDump);
         return;
     }
+    latency->report(f);
+    fclose(f);
+}
 
-    if (thinButtonRect.contains(wp)) {
-        currentWidth = THIN_WIDTH;
-        lastWidth = currentWidth;
-        currentColor = lastColor;
-        myDrawing.color = currentColor;
-        myDrawing.width = currentWidth;
-        drawCurrentLineType();
-        update();
+// Shift the pixels of the offscreen image by (dx, dy)
+void WhiteBoard::scrollImage(int dx, int dy) {
+    assert(image != 0);
+    int w = imageWidth - abs(dx);
+    int h = imageHeight - abs(dy);
+    if (w <= 0 || h <= 0)
         return;
+    int srcX = (dx < 0)? -dx : 0;
+    int dstX = (dx > 0)? dx : 0;
+    int bpl = image->bytesPerLine();
+    uchar* bits = image->bits();
+    if (dy > 0) {
+        // Rows move down: copy from the bottom
+        for (int y = h - 1; y >= 0; --y) {
+            memmove(
+                bits + (y + dy)*bpl + dstX*4,
+                bits + y*bpl + srcX*4,
+                w*4
+            );
+        }
+    } else {
+        for (int y = 0; y < h; ++y) {
+            memmove(
+                bits + y*bpl + dstX*4,
+                bits + (y - dy)*bpl + srcX*4,
+                w*4
+            );
+        }
     }
+}
 
-    if (normalButtonRect.contains(wp)) {
-        currentWidth = NORMAL_WIDTH;
-        lastWidth = currentWidth;
-        currentColor = lastColor;
-        myDrawing.color = currentColor;
-        myDrawing.width = currentWidth;
-        drawCurrentLineType();
+// Move the view so that the picture shifts by (dx, dy) pixels
+void WhiteBoard::pan(int dx, int dy) {
+    if (dx == 0 && dy == 0)
+        return;
+    xmin -= dx/xCoeff;
+    ymin -= dy/yCoeff;
+    updateViewRect();
+
+    int w = imageWidth;
+    int h = imageHeight;
+    if (image == 0 || abs(dx) >= w || abs(dy) >= h) {
+        drawInOffscreen();
         update();
         return;
     }
 
-    if (thickButtonRect.contains(wp)) {
-        currentWidth = THICK_WIDTH;
-        lastWidth = currentWidth;
-        currentColor = lastColor;
-        myDrawing.color = currentColor;
-        myDrawing.width = currentWidth;
-        drawCurrentLineType();
-        update();
+    // Reuse the shifted pixels, render only the exposed strips
+    scrollImage(dx, dy);
+    if (dx > 0)
+        drawRegionInOffscreen(QRect(0, 0, dx, h));
+    else if (dx < 0)
+        drawRegionInOffscreen(QRect(w + dx, 0, -dx, h));
+    if (dy > 0)
+        drawRegionInOffscreen(QRect(0, 0, w, dy));
+    else if (dy < 0)
+        drawRegionInOffscreen(QRect(0, h + dy, w, -dy));
+
+    // The buttons have moved with the picture: redraw their band
+    int band = TOOLBAR_BOTTOM;
+    if (dy > 0)
+        band += dy;
+    drawRegionInOffscreen(QRect(0, 0, w, band));
+    update();
+}
+
+// Zoom by factor, keeping the world point under center in place
+void WhiteBoard::zoom(double factor, const I2Point& center) {
+    double z = xCoeff*factor;
+    if (z < MIN_ZOOM)
+        z = MIN_ZOOM;
+    if (z > MAX_ZOOM)
+        z = MAX_ZOOM;
+    QPointF c = invMap(QPointF(center.x, center.y));
+    xCoeff = z;
+    yCoeff = z;
+    // Half a device pixel
+    board.decimationTolerance = DECIMATION_TOLERANCE / (z > 1.? z : 1.);
+    xmin = c.x() - center.x/xCoeff;
+    ymin = c.y() - center.y/yCoeff;
+    updateViewRect();
+
+    if (!selection.empty() && !dragging)
+        createSprite();     // Rasterized at the new scale
+    drawInOffscreen();
+    update();
+}
+
+void WhiteBoard::mousePressEvent(QMouseEvent* event) {
+    int x = event->x();
+    int y = event->y();
+    I2Point t(x, y);
+
+    if (mode == MODE_CALIBRATION) {
+        calibrationClick(t);
         return;
     }
 
-    if (veryThickButtonRect.contains(wp)) {
-        currentWidth = VERY_THICK_WIDTH;
-        lastWidth = currentWidth;
-        currentColor = lastColor;
-        myDrawing.color = currentColor;
-        myDrawing.width = currentWidth;
-        drawCurrentLineType();
+    I2Point wp;
+    mapMousePoint(t, wp);
+
+    if (event->button() == Qt::RightButton || event->button() == Qt::MiddleButton) {
+        panning = true;
+        panLast = wp;
+        return;
+    }
+
+    int button = board.buttonAt(wp);
+    if (button == SELECT_BUTTON) {
+        board.selectMode = !board.selectMode;
+        clearSelection();
+        drawInOffscreen();
+        update();
+        return;
+    }
+    if (board.selectMode && wp.y < buttonRects[BLACK_BUTTON].bottom()) {
+        // Any other button leaves the select tool
+        board.selectMode = false;
+        clearSelection();
+        drawInOffscreen();
+    }
+    if (board.selectMode) {
+        I2Point p = worldPoint(wp);
+        if (!selection.empty() && selectionRect.contains(p)) {
+            startDrag(p, (event->modifiers() & Qt::ControlModifier) != 0);
+        } else {
+            clearSelection();
+            drawInOffscreen();
+            lasso.clear();
+            lasso.push_back(p);
+            lassoActive = true;
+        }
         update();
         return;
     }
 
-    if (quitButtonRect.contains(wp)) {
-        QApplication::instance()->quit();
+    if (button >= 0) {
+        pressButton(button);
         return;
     }
 
-    Action a(
-        Action::START_CURVE,
-        currentColor,
-        currentWidth,
-        wp
-    );
+    inkFilter.reset();
+    wp = inkFilter.filter(wp, (double) event->timestamp());
+    Action a = inkAction(Action::START_CURVE, wp);
 
     processAction(a);
+    tabletDrawing = false;
+    predictor.reset();
+    addInputSample(subpixelPoint(a.point, a.fraction), event->timestamp());
+}
+
+void WhiteBoard::calibrationClick(const I2Point& t) {
+    if (calibration.addClick(t)) {
+        mode = MODE_NORMAL;
+        calibration.report(stderr);
+        calibration.save(Calibration::cachePath());
+    }
+    update();
+}
+
+void WhiteBoard::pressButton(int button) {
+    if (board.pressButton(button)) {
+        drawCurrentLineType();
+        update();
+        return;
+    }
+    if (button == CLEAR_BUTTON) {
+        drawCurrentLineType();
+        init();
+        update();
+    } else if (button == CALIBRATE_BUTTON) {
+        mode = MODE_CALIBRATION;
+        calibration.start(width(), height());
+        update();
+    } else if (button == QUIT_BUTTON) {
+        QApplication::instance()->quit();
+    }
 }
 
 void WhiteBoard::mouseReleaseEvent(QMouseEvent* event) {
@@ -398,414 +1143,572 @@ void WhiteBoard::mouseReleaseEvent(QMouseEvent* event) {
 
     I2Point wp;
     mapMousePoint(t, wp);
-    Action a(
-        Action::END_CURVE,
-        0,
-        0,
-        wp
-    );
-    processAction(a);
+
+    if (panning) {
+        pan(wp.x - panLast.x, wp.y - panLast.y);
+        panning = false;
+        return;
+    }
+
+    if (board.selectMode) {
+        I2Point p = worldPoint(wp);
+        if (lassoActive) {
+            lasso.push_back(p);
+            lasso.finish();
+            lassoActive = false;
+            selectStrokes();
+        } else if (dragging) {
+            dragOffset = p - dragStart;
+            drop();
+        }
+        update();
+        return;
+    }
+
+    if (board.myDrawingActive)
+        wp = inkFilter.filter(wp, (double) event->timestamp());
+    processAction(inkAction(Action::END_CURVE, wp));
+    if (traceFile != 0)
+        fprintf(traceFile, "\n");
 }
 
 void WhiteBoard::mouseMoveEvent(QMouseEvent* event) {
-    if (!myDrawingActive)
+    if (panning) {
+        I2Point wp;
+        mapMousePoint(I2Point(event->x(), event->y()), wp);
+        pan(wp.x - panLast.x, wp.y - panLast.y);
+        panLast = wp;
         return;
+    }
+
+    if (board.selectMode && mode != MODE_CALIBRATION) {
+        I2Point wp;
+        mapMousePoint(I2Point(event->x(), event->y()), wp);
+        I2Point p = worldPoint(wp);
+        if (lassoActive) {
+            lasso.push_back(p);
+            update();
+        } else if (dragging) {
+            // The sprite is only shifted: nothing is rasterized
+            dragOffset = p - dragStart;
+            update();
+        }
+        return;
+    }
+
+    if (!board.myDrawingActive)
+        return;
+    if (latency != 0)
+        inputTime = latencyClock();
 
     int x = event->x();
     int y = event->y();
     I2Point t(x, y);
     I2Point wp;
     mapMousePoint(t, wp);
-    Action a(
-        Action::DRAW_CURVE,
-        0,
-        0,
-        wp
-    );
+    wp = inkFilter.filter(wp, (double) event->timestamp());
+    Action a = inkAction(Action::DRAW_CURVE, wp);
+    addInputSample(subpixelPoint(a.point, a.fraction), event->timestamp());
     processAction(a);
 }
 
-void WhiteBoard::resizeEvent(QResizeEvent* /* event */) {
-    if (image != 0) {
-        delete image; image = 0;
+// Pen strokes with pressure. Everything else (buttons, selection,
+// calibration, panning) is left to the mouse events that Qt
+// synthesizes from the ignored tablet events.
+void WhiteBoard::tabletEvent(QTabletEvent* event) {
+    QEvent::Type type = event->type();
+    bool drawing = board.myDrawingActive && tabletDrawing;
+    if (
+        mode == MODE_CALIBRATION || panning || board.selectMode ||
+        (type != QEvent::TabletPress && !drawing)
+    ) {
+        event->ignore();
+        return;
     }
-    allocateImage();
-    if (mode != MODE_CALIBRATION)
-        drawInOffscreen();
-}
+    if (latency != 0)
+        inputTime = latencyClock();
 
-void WhiteBoard::processAction(const Action& a) {
-    Stroke* curve = &myDrawing;
-    //... QPainter qp(this);
-    //... qp.begin(this);
-    //... qp.setRenderHint(QPainter::Antialiasing);
-
-    if (a.type == Action::START_CURVE) {
+    I2Point wp;
+    mapMousePoint(I2Point(event->x(), event->y()), wp);
+    int pressure = (int) floor(event->pressure() * MAX_PRESSURE + 0.5);
+    if (pressure < 0)
+        pressure = 0;
+    else if (pressure > MAX_PRESSURE)
+        pressure = MAX_PRESSURE;
+
+    if (type == QEvent::TabletPress) {
+        if (event->button() != Qt::LeftButton || board.buttonAt(wp) >= 0) {
+            event->ignore();
+            return;
+        }
+        inkFilter.reset();
+        wp = inkFilter.filter(wp, (double) event->timestamp());
+        Action a = inkAction(Action::START_CURVE, wp, pressure);
+        processAction(a);
+        tabletDrawing = true;
+        predictor.reset();
+        addInputSample(subpixelPoint(a.point, a.fraction), event->timestamp());
+    } else if (type == QEvent::TabletMove) {
+        wp = inkFilter.filter(wp, (double) event->timestamp());
+        Action a = inkAction(Action::DRAW_CURVE, wp, pressure);
+        addInputSample(subpixelPoint(a.point, a.fraction), event->timestamp());
+        processAction(a);
+    } else if (type == QEvent::TabletRelease) {
+        wp = inkFilter.filter(wp, (double) event->timestamp());
+        // The pen leaves with no pressure: keep the last width
+        processAction(inkAction(Action::END_CURVE, wp, NO_PRESSURE));
+        tabletDrawing = false;
+        if (traceFile != 0)
+            fprintf(traceFile, "\n");
+    }
+    event->accept();
+}
 
-        /*
-        printf(
-            "Action: START_CURVE, point=(%d, %d)\n",
-            a.point.x, a.point.y
-        );
-        */
+bool WhiteBoard::event(QEvent* event) {
+    QEvent::Type type = event->type();
+    if (
+        type == QEvent::TouchBegin || type == QEvent::TouchUpdate ||
+        type == QEvent::TouchEnd || type == QEvent::TouchCancel
+    )
+        return touchEvent(static_cast<QTouchEvent*>(event));
+    return QWidget::event(event);
+}
 
-        if (myDrawingActive && curve->size() > 0) {
-            pages[currentPage].strokes.push_back(*curve);
-            curve->clear();
+// Every finger draws its own stroke. A touch that begins on a
+// button, in the calibration or with the select tool is left to
+// the mouse events that Qt synthesizes from it.
+bool WhiteBoard::touchEvent(QTouchEvent* event) {
+    QEvent::Type type = event->type();
+    if (type == QEvent::TouchCancel) {
+        cancelTouches();
+        event->accept();
+        return true;
+    }
+    const QList<QTouchEvent::TouchPoint>& points = event->touchPoints();
+    if (type == QEvent::TouchBegin) {
+        bool drawing =
+            mode != MODE_CALIBRATION && !panning && !board.selectMode;
+        for (int i = 0; drawing && i < points.size(); ++i) {
+            if (board.buttonAt(touchWindowPoint(points.at(i))) >= 0)
+                drawing = false;
         }
-        curve->color = a.color;
-        curve->width = a.width;
-        curve->push_back(a.point);
-        myDrawingActive = true;
-        //... drawLastCurveInOffscreen();
-    } else if (a.type == Action::DRAW_CURVE) {
-        if (!myDrawingActive) {
-            return;
+        if (!drawing) {
+            event->ignore();
+            return false;
+        }
+    }
+    if (latency != 0)
+        inputTime = latencyClock();
+
+    double t = (double) event->timestamp();
+    for (int i = 0; i < points.size(); ++i) {
+        const QTouchEvent::TouchPoint& tp = points.at(i);
+        int id = tp.id();
+        Qt::TouchPointState state = tp.state();
+        if (state == Qt::TouchPointStationary)
+            continue;
+        I2Point wp = touchWindowPoint(tp);
+        if (state == Qt::TouchPointPressed) {
+            if (board.buttonAt(wp) >= 0)
+                continue;       // Buttons only work with the first finger
+            InkFilter& filter = touchFilters[id];
+            filter = inkFilter;
+            filter.reset();
+            wp = filter.filter(wp, t);
+            processAction(inkAction(Action::START_CURVE, wp, NO_PRESSURE, id));
+            continue;
+        }
+        std::map<int, InkFilter>::iterator f = touchFilters.find(id);
+        if (f == touchFilters.end())
+            continue;           // Not drawing
+        wp = f->second.filter(wp, t);
+        if (state == Qt::TouchPointReleased) {
+            processAction(inkAction(Action::END_CURVE, wp, NO_PRESSURE, id));
+            touchFilters.erase(f);
+        } else {
+            processAction(inkAction(Action::DRAW_CURVE, wp, NO_PRESSURE, id));
         }
+    }
+    event->accept();
+    return true;
+}
 
-        /*
-        printf(
-            "Action: DRAW_CURVE, point=(%d, %d)\n",
-            a.point.x, a.point.y
+// The touches were taken away, e.g. by a system gesture: the
+// strokes end where the fingers were last seen
+void WhiteBoard::cancelTouches() {
+    while (!board.touchStrokes.empty()) {
+        std::map<int, TouchStroke>::iterator i = board.touchStrokes.begin();
+        const Stroke& str = i->second.stroke;
+        Action a(
+            Action::END_CURVE, 0, 0, str.points.back(), NO_PRESSURE, i->first
         );
-        */
-
-        curve->push_back(a.point);
-        drawLastCurveInOffscreen();
-
-    } else if (a.type == Action::END_CURVE) {
+        a.fraction = str.fraction(str.size() - 1);
+        processAction(a);
+    }
+    touchFilters.clear();
+}
 
-        /*
-        printf(
-            "Action: END_CURVE, point=(%d, %d)\n",
-            a.point.x, a.point.y
-        );
-        */
+void WhiteBoard::wheelEvent(QWheelEvent* event) {
+    if (mode == MODE_CALIBRATION)
+        return;
+    I2Point wp;
+    mapMousePoint(I2Point(event->x(), event->y()), wp);
+    // One wheel step (120 units) zooms by 1.25
+    zoom(pow(1.25, event->angleDelta().y() / 120.), wp);
+}
 
-        if (myDrawingActive && curve->size() > 0) {
-            curve->push_back(a.point);
-            curve->finalize();
-            //... drawLastCurveInOffscreen();
+void WhiteBoard::keyPressEvent(QKeyEvent* event) {
+    if (event->key() == Qt::Key_F9) {
+        startExport();
+        return;
+    }
+    if (event->key() == Qt::Key_F12) {
+        if (Tracer::toggleTracing(profilePath))
+            fprintf(stderr, "Tracing to %s\n", profilePath);
+        else
+            fprintf(stderr, "Tracing stopped\n");
+        return;
+    }
+    QWidget::keyPressEvent(event);
+}
 
-            /*
-            printf(
-                "Action: END_CURVE, drawing...\n"
-            );
-            */
+// The exporter gets a snapshot of the pages, which shares their
+// strokes, and writes it on a low-priority thread while drawing
+// goes on; progress is shown in the window title
+void WhiteBoard::startExport() {
+    if (exporter != 0) {
+        fprintf(stderr, "Export to %s in progress\n", exportPath);
+        return;
+    }
+    int format = BoardExporter::formatOf(exportPath);
+    if (format < 0) {
+        fprintf(stderr, "%s: export to .png, .svg or .pdf\n", exportPath);
+        return;
+    }
+    TraceSpan span("startExport");
+    exporter = new BoardExporter();
+    board.takeSnapshot(exporter->snapshot);
+    exporter->path = exportPath;
+    exporter->format = format;
+    exporter->world = viewRect();
+    exporter->viewOnly = exportView;
+    // The view as it is on the screen; the whole pages at 1:1
+    exporter->scale = exportView? xCoeff : 1.;
+    connect(
+        exporter, SIGNAL(progress(int, int)),
+        this, SLOT(onExportProgress(int, int))
+    );
+    connect(exporter, SIGNAL(finished()), this, SLOT(onExportFinished()));
+    exportTitle = window()->windowTitle();
+    exporter->start(QThread::LowPriority);
+}
 
-            pages[currentPage].strokes.push_back(*curve);
-            drawInOffscreen();
+void WhiteBoard::onExportProgress(int done, int total) {
+    if (exporter == 0)
+        return;
+    window()->setWindowTitle(
+        exportTitle + " - exporting " +
+        QString::number((int)((long long) done * 100 / total)) + "%"
+    );
+}
 
-            curve->clear();
-        }
-        myDrawingActive = false;
-        //... drawButtons(&qp);
+// The snapshot is released here, on the GUI thread: strokes that
+// are no longer on the board are deleted with their path caches
+void WhiteBoard::onExportFinished() {
+    if (exporter == 0)
+        return;
+    exporter->wait();
+    if (exporter->ok) {
+        fprintf(
+            stderr, "Exported %d page(s) to %s\n",
+            exporter->numPages, exportPath
+        );
+    } else {
+        fprintf(stderr, "Export to %s failed\n", exportPath);
     }
-
-    update();
+    delete exporter;
+    exporter = 0;
+    window()->setWindowTitle(exportTitle);
 }
 
-void WhiteBoard::drawLine(
-    QPainter* qp,
-    const I2Point& p0, const I2Point& p1
-) {
-    QPointF t0(p0.x, p0.y);
-    QPointF t1(p1.x, p1.y);
-    qp->drawLine(t0, t1);
+void WhiteBoard::restoreAutosave() {
+    FILE* f = fopen(autosavePath, "r");
+    if (f == 0)
+        return;     // Nothing saved yet
+    if (!loadBoard(f, autosavePath, board))
+        fprintf(stderr, "%s: board partly restored\n", autosavePath);
+    fclose(f);
+    savedVersion = board.version();
 }
 
-/*...
-void WhiteBoard::drawLineStrip(
-    QPainter* qp,
-    const I2Point* nodes,
-    int numNodes
-) {
-    if (numNodes <= 0)
+// Only the snapshot is taken here, in O(1); the strokes are written
+// by the saver thread while drawing goes on
+void WhiteBoard::onAutosave() {
+    if (autoSaver != 0 || board.version() == savedVersion)
         return;
+    TraceSpan span("onAutosave");
+    autoSaver = new AutoSaver();
+    board.takeSnapshot(autoSaver->snapshot);
+    autoSaver->path = autosavePath;
+    savingVersion = board.version();
+    connect(autoSaver, SIGNAL(finished()), this, SLOT(onAutosaveFinished()));
+    autoSaver->start(QThread::LowPriority);
+}
 
-    QPointF p(nodes[0].x, nodes[0].y);
-    QPainterPath path;
+void WhiteBoard::onAutosaveFinished() {
+    if (autoSaver == 0)
+        return;
+    autoSaver->wait();
+    if (autoSaver->ok)
+        savedVersion = savingVersion;
+    else
+        fprintf(stderr, "Autosave to %s failed\n", autosavePath);
+    delete autoSaver;
+    autoSaver = 0;
+}
 
-    path.moveTo(p);
-    for (int i = 1; i < numNodes; ++i) {
-        p.setX(nodes[i].x);
-        p.setY(nodes[i].y);
-        path.lineTo(p);
+void WhiteBoard::resizeEvent(QResizeEvent* /* event */) {
+    TraceSpan span("resizeEvent");
+    updateViewRect();
+    if (mode == MODE_CALIBRATION && calibration.numClicks == 0)
+        calibration.start(width(), height());
+    if (image != 0) {
+        deleteImage(image); image = 0;
     }
-
-    qp->strokePath(path, qp->pen());
+    allocateImage();
+    if (mode != MODE_CALIBRATION)
+        drawInOffscreen();
 }
-...*/
 
-void WhiteBoard::drawStroke(QPainter* qp, Stroke& str) {
-    if (str.size() == 0)
-        return;
-    int c = str.color % NUM_COLORS;
-    QPen pen(strokeColors[c]);
-    pen.setWidth(str.width);
+void WhiteBoard::processAction(const Action& a) {
+    TraceSpan span("processAction");
+    long long t0 = 0;
+    if (latency != 0) {
+        t0 = latencyClock();
+        if (a.type == Action::DRAW_CURVE)
+            latency->inputEvent(inputTime);
+    }
+    if (recordFile != 0)
+        writeAction(recordFile, a);
+    board.processAction(a);
+    Damage committed = board.pageDamage;
+    if (!board.pageDamage.empty) {
+        invalidateTiles(board.pageDamage.rect);
+        board.pageDamage.clear();
+    }
 
-    if (str.size() == 1) {
-        if (str.finished) {
-            // A single point
-            qp->setPen(pen);
-            I2Point p = str.points.at(0);
-            I2Vector vx(1, 0);
-            I2Vector vy(0, 1);
-            drawLine(qp, p-vx, p+vx);
-            drawLine(qp, p-vy, p+vy);
+    if (a.type == Action::DRAW_CURVE) {
+        // Only stored here; drawn by the next frame tick
+        ++pendingEvents;
+        startFrameTimer();
+        if (latency != 0)
+            latency->stages[LATENCY_ACTION].record(latencyClock() - t0);
+        return;
+    }
+    clearPrediction();
+    if (a.type == Action::END_CURVE) {
+        countFrame();
+        if (latency != 0)
+            latency->frameStarted(latencyClock());
+        if (
+            image == 0 || imageWidth != width() || imageHeight != height()
+        ) {
+            drawInOffscreen();
+            update();
+        } else if (!committed.empty) {
+            // Only the committed stroke: the other fingers go on
+            // with the next frames
+            QRect r = windowRect(committed.rect).intersected(
+                QRect(0, 0, width(), height())
+            );
+            drawRegionInOffscreen(r);
+            update(r);
         }
+        board.damage.clear();
     } else {
-        /*
-        drawLineStrip(
-            qp,
-            &(str.points.at(0)),
-            (int) str.size()
-        );
-        */
-        assert(str.qPath != 0);
-        qp->strokePath(*(str.qPath), pen);
+        board.damage.clear();
+        update();
     }
+    if (latency != 0)
+        latency->stages[LATENCY_ACTION].record(latencyClock() - t0);
 }
 
 void WhiteBoard::init() {
-    pages[currentPage].strokes.clear();
-    myDrawingActive = false;
+    board.clearPage();
+    touchFilters.clear();
+    tiles.clear();
+    clearSelection();
     if (image != 0)
         clearImage();
     update();
 }
 
-void WhiteBoard::drawCalibration(QPainter* qp) {
-    if (mode != MODE_CALIBRATION)
+void WhiteBoard::drawSelection(QPainter* qp) {
+    if (lassoActive && lasso.size() > 1) {
+        std::vector<QPointF> polyline(lasso.vertices.size());
+        for (unsigned int i = 0; i < polyline.size(); ++i) {
+            polyline[i] = map(
+                QPointF(lasso.vertices[i].x, lasso.vertices[i].y)
+            );
+        }
+        QPen pen(Qt::darkGray);
+        pen.setStyle(Qt::DashLine);
+        qp->setPen(pen);
+        qp->drawPolyline(&(polyline[0]), (int) polyline.size());
+    }
+
+    if (selection.empty())
         return;
 
-    QPen pen(Qt::red);
-    pen.setWidth(1);
+    I2Rectangle r = selectionRect;
+    if (dragging)
+        r.shift(dragOffset);
+    QPointF p0 = map(QPointF(r.left(), r.top()));
+    QPointF p1 = map(QPointF(r.right(), r.bottom()));
+    if (dragging && sprite != 0)
+        qp->drawImage(p0, *sprite);
+    QPen pen(Qt::darkGray);
+    pen.setStyle(Qt::DashLine);
     qp->setPen(pen);
-
-    I2Vector dx(16, 0);
-    I2Vector dy(0, 16);
-    I2Point t = calibrationPoints[numCalibrationClicks];
-
-    QPointF dxx(16., 0.);
-    QPointF dyy(0., 16.);
-    QPointF tt(t.x, t.y);
-
-    qp->drawText(tt - dyy*2. - dxx*2., "Click in cross:");
-
-    QPen pen1(Qt::blue);
-    pen1.setWidth(3);
-    qp->setPen(pen1);
-
-    drawLine(qp, t - dx, t + dx);
-    drawLine(qp, t - dy, t + dy);
+    qp->setBrush(Qt::NoBrush);
+    qp->drawRect(QRectF(p0.x(), p0.y(), p1.x() - p0.x(), p1.y() - p0.y()));
 }
 
-void WhiteBoard::drawButtons(QPainter* qp) {
-    drawButton(
-        qp,
-        blackButtonRect,
-        "Black",
-        // blackColor,
-        // buttonColor3
-        whiteColor,
-        blackColor
-    );
-    drawButton(
-        qp,
-        redButtonRect,
-        "Red",
-        // redColor,
-        // buttonColor3
-        whiteColor,
-        redColor
-    );
-    drawButton(
-        qp,
-        greenButtonRect,
-        "Green",
-        whiteColor,
-        greenColor
-    );
-    drawButton(
-        qp,
-        blueButtonRect,
-        "Blue",
-        whiteColor,
-        blueColor
-    );
-    drawButton(
-        qp,
-        clearButtonRect,
-        "Clear",
-        blackColor,
-        whiteColor
-    );
-    drawButton(
-        qp,
-        eraseButtonRect,
-        "Eraser",
-        blackColor,
-        buttonColor3
-    );
-    drawButton(
-        qp,
-        calibrateButtonRect,
-        "Calibrate",
-        blackColor,
-        buttonColor3
-    );
-    drawButton(
-        qp,
-        quitButtonRect,
-        "Quit",
-        blackColor,
-        buttonColor3
-    );
+void WhiteBoard::selectStrokes() {
+    clearSelection();
+    if (lasso.size() < 3)
+        return;
 
-    drawLineButton(
-        qp,
-        thinButtonRect,
-        THIN_WIDTH,
-        blackColor,
-        whiteColor
-    );
-    drawLineButton(
-        qp,
-        normalButtonRect,
-        NORMAL_WIDTH,
-        blackColor,
-        whiteColor
-    );
-    drawLineButton(
-        qp,
-        thickButtonRect,
-        THICK_WIDTH,
-        blackColor,
-        whiteColor
-    );
-    drawLineButton(
-        qp,
-        veryThickButtonRect,
-        VERY_THICK_WIDTH,
-        blackColor,
-        whiteColor
-    );
+    // Broad phase: strokes in the grid cells under the lasso
+    const StrokeList& strokes = board.page().strokes;
+    std::vector<int> candidates;
+    board.page().grid.query(lasso.bbox, candidates);
+
+    for (unsigned int i = 0; i < candidates.size(); ++i) {
+        const Stroke& str = *strokes[candidates[i]];
+        if (
+            str.bbox.left() < lasso.bbox.left() ||
+            str.bbox.right() > lasso.bbox.right() ||
+            str.bbox.top() < lasso.bbox.top() ||
+            str.bbox.bottom() > lasso.bbox.bottom()
+        )
+            continue;
+        if (lasso.containsAll(&(str.points[0]), str.size()))
+            selection.push_back(candidates[i]);
+    }
 
-    /*... Moved to drawCurrentLineType
-    QPen pen(strokeColors[currentColor]);
-    pen.setWidth(currentWidth);
-    qp->setPen(pen);
+    if (!selection.empty())
+        createSprite();
+}
 
-    int x = quitButtonRect.right() + BUTTON_SKIP;
-    int y = (
-            calibrateButtonRect.top() +
-            calibrateButtonRect.bottom()
-        ) / 2 - 2;
-    drawLine(
-        qp,
-        I2Point(x, y), 
-        I2Point(x + BUTTON_WIDTH, y)
-    );
-    ...*/
-    drawCurrentLineType(qp);
+void WhiteBoard::clearSelection() {
+    selection.clear();
+    hidden.clear();
+    dragging = false;
+    if (sprite != 0) {
+        deleteImage(sprite); sprite = 0;
+    }
 }
 
-void WhiteBoard::drawCurrentLineType(QPainter* qpnt /* = 0 */) {
-    QPainter* qp = qpnt;
-    if (qpnt == 0) {
-        if (image == 0)
-            return;
-        qp = new QPainter(image);
-        qp->setRenderHint(QPainter::Antialiasing);
-    }
-
-    int x = quitButtonRect.right() + BUTTON_SKIP;
-    int y = (
-            calibrateButtonRect.top() +
-            calibrateButtonRect.bottom()
-        ) / 2 - 2;
-
-    // Erase the rectangle
-    qp->setBrush(QBrush(Qt::white));
-    qp->setPen(Qt::white);
-    qp->drawRect(
-        x-2, calibrateButtonRect.top() - 1,
-        BUTTON_WIDTH+4, BUTTON_HEIGHT+2
+void WhiteBoard::createSprite() {
+    const StrokeList& strokes = board.page().strokes;
+    assert(!selection.empty());
+
+    int margin = 0;
+    selectionRect = strokes[selection[0]]->bbox;
+    for (unsigned int i = 0; i < selection.size(); ++i) {
+        const Stroke& str = *strokes[selection[i]];
+        selectionRect.add(str.bbox);
+        if (str.margin() > margin)
+            margin = str.margin();
+    }
+    margin += 1;
+    selectionRect = I2Rectangle(
+        selectionRect.left() - margin, selectionRect.top() - margin,
+        selectionRect.width() + 2*margin, selectionRect.height() + 2*margin
     );
 
-    QPen pen(strokeColors[currentColor]);
-    pen.setWidth(currentWidth);
-    qp->setPen(pen);
-
-    drawLine(
-        qp,
-        I2Point(x, y), 
-        I2Point(x + BUTTON_WIDTH, y)
+    // Rasterized once at the current scale; dragging only moves it
+    if (sprite != 0)
+        deleteImage(sprite);
+    sprite = newImage(
+        (int) ceil(selectionRect.width()*xCoeff) + 1,
+        (int) ceil(selectionRect.height()*yCoeff) + 1,
+        QImage::Format_ARGB32_Premultiplied
     );
+    sprite->fill(Qt::transparent);
 
-    if (qpnt == 0)
-        delete qp;
+    QPainter qp(sprite);
+    qp.setRenderHint(QPainter::Antialiasing);
+    qp.scale(xCoeff, yCoeff);
+    qp.translate(-selectionRect.left(), -selectionRect.top());
+    QtRenderer r(&qp);
+    for (unsigned int i = 0; i < selection.size(); ++i) {
+        r.drawStroke(*strokes[selection[i]], 0);
+    }
 }
 
-void WhiteBoard::drawButton(
-    QPainter* qp,
-    const I2Rectangle& rect, 
-    const char* text,
-    const QColor& fgColor,
-    const QColor& bgColor
-) {
-    qp->setBrush(QBrush(bgColor));
-    qp->drawRect(
-        rect.left(), rect.top(),
-        rect.width(), rect.height()
-    );
-
-    QPen pen(buttonColor1);
-    pen.setWidth(1);
-    qp->setPen(pen);
+void WhiteBoard::startDrag(const I2Point& p, bool copy) {
+    dragging = true;
+    dragCopy = copy;
+    dragStart = p;
+    dragOffset = I2Vector(0, 0);
+    if (!copy) {
+        // Take the selected strokes out of the offscreen
+        // image once; the sprite is drawn in their place
+        hidden.assign(board.page().strokes.size(), 0);
+        for (unsigned int i = 0; i < selection.size(); ++i)
+            hidden[selection[i]] = 1;
+        drawInOffscreen();
+    }
+}
 
-    // moveTo(rect.left(), rect.bottom());
-    // drawLineTo(rect.left(), rect.top());
-    // drawLineTo(rect.right(), rect.top());
-    drawLine(
-        qp, 
-        I2Point(rect.left(), rect.bottom()),
-        I2Point(rect.left(), rect.top())
-    );
-    drawLine(
-        qp, 
-        I2Point(rect.left(), rect.top()),
-        I2Point(rect.right(), rect.top())
-    );
+void WhiteBoard::drop() {
+    Page& page = board.page();
+    if (dragOffset != I2Vector(0, 0)) {
+        if (!dragCopy)
+            invalidateTiles(selectionRect);
+        I2Rectangle target = selectionRect;
+        invalidateTiles(target.shift(dragOffset));
+        if (dragCopy) {
+            for (unsigned int i = 0; i < selection.size(); ++i) {
+                Stroke str = *page.strokes[selection[i]];
+                str.translate(dragOffset);
+                page.addStroke(str);
+                selection[i] = (int) page.strokes.size() - 1;
+            }
+        } else {
+            for (unsigned int i = 0; i < selection.size(); ++i) {
+                Stroke str = *page.strokes[selection[i]];
+                str.translate(dragOffset);
+                page.replaceStroke(selection[i], str);
+            }
+            page.reindex();
+        }
+        selectionRect.shift(dragOffset);
+    }
+    dragging = false;
+    dragOffset = I2Vector(0, 0);
+    hidden.clear();
+    drawInOffscreen();
+}
 
-    QPen pen1(buttonColor2);
-    pen1.setWidth(1);
-    qp->setPen(pen1);
-    // drawLineTo(rect.right(), rect.bottom());
-    // drawLineTo(rect.left(), rect.bottom());
-    drawLine(
-        qp, 
-        I2Point(rect.right(), rect.top()),
-        I2Point(rect.right(), rect.bottom())
-    );
-    drawLine(
-        qp, 
-        I2Point(rect.right(), rect.bottom()),
-        I2Point(rect.left(), rect.bottom())
-    );
+void WhiteBoard::drawButtons(QPainter* qp) {
+    QtRenderer r(qp);
+    board.drawButtons(r);
+}
 
-    QPen pen2(fgColor);
-    pen2.setWidth(1);
-    qp->setPen(pen2);
-    qp->drawText(
-        rect.left() + 8,
-        rect.top() + 14,
-        text
-    );
+void WhiteBoard::drawCurrentLineType() {
+    if (image == 0)
+        return;
+    QPainter qp(image);
+    qp.setRenderHint(QPainter::Antialiasing);
+    QtRenderer r(&qp);
+    board.drawCurrentLineType(r);
 }
 
 void WhiteBoard::allocateImage() {
+    TraceSpan span("allocateImage");
     int w = width();
     int h = height();
     if (
@@ -813,8 +1716,8 @@ void WhiteBoard::allocateImage() {
         imageWidth != w || imageHeight != h
     ) {
         if (image != 0)
-            delete image;
-        image = new QImage(w, h, QImage::Format_RGB32);
+            deleteImage(image);
+        image = newImage(w, h, QImage::Format_RGB32);
         imageWidth = w;
         imageHeight = h;
     }
@@ -823,6 +1726,7 @@ void WhiteBoard::allocateImage() {
 }
 
 void WhiteBoard::clearImage() {
+    TraceSpan span("clearImage");
     assert(image != 0);
     if (image == 0)
         return;
@@ -835,65 +1739,3 @@ void WhiteBoard::clearImage() {
     qp.drawRect(0, 0, imageWidth, imageHeight);
     drawButtons(&qp);
 }
-
-void WhiteBoard::drawLineButton(
-    QPainter* qp,
-    const I2Rectangle& rect, 
-    int lineWidth,
-    const QColor& fgColor,
-    const QColor& bgColor
-) {
-    qp->setBrush(QBrush(bgColor));
-    qp->drawRect(
-        rect.left(), rect.top(),
-        rect.width(), rect.height()
-    );
-
-    QPen pen(buttonColor1);
-    pen.setWidth(1);
-    qp->setPen(pen);
-
-    // moveTo(rect.left(), rect.bottom());
-    // drawLineTo(rect.left(), rect.top());
-    // drawLineTo(rect.right(), rect.top());
-    drawLine(
-        qp, 
-        I2Point(rect.left(), rect.bottom()),
-        I2Point(rect.left(), rect.top())
-    );
-    drawLine(
-        qp, 
-        I2Point(rect.left(), rect.top()),
-        I2Point(rect.right(), rect.top())
-    );
-
-    // setForeground(buttonColor2);
-    // drawLineTo(rect.right(), rect.bottom());
-    // drawLineTo(rect.left(), rect.bottom());
-    QPen pen1(buttonColor2);
-    pen1.setWidth(1);
-    qp->setPen(pen1);
-    drawLine(
-        qp, 
-        I2Point(rect.right(), rect.top()),
-        I2Point(rect.right(), rect.bottom())
-    );
-    drawLine(
-        qp, 
-        I2Point(rect.right(), rect.bottom()),
-        I2Point(rect.left(), rect.bottom())
-    );
-
-    // setForeground(fgColor);
-    // setLineWidth(lineWidth);
-    QPen pen2(fgColor);
-    pen2.setWidth(lineWidth);
-    qp->setPen(pen2);
-
-    int y = (rect.top() + rect.bottom())/2;
-    drawLine(
-        qp,
-        I2Point(rect.left() + 2, y),
-        I2Point(rect.right() - 2, y)
-    );
-}
@@ -3,232 +3,238 @@
 #include <QWidget>
 #include <QPainter>
 #include <QMouseEvent>
+#include <QTabletEvent>
+#include <QTouchEvent>
+#include <QTimer>
+#include <QSocketNotifier>
 #include <cassert>
+#include <stdio.h>
+#include <map>
 #include "R2Graph.h"
-
-const int DX = 80;
-const int DY = 80;
-const int THIN_WIDTH = 1;
-const int NORMAL_WIDTH = 2;
-const int THICK_WIDTH = 3;
-const int VERY_THICK_WIDTH = 5;
-const int LINE_WIDTH = THICK_WIDTH;
-
-const int ERASER_WIDTH = 32;
-
-const int NUM_COLORS = 5;
-extern const QColor strokeColors[NUM_COLORS];
-
-static const int MODE_CALIBRATION = 0;
-static const int MODE_NORMAL = 1;
-static const int NUM_CALIBRATION_POINTS = 2;
-static const int MAX_PAGES = 8;
-
-class Stroke {
-public:
-    int color;
-    int width;
-    std::vector<I2Point> points;
-    QPainterPath* qPath;
-    bool finished;
-
-    Stroke():
-        color(Qt::black),
-        width(1),
-        points(),
-        qPath(0),
-        finished(false)
-    {}
-
-    Stroke(const Stroke& str):
-        color(str.color),
-        width(str.width),
-        points(str.points),
-        qPath(0),
-        finished(str.finished)
-    {
-        if (str.qPath != 0)
-            qPath = new QPainterPath(*(str.qPath));
-    }
-
-    ~Stroke() {
-        if (qPath != 0)
-            delete qPath;
-    }
-
-    Stroke& operator=(const Stroke& str) {
-        color = str.color;
-        width = str.width;
-        points = str.points;
-        if (qPath != 0) {
-            delete qPath;
-            qPath = 0;
-        }
-        if (str.qPath != 0) {
-            qPath = new QPainterPath(*(str.qPath));
-        }
-        finished = str.finished;
-        return *this;
-    }
-
-    int size() const {
-        return (int) points.size();
-    }
-
-    void clear() {
-        points.clear();
-        if (qPath != 0) {
-            delete qPath;
-            qPath = 0;
-        }
-    }
-
-    void push_back(const I2Point& p) {
-        if (size() == 0) {
-            if (qPath != 0)
-                delete qPath;
-            qPath = new QPainterPath();
-            qPath->moveTo(QPointF(p.x, p.y));
-            //... qPath->lineTo(QPointF(p.x, p.y)); // Single point
-            points.push_back(p);
-        } else if (p != points.back()) {
-            assert(qPath != 0);
-            points.push_back(p);
-            qPath->lineTo(QPointF(p.x, p.y));
-        }
-    }
-
-    void finalize() {
-        /*...
-        if (size() == 1) {
-            assert(qPath != 0);
-            qPath->lineTo(      // Single point
-                points.back().x, points.back().y
-            );
-        }
-        ...*/
-        finished = true;
-    }
-};
-
-class Action {
-public:
-    enum {
-        START_CURVE,
-        DRAW_CURVE,
-        END_CURVE
-    };
-
-    int type;
-    int color;
-    int width;
-    I2Point point;
-
-    Action():
-        type(START_CURVE),
-        color(0),
-        width(LINE_WIDTH),
-        point()
-    {}
-
-    Action(int t, int c, int w, const I2Point& pnt):
-        type(t),
-        color(c),
-        width(w),
-        point(pnt)
-    {}
-};
+#include "board.h"
+#include "calibration.h"
+#include "lasso.h"
+#include "tilecache.h"
+#include "predictor.h"
+#include "jitterfilter.h"
+#include "latency.h"
+#include "inputthread.h"
+#include "scriptinput.h"
+#include "boardexport.h"
+#include "autosave.h"
+
+const double MIN_ZOOM = 1./64.;
+// Ink drawn zoomed in keeps sixteenths of a world pixel (see
+// subpixelPoint); beyond 16 it would snap to a coarser grid than
+// the device pixels
+const double MAX_ZOOM = 8.;
+
+// Histogram of input events drawn per frame; the last bucket
+// counts all the larger numbers
+const int EVENTS_PER_FRAME_BUCKETS = 16;
+// Frames without input before the frame timer stops
+const int MAX_IDLE_FRAMES = 30;
+// Frames without input before the predicted ink is removed
+const int MAX_PREDICTION_IDLE_FRAMES = 2;
 
 class WhiteBoard: public QWidget {
     Q_OBJECT
 
 private:
-    QPointF map(QPointF) const;
-    QPointF invMap(QPointF) const;
+    // Infinite canvas: strokes are stored in world coordinates
+    // (one unit is one pixel at 100% zoom, the Y axis goes down
+    // as in the window); the window shows the world rectangle
+    // [xmin, xmax] x [ymin, ymax] scaled by xCoeff, yCoeff.
+    QPointF map(QPointF) const;         // World -> window
+    QPointF invMap(QPointF) const;      // Window -> world
 
     double xmin, xmax, ymin, ymax;
     double xCoeff, yCoeff;
 
+    bool panning;
+    I2Point panLast;
+
     QImage* image;
     int imageWidth;
     int imageHeight;
 
 public:
     bool finished;
-    bool initialUpdate;
-
-    class Page {
-    public:
-        std::vector<Stroke> strokes;
-    };
-
-    Page pages[MAX_PAGES];
-    int currentPage;
 
-    Stroke myDrawing;
-    bool myDrawingActive;
+    Board board;
 
     int mode;                   // MODE_CALIBRATION / MODE_NORMAL
-    int currentColor;           // current color index
-    int currentWidth;           // current line width
-    int lastColor;
-    int lastWidth;
-    I2Point calibrationPoints[NUM_CALIBRATION_POINTS];
-    I2Point calibrationClicks[NUM_CALIBRATION_POINTS];
-    int numCalibrationClicks;
-
-    // Colors
-    QColor whiteColor, blackColor, redColor, greenColor, blueColor;
-    QColor buttonColor1, buttonColor2, buttonColor3;
-
-    // Mapping
-    double xIntercept, xSlope;
-    double yIntercept, ySlope;
+    Calibration calibration;
+
+    // Lasso selection
+    bool lassoActive;           // Lasso is being drawn
+    Lasso lasso;
+    std::vector<int> selection; // Indices of selected strokes
+    std::vector<char> hidden;   // Strokes not drawn in offscreen
+    I2Rectangle selectionRect;  // Pixels covered by the selection
+    QImage* sprite;             // Selected strokes, transparent background
+    bool dragging;
+    bool dragCopy;              // Copy instead of move on drop
+    I2Point dragStart;
+    I2Vector dragOffset;
+
+    // Tiles of the current page for zoomed-out views
+    TileCache tiles;
+    // Views are drawn from the full-resolution strokes, without
+    // tiles, levels of detail or cached paths: the reference of
+    // the regression tests
+    bool referenceDrawing;
+
+    // Live ink is drawn once per display frame, not per event. The
+    // timer is single-shot: every tick is aimed at the next multiple
+    // of the refresh period, so the whole-millisecond intervals
+    // average to the refresh rate instead of beating against it.
+    QTimer frameTimer;
+    long long framePeriod;      // In microseconds
+    long long nextFrame;        // latencyClock() of the next tick
+    int pendingEvents;          // Input events since the last frame
+    int idleFrames;
+
+    // Statistics
+    long long inkFrames;        // Frames that have drawn new ink
+    long long inkEvents;        // Input events drawn in these frames
+    int maxEventsPerFrame;
+    long long eventsPerFrame[EVENTS_PER_FRAME_BUCKETS];
+
+    // Predicted ink: drawn over the offscreen image only, so it
+    // disappears with the next repaint of its rectangle
+    InkPredictor predictor;
+    double predictionAhead;     // Milliseconds, 0 if disabled
+    bool predictionVisible;
+    R2Point predictedPoint;     // World coordinates
+    QRect predictionRect;       // Window pixels to repaint
+
+    FILE* traceFile;            // Input trace for predictbench, or 0
+
+    // Smooths the window points of the strokes drawn here
+    InkFilter inkFilter;
+    bool tabletDrawing;         // The live stroke comes from a tablet
+    // Of the fingers drawing on a touch screen, by touch point id
+    std::map<int, InkFilter> touchFilters;
+    std::vector<I2Rectangle> inkRects;  // New ink of a frame, scratch
+    std::vector<I2Rectangle> staleRects;    // Ink to redraw, scratch
+
+    // Latency of the live ink, 0 if not measured
+    LatencyStats* latency;
+    long long inputTime;        // Arrival of the current input event
+    bool latencyHud;            // Show it over the board
+    const char* latencyDump;    // File for the report at exit, or 0
+
+    const char* profilePath;    // Chrome trace written while F12 is on
+    FILE* recordFile;           // Actions are recorded here, or 0
+
+    // Reads a device or a replayed stream off the GUI thread, or 0
+    InputThread* inputThread;
+
+    // Scripted actions, applied in batches, or 0
+    ScriptInput* script;
+    std::vector<QSocketNotifier*> scriptNotifiers;
+    std::vector<Action> scriptActions;      // Batch, scratch
+    bool scriptInkPending;      // Applied, not drawn yet
+    // World rectangles of the strokes committed by scripts since
+    // the last frame, to be drawn by it
+    std::vector<I2Rectangle> scriptStrokes;
+
+    // F9 exports the board here, as PNG, SVG or PDF by extension
+    const char* exportPath;
+    bool exportView;            // Only the view, not all the strokes
+    BoardExporter* exporter;    // Running, or 0
+    QString exportTitle;        // Of the window, during an export
+
+    // The board is restored from here and saved here periodically
+    // when it has changed, or 0
+    const char* autosavePath;
+    QTimer autosaveTimer;
+    AutoSaver* autoSaver;       // Running, or 0
+    int savedVersion;           // Of the board in the file
+    int savingVersion;          // Of the board being saved
 
     void mapMousePoint(const I2Point& mousePoint, I2Point& windowPoint) const;
-    void mapWindowPoint(const I2Point& mousePoint, I2Point& windowPoint) const;
+    I2Point touchWindowPoint(const QTouchEvent::TouchPoint& p) const;
+    I2Point worldPoint(const I2Point& windowPoint) const;
+    // An action of the pen at a window point, to a sixteenth of a
+    // world pixel; a start has the current color and width
+    Action inkAction(
+        int type, const I2Point& windowPoint,
+        int pressure = NO_PRESSURE, int touchId = NO_TOUCH
+    ) const;
+
+    // View
+    void updateViewRect();
+    QTransform viewTransform() const;
+    R2Rectangle viewRect() const;
+    void pan(int dx, int dy);
+    void zoom(double factor, const I2Point& center);
+    void scrollImage(int dx, int dy);
+    void drawRegionInOffscreen(const QRect& r);
+    bool useTiles() const;
+    void drawTiles(QPainter* qp, const QRect& r);
+    void makeTileStrokes(const TileKey& key, std::vector<TileStroke>& res);
+    void invalidateTiles(const I2Rectangle& r);
 
     WhiteBoard(QWidget *parent = 0);
-    ~WhiteBoard() {
-        if (image != 0)
-            delete image;
+    ~WhiteBoard();
+
+    // For regression tests of the drawing paths
+    const QImage* offscreenImage() const {
+        return image;
     }
 
     void drawInOffscreen();
     void drawLastCurveInOffscreen();
-    void drawStroke(QPainter* qp, Stroke& str);
-    void drawCalibration(QPainter* qp);
+    void startFrameTimer();
+    void scheduleFrame();
+    void countFrame();
+    void addInputSample(const R2Point& p, unsigned long time);
+    void drainInput();
+    void openScript(const char* spec);
+    void watchScriptSource(int fd, const char* slot);
+    void applyScript(const std::vector<Action>& actions);
+    void drawScriptInk();
+    void redrawStaleInk();
+    QRect windowRect(const I2Rectangle& world) const;
+    void startExport();
+    void restoreAutosave();
+    void calibrationClick(const I2Point& t);
+    void updatePrediction();
+    void clearPrediction();
+    void drawPrediction(QPainter* qp);
+    void drawLatencyHud(QPainter* qp);
+    void dumpLatency() const;
+    void drawSelection(QPainter* qp);
     void drawButtons(QPainter* qp);
-    void drawCurrentLineType(QPainter* qp = 0);
-    void drawButton(
-        QPainter* qp,
-        const I2Rectangle& rect, 
-        const char* text,
-        const QColor& fgColor,
-        const QColor& bgColor
-    );
-    void drawLineButton(
-        QPainter* qp,
-        const I2Rectangle& rect, 
-        int lineWidth,
-        const QColor& fgColor,
-        const QColor& bgColor
-    );
-    void drawLine(
-        QPainter* qp,
-        const I2Point& p0, const I2Point& p1
-    );
-    void drawLineStrip(
-        QPainter* qp,
-        const I2Point* nodes,
-        int numNodes
-    );
+    void drawCurrentLineType();
 
+    void pressButton(int button);
     void processAction(const Action& a);
+    void cancelTouches();
+
+    void selectStrokes();
+    void clearSelection();
+    void createSprite();
+    void startDrag(const I2Point& p, bool copy);
+    void drop();
+
     void init();
     void allocateImage();
     void clearImage();
 
+public slots:
+    void onTilesReady();
+    void onFrame();
+    void onInputReady();
+    void onScriptInput(int fd);
+    void onScriptClient(int fd);
+    void onExportProgress(int done, int total);
+    void onExportFinished();
+    void onAutosave();
+    void onAutosaveFinished();
+
 protected:
     // Virtual methods
     void paintEvent(QPaintEvent* event);
@@ -236,4 +242,9 @@ protected:
     void mousePressEvent(QMouseEvent* event);
     void mouseReleaseEvent(QMouseEvent* event);
     void mouseMoveEvent(QMouseEvent* event);
+    void wheelEvent(QWheelEvent* event);
+    void keyPressEvent(QKeyEvent* event);
+    void tabletEvent(QTabletEvent* event);
+    bool event(QEvent* event);
+    bool touchEvent(QTouchEvent* event);
 };
@@ -0,0 +1,199 @@
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <stdlib.h>
+#include "xbackstore.h"
+
+// XShmAttach fails asynchronously (e.g. on a remote display)
+static bool shmAttachFailed = false;
+
+static int shmErrorHandler(Display* /* d */, XErrorEvent* /* e */) {
+    shmAttachFailed = true;
+    return 0;
+}
+
+XBackingStore::XBackingStore():
+    raster(),
+    numPuts(0),
+    numCompletions(0),
+    display(0),
+    window(0),
+    image(0),
+    shmInfo(),
+    shm(false),
+    completionType(-1),
+    numPending(0)
+{}
+
+XBackingStore::~XBackingStore() {
+    destroy();
+}
+
+bool XBackingStore::create(Display* d, Window w, int width, int height) {
+    destroy();
+    display = d;
+    window = w;
+
+    XWindowAttributes attr;
+    if (!XGetWindowAttributes(display, window, &attr))
+        return false;
+    if (
+        attr.visual->c_class != TrueColor ||
+        (attr.depth != 24 && attr.depth != 32)
+    )
+        return false;
+
+    if (
+        getenv("WHITEBOARD_NO_SHM") == 0 &&
+        createShmImage(attr.visual, attr.depth, width, height)
+    ) {
+        shm = true;
+    } else if (!createImage(attr.visual, attr.depth, width, height)) {
+        return false;
+    }
+
+    raster.attach(
+        (Pixel*) image->data, width, height,
+        image->bytes_per_line / 4
+    );
+    return true;
+}
+
+bool XBackingStore::createShmImage(
+    Visual* visual, int depth, int width, int height
+) {
+    if (!XShmQueryExtension(display))
+        return false;
+    completionType = XShmGetEventBase(display) + ShmCompletion;
+    image = XShmCreateImage(
+        display, visual, depth, ZPixmap, 0, &shmInfo, width, height
+    );
+    if (image == 0)
+        return false;
+    if (image->bits_per_pixel != 32) {
+        XDestroyImage(image);
+        image = 0;
+        return false;
+    }
+
+    shmInfo.shmid = shmget(
+        IPC_PRIVATE, (size_t) image->bytes_per_line * height,
+        IPC_CREAT | 0600
+    );
+    if (shmInfo.shmid < 0) {
+        XDestroyImage(image);
+        image = 0;
+        return false;
+    }
+    shmInfo.shmaddr = (char*) shmat(shmInfo.shmid, 0, 0);
+    if (shmInfo.shmaddr == (char*) (-1)) {
+        shmctl(shmInfo.shmid, IPC_RMID, 0);
+        XDestroyImage(image);
+        image = 0;
+        return false;
+    }
+    image->data = shmInfo.shmaddr;
+    shmInfo.readOnly = False;
+
+    shmAttachFailed = false;
+    XErrorHandler oldHandler = XSetErrorHandler(shmErrorHandler);
+    XShmAttach(display, &shmInfo);
+    XSync(display, False);
+    XSetErrorHandler(oldHandler);
+
+    // The segment is freed when both sides detach
+    shmctl(shmInfo.shmid, IPC_RMID, 0);
+
+    if (shmAttachFailed) {
+        shmdt(shmInfo.shmaddr);
+        image->data = 0;
+        XDestroyImage(image);
+        image = 0;
+        return false;
+    }
+    return true;
+}
+
+bool XBackingStore::createImage(
+    Visual* visual, int depth, int width, int height
+) {
+    char* data = (char*) malloc((size_t) width * height * 4);
+    if (data == 0)
+        return false;
+    image = XCreateImage(
+        display, visual, depth, ZPixmap, 0, data, width, height, 32, 0
+    );
+    if (image == 0) {
+        free(data);
+        return false;
+    }
+    // Pixels are written in the client byte order;
+    // XPutImage swaps bytes when needed
+    unsigned int one = 1;
+    image->byte_order = (*(char*) &one)? LSBFirst : MSBFirst;
+    return true;
+}
+
+void XBackingStore::destroy() {
+    raster.release();
+    if (image == 0)
+        return;
+    if (shm) {
+        XShmDetach(display, &shmInfo);
+        XSync(display, False);
+        shmdt(shmInfo.shmaddr);
+        image->data = 0;
+    }
+    XDestroyImage(image);   // Frees the data of a non-shared image
+    image = 0;
+    shm = false;
+    numPending = 0;         // Late completions are dropped
+}
+
+void XBackingStore::put(GC gc, const I2Rectangle& rect) {
+    if (image == 0)
+        return;
+    I2Rectangle r = rect;
+    r.intersect(I2Rectangle(0, 0, raster.width, raster.height));
+    if (r.width() <= 0 || r.height() <= 0)
+        return;
+    ++numPuts;
+    if (shm) {
+        XShmPutImage(
+            display, window, gc, image,
+            r.left(), r.top(), r.left(), r.top(),
+            r.width(), r.height(),
+            True
+        );
+        ++numPending;
+    } else {
+        XPutImage(
+            display, window, gc, image,
+            r.left(), r.top(), r.left(), r.top(),
+            r.width(), r.height()
+        );
+    }
+}
+
+static Bool isCompletion(Display* /* d */, XEvent* e, XPointer arg) {
+    return e->type == *(int*) arg;
+}
+
+void XBackingStore::sync() {
+    while (numPending > 0) {
+        // Flushes the requests and blocks until the event arrives;
+        // the other events stay in the queue
+        XEvent e;
+        XIfEvent(display, &e, isCompletion, (XPointer) &completionType);
+        handleEvent(e);
+    }
+}
+
+bool XBackingStore::handleEvent(const XEvent& e) {
+    if (e.type != completionType || completionType < 0)
+        return false;
+    const XShmCompletionEvent& c = (const XShmCompletionEvent&) e;
+    if (c.drawable == window && numPending > 0)
+        --numPending;
+    ++numCompletions;
+    return true;
+}
@@ -0,0 +1,65 @@
+//
+// Backing store of an X window: a client-side Raster copied to the
+// window with XShmPutImage (MIT shared memory extension) or, when
+// the extension is not available, with XPutImage.
+//
+#ifndef XBACKSTORE_H
+#define XBACKSTORE_H
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include "raster.h"
+
+class XBackingStore {
+public:
+    Raster raster;      // Pixels are X pixel values of the window visual
+    long long numPuts;          // Of the session, for the exit report
+    long long numCompletions;   // ShmCompletion events taken
+
+    XBackingStore();
+    ~XBackingStore();
+
+    // Return false if the window visual is not a 24/32-bit TrueColor
+    // one; then the store cannot be used
+    bool create(Display* d, Window w, int width, int height);
+    void destroy();
+
+    bool valid() const {
+        return (image != 0);
+    }
+
+    bool usingShm() const {
+        return shm;
+    }
+
+    // Copy a rectangle of the raster to the same place in the window
+    void put(GC gc, const I2Rectangle& r);
+
+    // The server reads a shared image after XShmPutImage returns:
+    // wait until it has read all of them before writing into the
+    // raster, or the window shows torn frames
+    void sync();
+
+    // Take a ShmCompletion event of the store from the event loop;
+    // return false for the other events
+    bool handleEvent(const XEvent& e);
+
+private:
+    Display* display;
+    Window window;
+    XImage* image;
+    XShmSegmentInfo shmInfo;
+    bool shm;
+    int completionType;         // Event type of ShmCompletion
+    int numPending;             // Puts the server has not completed
+
+    bool createShmImage(Visual* visual, int depth, int width, int height);
+    bool createImage(Visual* visual, int depth, int width, int height);
+
+    // Not copyable
+    XBackingStore(const XBackingStore&);
+    XBackingStore& operator=(const XBackingStore&);
+};
+
+#endif